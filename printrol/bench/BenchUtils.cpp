@@ -0,0 +1,76 @@
+#include "BenchUtils.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+
+
+static std::atomic<std::uint64_t> alloc_counter{ 0 };
+
+// Count every allocation made through the global operator new, aligned new is left alone
+void* operator new(std::size_t size) {
+    alloc_counter.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    alloc_counter.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return ::operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+
+std::uint64_t alloc_count() {
+    return alloc_counter.load(std::memory_order_relaxed);
+}
+
+std::vector<std::string> load_corpus(const std::string& name) {
+    const std::string path = std::string(PRINTROL_BENCH_CORPUS_DIR) + "/" + name;
+    std::ifstream file(path, std::ios::binary);
+    if (not file) {
+        throw std::runtime_error("Cannot open corpus " + path);
+    }
+
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line)) {
+        line += '\n';
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+void set_line_counters(benchmark::State& state, std::size_t lines_per_iteration, std::uint64_t allocs) {
+    const double lines = static_cast<double>(state.iterations()) * static_cast<double>(lines_per_iteration);
+    state.SetItemsProcessed(static_cast<std::int64_t>(lines));
+    state.counters["per_line"] = benchmark::Counter(lines, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["allocs/line"] = benchmark::Counter(lines > 0 ? static_cast<double>(allocs) / lines : 0);
+}
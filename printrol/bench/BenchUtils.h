@@ -0,0 +1,19 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+/// @brief Load a recorded printer session from the corpus directory
+/// @param name File name inside bench/corpus
+/// @return The lines of the file, each including its '\n' like CommThread hands them over
+std::vector<std::string> load_corpus(const std::string& name);
+
+/// @brief Number of calls to the global operator new since the start of the program
+std::uint64_t alloc_count();
+
+/// @brief Report "per_line" time and "allocs/line" counters for a benchmark that processed
+/// @p lines_per_iteration lines per iteration, @p allocs allocations in total
+void set_line_counters(benchmark::State& state, std::size_t lines_per_iteration, std::uint64_t allocs);
@@ -0,0 +1,156 @@
+#include <benchmark/benchmark.h>
+#include "TxQueue/TxQueue.h"
+#include "VirtualPrinter/VirtualPrinter.h"
+#include "LinuxSerial/LinuxSerial.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+
+using bench_clock = std::chrono::steady_clock;
+
+/// @brief LinuxSerial that notes when the write carrying "M108\n" returned, i.e. the bytes are on the wire
+class MarkedSerial : public ISerial {
+public:
+    void open(std::wstring port, int baud) override {
+        inner.open(std::move(port), baud);
+    }
+    void close() override {
+        inner.close();
+    }
+    int write(const void* buff, int size) override {
+        std::string_view data(static_cast<const char*>(buff), size);
+        return write_gather(&data, 1);
+    }
+    int write_gather(const std::string_view* buffs, int count) override {
+        const int ret = inner.write_gather(buffs, count);
+        std::size_t end = 0;
+        for (int i = 0; i < count; ++i) {
+            end += buffs[i].size();
+            if (end <= static_cast<std::size_t>(std::max(ret, 0)) && buffs[i] == "M108\n") {
+                written_at.store(bench_clock::now().time_since_epoch().count(), std::memory_order_release);
+            }
+        }
+        return ret;
+    }
+    int read(void* dest, int size) override {
+        return inner.read(dest, size);
+    }
+    bool wait_readable(int timeout_ms) override {
+        return inner.wait_readable(timeout_ms);
+    }
+    void wake() override {
+        inner.wake();
+    }
+    int bytes_available() const override {
+        return inner.bytes_available();
+    }
+    int read_some(void* dest, int capacity, int timeout_ms) override {
+        return inner.read_some(dest, capacity, timeout_ms);
+    }
+    native_handle_t native_handle() const override {
+        return inner.native_handle();
+    }
+    void flush() override {
+        inner.flush();
+    }
+    bool is_open() const override {
+        return inner.is_open();
+    }
+    std::vector<std::wstring> list_ports() const override {
+        return {};
+    }
+    std::vector<SerialPortInfo> list_port_info() const override {
+        return {};
+    }
+
+    LinuxSerial inner;
+    std::atomic<bench_clock::rep> written_at{ 0 };
+};
+
+
+/// @brief Press to wire latency of M108 behind a backlog of moves
+/// @details The writer thread runs like CommThread: send, then wait up to 50 ms for replies. range(0) is how the
+/// command is sent: 0 queued like any command, 1 through the emergency lane, 2 through the lane and waking the writer.
+static void BM_EmergencyLatency(benchmark::State& state) {
+    VirtualPrinterConfig config;
+    // the emulator has no emergency parser, an unlimited buffer stands in for it taking the command from a full one
+    config.rx_buffer_size = 0;
+    VirtualPrinter printer(config);
+    MarkedSerial serial;
+    if (not printer.start()) {
+        state.SkipWithError("could not open a pty");
+        return;
+    }
+    const auto& name = printer.port_name();
+    serial.open(std::wstring(name.begin(), name.end()), 115200);
+    if (not serial.is_open()) {
+        state.SkipWithError("could not open a pty");
+        return;
+    }
+
+    const int mode = static_cast<int>(state.range(0));
+    TxQueue txq;
+    txq.set_emergency_parser(true);
+    std::atomic<bool> running{ true }, idle{ true };
+    std::thread writer([&] {
+        char buf[4096];
+        char prev = '\n';
+        while (running) {
+            txq.send(serial);
+            idle = txq.pending() == 0 && txq.in_flight() == 0;
+            const int cnt = serial.read_some(buf, sizeof(buf), 50);
+            for (int i = 0; i < cnt; ++i) {
+                if (prev == '\n' && buf[i] == 'o') {
+                    txq.acknowledge();
+                }
+                prev = buf[i];
+            }
+        }
+    });
+
+    std::string backlog;
+    for (int i = 0; i < 200; ++i) {
+        backlog += "G1 X" + std::to_string(i % 100) + " Y10\n";
+    }
+    double worst = 0, total = 0;
+    for (auto _ : state) {
+        idle = false;
+        txq.push(backlog);
+        // the writer is streaming and waits for replies, pressed at varying points of its wait
+        const auto offset = std::chrono::microseconds(static_cast<long>(state.iterations()) * 997 % 50000);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20) + offset);
+
+        serial.written_at = 0;
+        const auto pressed = bench_clock::now();
+        if (mode == 0) {
+            txq.push("M108\n");
+        } else {
+            txq.push_emergency("M108\n");
+            if (mode == 2) {
+                serial.wake();
+            }
+        }
+        while (serial.written_at.load(std::memory_order_acquire) == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        const double latency =
+            std::chrono::duration<double>(bench_clock::time_point(bench_clock::duration(serial.written_at)) - pressed)
+                .count();
+        state.SetIterationTime(latency);
+        worst = std::max(worst, latency);
+        total += latency;
+
+        while (not idle) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    running = false;
+    writer.join();
+    state.counters["worst_ms"] = worst * 1000;
+    state.counters["mean_ms"] = total * 1000 / std::max<benchmark::IterationCount>(state.iterations(), 1);
+}
+BENCHMARK(BM_EmergencyLatency)->Arg(0)->Arg(1)->Arg(2)->Iterations(30)->UseManualTime();
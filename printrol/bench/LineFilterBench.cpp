@@ -0,0 +1,25 @@
+#include <benchmark/benchmark.h>
+#include "LineFilter/LineFilter.h"
+#include "BenchUtils.h"
+
+
+static void BM_LineFilterCheckCorpus(benchmark::State& state, const char* corpus) {
+    const auto lines = load_corpus(corpus);
+    LineFilter filter;
+    filter.add_filter(LineFilter::temperature_regex());
+    filter.add_filter(LineFilter::position_regex());
+
+    const auto allocs_before = alloc_count();
+    for (auto _ : state) {
+        for (const auto& line : lines) {
+            benchmark::DoNotOptimize(filter.check(line));
+        }
+    }
+    set_line_counters(state, lines.size(), alloc_count() - allocs_before);
+}
+BENCHMARK_CAPTURE(BM_LineFilterCheckCorpus, ok_flood, "ok_flood.log");
+BENCHMARK_CAPTURE(BM_LineFilterCheckCorpus, temperature_reports, "temperature_reports.log");
+BENCHMARK_CAPTURE(BM_LineFilterCheckCorpus, position_reports, "position_reports.log");
+BENCHMARK_CAPTURE(BM_LineFilterCheckCorpus, capabilities, "capabilities.log");
+BENCHMARK_CAPTURE(BM_LineFilterCheckCorpus, echo_chatter, "echo_chatter.log");
+BENCHMARK_CAPTURE(BM_LineFilterCheckCorpus, mixed_print, "mixed_print.log");
@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+#include "MeatPack/MeatPack.h"
+#include "BenchUtils.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+/// @brief Line numbered moves of a vase mode spiral, framed like GcodeStreamer sends them
+static std::vector<std::string> vase_lines(std::size_t count) {
+    std::vector<std::string> ret;
+    ret.reserve(count);
+    char buf[96];
+    for (std::size_t i = 0; i < count; ++i) {
+        const double angle = i * 0.05;
+        const int len = std::snprintf(buf, sizeof(buf), "N%zu G1 X%.3f Y%.3f Z%.3f E%.5f", i + 1,
+                                      100 + 40 * std::cos(angle), 100 + 40 * std::sin(angle), 0.2 + i * 0.0005,
+                                      0.02 + (i % 7) * 0.001);
+        std::uint8_t checksum = 0;
+        for (int j = 0; j < len; ++j) {
+            checksum ^= static_cast<std::uint8_t>(buf[j]);
+        }
+        ret.push_back(std::string(buf, len) + "*" + std::to_string(checksum) + "\n");
+    }
+    return ret;
+}
+
+/// @brief Pack short moves the way TxQueue does when the printer has MEATPACK
+static void BM_MeatPackEncode(benchmark::State& state) {
+    const auto lines = vase_lines(10000);
+    const MeatPackEncoder encoder(state.range(0) != 0);
+    std::size_t plain = 0, packed = 0;
+    std::string out;
+    for (const auto& line : lines) {
+        plain += line.size();
+        out.clear();
+        encoder.encode(line, out);
+        packed += out.size();
+    }
+
+    const auto allocs_before = alloc_count();
+    for (auto _ : state) {
+        for (const auto& line : lines) {
+            out.clear();
+            encoder.encode(line, out);
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+    set_line_counters(state, lines.size(), alloc_count() - allocs_before);
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * plain));
+    state.counters["wire_ratio"] = static_cast<double>(packed) / plain;
+}
+// 0 keeps the spaces, 1 drops them
+BENCHMARK(BM_MeatPackEncode)->Arg(0)->Arg(1);
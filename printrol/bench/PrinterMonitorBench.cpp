@@ -0,0 +1,179 @@
+#include <benchmark/benchmark.h>
+#include "PrinterMonitor/PrinterMonitor.h"
+#include "BenchUtils.h"
+
+#include <regex>
+#include <string>
+#include <array>
+
+
+/// @brief The regex based position parser PrinterMonitor used before, kept as a baseline
+static bool legacy_parse_position(const std::string& line, std::vector<float>& position) {
+    if (line.size() < 1 || line[0] != 'X') {
+        return false;
+    }
+
+    const std::string regex_ending = "([+-]?\\d*.?\\d*).*$";
+    std::array<std::string, 4> axis_names = { "X:", "Y:", "Z:", "E:" };
+    std::vector<float> pos2;
+    pos2.reserve(4);
+    for (const auto& name : axis_names) {
+        const std::string rgx = name + regex_ending;
+        std::smatch m;
+        bool res = std::regex_search(line, m, std::regex(rgx));
+        if (not res || m.size() < 2) {
+            break;
+        }
+        std::string match(m[1]);
+
+        try {
+            float pos = std::stof(match);
+            pos2.push_back(pos);
+        } catch (...) {
+        }
+    }
+
+    if (pos2.size() == 4) {
+        position = std::move(pos2);
+        return true;
+    }
+    return false;
+}
+
+static const std::string position_line = "X:-26.40 Y:127.00 Z:145.25 E:3.14 Count X:-2112 Y:10160 Z:116200";
+
+
+static void BM_ParsePositionLegacy(benchmark::State& state) {
+    std::vector<float> position;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(legacy_parse_position(position_line, position));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParsePositionLegacy);
+
+
+static void BM_ParsePosition(benchmark::State& state) {
+    PrinterMonitor mon;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mon.parse_line(position_line));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParsePosition);
+
+
+static void BM_ParseTemperature(benchmark::State& state) {
+    PrinterMonitor mon;
+    const std::string line =
+        "ok T:210.00 /210.00 B:60.00 /60.00 T0:210.00 /210.00 T1:25.50 /0.00 @:127 B@:0 @0:127 @1:0";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mon.parse_line(line));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseTemperature);
+
+
+static void BM_ParseCapability(benchmark::State& state) {
+    PrinterMonitor mon;
+    const std::string line = "Cap:EMERGENCY_PARSER:1\n";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mon.parse_line(line));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseCapability);
+
+
+static void BM_HasCapability(benchmark::State& state) {
+    PrinterMonitor mon;
+    mon.parse_line("Cap:EMERGENCY_PARSER:1\n");
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mon.has_capability(PrinterCapability::EMERGENCY_PARSER));
+    }
+}
+BENCHMARK(BM_HasCapability);
+
+
+static void BM_ParseEcho(benchmark::State& state) {
+    PrinterMonitor mon;
+    const std::string line = "echo:busy: processing\n";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mon.parse_line(line));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseEcho);
+
+
+static void BM_ParseLineCorpus(benchmark::State& state, const char* corpus) {
+    const auto lines = load_corpus(corpus);
+    PrinterMonitor mon;
+
+    const auto allocs_before = alloc_count();
+    for (auto _ : state) {
+        for (const auto& line : lines) {
+            benchmark::DoNotOptimize(mon.parse_line(line));
+        }
+    }
+    set_line_counters(state, lines.size(), alloc_count() - allocs_before);
+}
+BENCHMARK_CAPTURE(BM_ParseLineCorpus, ok_flood, "ok_flood.log");
+BENCHMARK_CAPTURE(BM_ParseLineCorpus, temperature_reports, "temperature_reports.log");
+BENCHMARK_CAPTURE(BM_ParseLineCorpus, position_reports, "position_reports.log");
+BENCHMARK_CAPTURE(BM_ParseLineCorpus, capabilities, "capabilities.log");
+BENCHMARK_CAPTURE(BM_ParseLineCorpus, echo_chatter, "echo_chatter.log");
+BENCHMARK_CAPTURE(BM_ParseLineCorpus, mixed_print, "mixed_print.log");
+
+
+static void BM_Snapshot(benchmark::State& state) {
+    PrinterMonitor mon;
+    mon.parse_line("ok T:210.00 /210.00 B:60.00 /60.00 T0:210.00 /210.00 T1:25.50 /0.00 @:127 B@:0 @0:127 @1:0");
+    mon.parse_line("X:-26.40 Y:127.00 Z:145.25 E:3.14 Count X:-2112 Y:10160 Z:116200");
+
+    const auto allocs_before = alloc_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mon.snapshot());
+    }
+    state.counters["allocs"] = benchmark::Counter(static_cast<double>(alloc_count() - allocs_before));
+}
+BENCHMARK(BM_Snapshot);
+
+
+static void BM_TimeSeriesAppend(benchmark::State& state) {
+    TimeSeries series;
+    auto time = TimeSeries::time_point();
+    // one sample per second, the history is filled long before the measurement ends
+    for (int i = 0; i < 200000; ++i) {
+        time += std::chrono::seconds(1);
+        series.append(time, static_cast<float>(i % 100));
+    }
+
+    const auto allocs_before = alloc_count();
+    for (auto _ : state) {
+        time += std::chrono::milliseconds(250);
+        series.append(time, 210.f);
+    }
+    state.counters["allocs"] = benchmark::Counter(static_cast<double>(alloc_count() - allocs_before));
+}
+BENCHMARK(BM_TimeSeriesAppend);
+
+
+static void BM_ParseLinesCorpus(benchmark::State& state, const char* corpus) {
+    const auto lines = load_corpus(corpus);
+    std::string buffer;
+    for (const auto& line : lines) {
+        buffer += line;
+    }
+    PrinterMonitor mon;
+
+    const auto allocs_before = alloc_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mon.parse_lines(buffer));
+    }
+    set_line_counters(state, lines.size(), alloc_count() - allocs_before);
+}
+BENCHMARK_CAPTURE(BM_ParseLinesCorpus, ok_flood, "ok_flood.log");
+BENCHMARK_CAPTURE(BM_ParseLinesCorpus, echo_chatter, "echo_chatter.log");
+BENCHMARK_CAPTURE(BM_ParseLinesCorpus, mixed_print, "mixed_print.log");
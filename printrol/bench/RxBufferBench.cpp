@@ -0,0 +1,38 @@
+#include <benchmark/benchmark.h>
+#include "RxBuffer/RxBuffer.h"
+#include "BenchUtils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+
+/// @brief Feed a corpus through RxBuffer in serial-sized chunks and frame its lines
+static void BM_RxBufferFrameCorpus(benchmark::State& state, const char* corpus) {
+    const auto lines = load_corpus(corpus);
+    std::string stream;
+    for (const auto& line : lines) {
+        stream += line;
+    }
+    const std::size_t chunk = state.range(0);
+    RxBuffer rx;
+
+    const auto allocs_before = alloc_count();
+    for (auto _ : state) {
+        for (std::size_t pos = 0; pos < stream.size();) {
+            const std::size_t cnt = std::min({ chunk, stream.size() - pos, rx.write_space() });
+            std::memcpy(rx.write_area(), stream.data() + pos, cnt);
+            rx.commit(cnt);
+            pos += cnt;
+
+            std::string_view line;
+            while (rx.next_line(line)) {
+                benchmark::DoNotOptimize(line.data());
+            }
+            rx.release();
+        }
+    }
+    set_line_counters(state, lines.size(), alloc_count() - allocs_before);
+}
+BENCHMARK_CAPTURE(BM_RxBufferFrameCorpus, ok_flood, "ok_flood.log")->Arg(64)->Arg(4096);
+BENCHMARK_CAPTURE(BM_RxBufferFrameCorpus, mixed_print, "mixed_print.log")->Arg(64)->Arg(4096);
@@ -0,0 +1,49 @@
+#include <benchmark/benchmark.h>
+#include "PrinterMonitor/PrinterMonitor.h"
+#include "RxBuffer/RxBuffer.h"
+#include "SerialCapture/ReplaySerial.h"
+#include "BenchUtils.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+
+/// @brief Replay a capture of a corpus at full speed into PrinterMonitor, the way CommThread reads it
+static void BM_ReplayCorpus(benchmark::State& state, const char* corpus) {
+    const auto lines = load_corpus(corpus);
+    const auto path = (std::filesystem::temp_directory_path() / "printrol_bench_replay.cap").string();
+    {
+        // one record per line, 1 ms apart
+        CaptureWriter writer(path);
+        auto time = CaptureWriter::clock_t::now();
+        for (const auto& line : lines) {
+            writer.record(capture::Direction::RX, line, time += std::chrono::milliseconds(1));
+        }
+    }
+
+    ReplaySerial serial(0);
+    RxBuffer rx;
+    PrinterMonitor mon;
+    std::vector<std::string_view> views;
+
+    const auto allocs_before = alloc_count();
+    for (auto _ : state) {
+        serial.open(std::filesystem::path(path).wstring(), 115200);
+        while (not serial.finished()) {
+            const int cnt = serial.read_some(rx.write_area(), static_cast<int>(rx.write_space()), 0);
+            rx.commit(cnt > 0 ? cnt : 0);
+
+            views.clear();
+            std::string_view line;
+            while (rx.next_line(line)) {
+                views.push_back(line);
+            }
+            benchmark::DoNotOptimize(mon.parse_lines(views.data(), views.size()));
+            rx.release();
+        }
+    }
+    set_line_counters(state, lines.size(), alloc_count() - allocs_before);
+    std::filesystem::remove(path);
+}
+BENCHMARK_CAPTURE(BM_ReplayCorpus, mixed_print, "mixed_print.log");
@@ -0,0 +1,83 @@
+#include <benchmark/benchmark.h>
+#include "VirtualPrinter/VirtualPrinter.h"
+#include "LinuxSerial/LinuxSerial.h"
+
+#include <string>
+
+
+/// @brief Connect @p serial to @p printer
+static bool connect(LinuxSerial& serial, VirtualPrinter& printer) {
+    if (not printer.start()) {
+        return false;
+    }
+    const auto& name = printer.port_name();
+    serial.open(std::wstring(name.begin(), name.end()), 115200);
+    return serial.is_open();
+}
+
+/// @brief Read until @p count "ok" lines arrived
+static bool wait_ok(LinuxSerial& serial, int count) {
+    char buf[4096];
+    char prev = '\n';
+    while (count > 0) {
+        const int cnt = serial.read_some(buf, sizeof(buf), 1000);
+        if (cnt <= 0) {
+            return false;
+        }
+        for (int i = 0; i < cnt; ++i) {
+            if (prev == '\n' && buf[i] == 'o') {
+                --count;
+            }
+            prev = buf[i];
+        }
+    }
+    return true;
+}
+
+
+/// @brief Round trip of one M105 through the pty
+static void BM_VirtualPrinterRoundTrip(benchmark::State& state) {
+    VirtualPrinter printer;
+    LinuxSerial serial;
+    if (not connect(serial, printer)) {
+        state.SkipWithError("could not open a pty");
+        return;
+    }
+
+    const std::string cmd = "M105\n";
+    for (auto _ : state) {
+        serial.write(cmd.data(), static_cast<int>(cmd.size()));
+        if (not wait_ok(serial, 1)) {
+            state.SkipWithError("no reply");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_VirtualPrinterRoundTrip)->UseRealTime();
+
+/// @brief Moves streamed with range(0) commands in flight, as limited by the printer's command buffer
+static void BM_VirtualPrinterStream(benchmark::State& state) {
+    VirtualPrinterConfig config;
+    config.move_time = std::chrono::microseconds(0);
+    VirtualPrinter printer(config);
+    LinuxSerial serial;
+    if (not connect(serial, printer)) {
+        state.SkipWithError("could not open a pty");
+        return;
+    }
+
+    const int window = static_cast<int>(state.range(0));
+    std::string burst;
+    for (int i = 0; i < window; ++i) {
+        burst += "G1 X" + std::to_string(i) + " Y10\n";
+    }
+    for (auto _ : state) {
+        serial.write(burst.data(), static_cast<int>(burst.size()));
+        if (not wait_ok(serial, window)) {
+            state.SkipWithError("no reply");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * window);
+}
+BENCHMARK(BM_VirtualPrinterStream)->Arg(1)->Arg(4)->UseRealTime();
@@ -4,14 +4,25 @@
 #include <QAtomicInt>
 #include <ISerial/ISerial.h>
 #include <PrinterMonitor/PrinterMonitor.h>
+#include <LineFilter/LineFilter.h>
+#include <RxBuffer/RxBuffer.h>
+#include <TxQueue/TxQueue.h>
+#include <GcodeStreamer/GcodeStreamer.h>
+#include <BinaryTransfer/BinaryTransfer.h>
+#include <chrono>
+#include <cstdio>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 class CommThread : public QThread {
     Q_OBJECT
 
 public:
-    CommThread() = default;
+    CommThread() {
+        txq_.set_source(&streamer_);
+    }
     ~CommThread() {
         abort_ = 1;
         while (running_) {
@@ -30,18 +41,65 @@ public:
         return mon_;
     }
 
+    /// @brief Lines matching the filter are not passed to line_received. Configure before starting the thread.
+    LineFilter& get_filter() {
+        return filter_;
+    }
+
+    /// @brief Queue commands for the printer. Thread safe.
+    /// @param commands One or more lines
+    void send(std::string commands) {
+        txq_.push(std::move(commands));
+    }
+
+    /// @brief Send M112, M108, M410 or M876 ahead of everything queued. Thread safe.
+    /// @details Wakes the thread, so the command is written at once instead of after the next read timeout. An upload
+    /// is aborted. With EMERGENCY_PARSER the command goes out between two packets, otherwise once the firmware is back
+    /// to G-code or a timeout passed.
+    void send_emergency(std::string commands) {
+        txq_.push_emergency(std::move(commands));
+        if (const auto state = transfer_.state();
+            state == BinaryTransfer::State::CONNECTING || state == BinaryTransfer::State::UPLOADING) {
+            transfer_.abort();
+        }
+        if (serial_) {
+            serial_->wake();
+        }
+    }
+
+    /// @brief Print jobs, start(), pause(), resume() and cancel() are thread safe
+    GcodeStreamer& get_streamer() {
+        return streamer_;
+    }
+
+    /// @brief Uploads to the SD card, start(), cancel() and progress() are thread safe
+    /// @details The upload waits for the queued commands and fails if a print job is running or the printer did not
+    /// report BINARY_FILE_TRANSFER.
+    BinaryTransfer& get_transfer() {
+        return transfer_;
+    }
+
     void abort() {
         abort_ = 1;
     }
 
 signals:
-    void line_received(std::string);
-    void printer_status_changed();
+    /// @param lines One or more complete lines that passed the filter, each ending with '\n'
+    void line_received(std::string lines);
+    /// @param changes PrinterChange bits of what changed
+    void printer_status_changed(PrinterMonitor::change_t changes);
 
 protected:
     void run() override {
         running_ = 1;
         mon_.reset();
+        rx_.clear();
+        txq_.reset();
+        streamer_.reset();
+        transfer_.reset();
+        transfer_started_ = false;
+        resume_meatpack_ = false;
+        last_response_ = clock_t::now();
         inner_run();
         abort_ = 0;
         running_ = 0;
@@ -55,33 +113,193 @@ private:
 
 
         forever {
-            std::uint8_t b;
-
             if (abort_) {
                 return;
             }
 
-            std::string s = mon_.request_from_printer();
-            if (s.size()) {
-                serial_->write(s.c_str(), s.size());
+            if (not serial_->is_open()) {
+                QThread::msleep(poll_timeout_ms);
+                continue;
+            }
+
+            if (transfer_.active()) {
+                run_transfer();
+            } else {
+                send_commands();
+            }
+
+            // the timeout bounds how late abort and the periodic requests are handled, not the receive latency
+            const int cnt = serial_->read_some(rx_.write_area(), static_cast<int>(rx_.write_space()), poll_timeout_ms);
+            if (cnt < 0) {
+                // the port was lost, e.g. unplugged, a failing read must not spin
+                QThread::msleep(poll_timeout_ms);
+                continue;
             }
+            if (cnt == 0) {
+                continue;
+            }
+            rx_.commit(cnt);
+            handle_lines();
+        }
+    }
 
-            if (serial_->read(&b, 1) == 1) {
-                line_buffer_ += static_cast<char>(b);
-                if (b == '\n') {
-                    emit line_received(line_buffer_);
-                    if (mon_.parse_line(line_buffer_)) {
-                        emit printer_status_changed();
-                    }
-                    line_buffer_.clear();
+    /// @brief Send queued commands and the periodic requests, pick up where the last transfer left off
+    void send_commands() {
+        if (transfer_started_) {
+            transfer_started_ = false;
+            if (resume_meatpack_) {
+                resume_meatpack_ = false;
+                txq_.enable_meatpack();
+            }
+        }
+        // polls wait until the queue is empty, so they do not pile up behind a busy printer
+        if (txq_.pending() == 0) {
+            if (std::string s = mon_.request_from_printer(); s.size()) {
+                txq_.push(std::move(s));
+            }
+        }
+        txq_.send(*serial_);
+        check_response_timeout();
+    }
+
+    /// @brief Hand the port to the transfer once the printer acknowledged every queued command
+    void run_transfer() {
+        if (transfer_started_) {
+            // the emergency parser sees the bytes before the binary protocol does
+            if (txq_.emergency_parser() && transfer_.between_packets()) {
+                if (const auto commands = txq_.take_emergency(); not commands.empty() &&
+                    serial_->write(commands.data(), static_cast<int>(commands.size())) < 0) {
+                    printf("Error: writing the emergency command failed\n");
                 }
+            }
+            if (transfer_.poll(*serial_) < 0) {
+                printf("Error: binary transfer, writing to the port failed\n");
+                transfer_.cancel();
+            }
+            return;
+        }
+        if (const auto state = streamer_.state();
+            state == GcodeStreamer::State::RUNNING || state == GcodeStreamer::State::PAUSED) {
+            printf("Error: binary transfer, a print job is running\n");
+            transfer_.cancel();
+            return;
+        }
+        // without it M28 B1 opens a file named B1 and stores every command that follows
+        if (not mon_.has_capability(PrinterCapability::BINARY_FILE_TRANSFER)) {
+            printf("Error: binary transfer, the printer does not support it\n");
+            transfer_.cancel();
+            return;
+        }
+        // the firmware would unpack the binary packets too
+        if (txq_.meatpack()) {
+            txq_.disable_meatpack();
+            resume_meatpack_ = true;
+        }
+        txq_.send(*serial_);
+        check_response_timeout();
+        if (txq_.pending() == 0 && txq_.in_flight() == 0) {
+            transfer_started_ = true;
+            transfer_.poll(*serial_);
+        }
+    }
+
+    /// @brief Parse and filter the complete lines in rx_ where they were received, then release them
+    void handle_lines() {
+        lines_.clear();
+        shown_.clear();
+        std::string_view line;
+        while (rx_.next_line(line)) {
+            lines_.push_back(line);
+            if (shows_progress(line)) {
+                last_response_ = clock_t::now();
+            }
+            if (transfer_started_) {
+                transfer_.handle_line(line);
             } else {
-                QThread::msleep(100);
+                if (line.substr(0, 2) == "ok") {
+                    txq_.acknowledge_ok(line);
+                } else if (const long number = resend_number(line); number >= 0) {
+                    txq_.resend(number);
+                }
+                streamer_.handle_line(line);
             }
+            if (filter_.check(line)) {
+                shown_ += line;
+            }
+        }
+        if (lines_.empty()) {
+            // lets a full buffer without a complete line make room
+            rx_.release();
+            return;
+        }
+
+        if (const auto changes = mon_.parse_lines(lines_.data(), lines_.size())) {
+            if (changes & PrinterChange::CAPABILITIES) {
+                txq_.set_emergency_parser(mon_.has_capability(PrinterCapability::EMERGENCY_PARSER));
+            }
+            if ((changes & PrinterChange::CAPABILITIES) && not txq_.meatpack() && not transfer_started_ &&
+                mon_.has_capability(PrinterCapability::MEATPACK)) {
+                // serial bandwidth limits short segments, packing saves about a third of it
+                txq_.enable_meatpack();
+            }
+            emit printer_status_changed(changes);
+        }
+        if (not shown_.empty()) {
+            emit line_received(shown_);
+        }
+        rx_.release();
+
+        // the oks may have made room in the printer's buffer
+        if (transfer_started_) {
+            transfer_.poll(*serial_);
+        } else {
+            txq_.send(*serial_);
         }
     }
 
-    std::string line_buffer_;
+    /// @brief Whether the line shows the printer is working through the commands, not merely alive
+    /// @details Autoreported temperatures keep coming while an ok is lost, they must not hold off the timeout. The
+    /// reports of M109 and M190 waiting are told apart by their W: field.
+    static bool shows_progress(std::string_view line) {
+        return line.substr(0, 2) == "ok" || line.substr(0, 7) == "Resend:" ||
+               line.find("busy:") != std::string_view::npos || line.find(" W:") != std::string_view::npos;
+    }
+
+    /// @brief Assume the ok got lost if the printer owes one and showed no progress for too long
+    /// @details Marlin sends busy: while a command blocks and temperatures with W: while heating, so silence is not
+    /// a long command. Without this a lost ok would stall the job forever.
+    void check_response_timeout() {
+        const auto now = clock_t::now();
+        if (txq_.in_flight() == 0) {
+            last_response_ = now;
+        } else if (now - last_response_ > response_timeout) {
+            printf("no response for %lld s, assuming a lost ok\n",
+                   static_cast<long long>(std::chrono::duration_cast<std::chrono::seconds>(response_timeout).count()));
+            txq_.acknowledge();
+            last_response_ = now;
+        }
+    }
+
+    using clock_t = std::chrono::steady_clock;
+
+    static constexpr int poll_timeout_ms = 50;
+    static constexpr auto response_timeout = std::chrono::seconds(10);
+
+    RxBuffer rx_;
+    /// views into rx_ of the burst being handled
+    std::vector<std::string_view> lines_;
+    /// lines of the burst that pass filter_
+    std::string shown_;
+    LineFilter filter_;
+    TxQueue txq_;
+    GcodeStreamer streamer_;
+    BinaryTransfer transfer_;
+    /// the transfer owns the port, commands wait until it ends
+    bool transfer_started_{ false };
+    /// meatpack was disabled for the transfer
+    bool resume_meatpack_{ false };
+    /// the last ok, Resend:, busy: or heating report, see shows_progress()
+    clock_t::time_point last_response_;
     ISerial* serial_{ nullptr };
     QAtomicInt abort_{ 0 }, running_{ 0 };
     PrinterMonitor mon_;
@@ -1,10 +1,20 @@
 #include "printrol_window.h"
 #include "./ui_printrol_window.h"
 
+#include <cwchar>
 #include <vector>
 #include <string>
 #include <QScrollBar>
 #include <QCursor>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <GcodeStreamer/MappedGcodeSource.h>
+
+/// @brief Whether @p command is one Marlin's emergency parser acts on when it arrives
+static bool is_emergency_command(const QString& command) {
+    const auto code = command.trimmed().section(' ', 0, 0).toUpper();
+    return code == "M112" || code == "M108" || code == "M410" || code == "M876";
+}
 
 PrintRolWindow::PrintRolWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui::PrintRolWindow) {
     ui->setupUi(this);
@@ -17,8 +27,19 @@ PrintRolWindow::PrintRolWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui
     connect(ui->portSelectBox->lineEdit(), &QLineEdit::returnPressed, this, &PrintRolWindow::enter_on_combobox);
     connect(ui->portBaudComboBox->lineEdit(), &QLineEdit::returnPressed, this, &PrintRolWindow::enter_on_combobox);
     connect(&comm_thrd_, &CommThread::printer_status_changed, this, &PrintRolWindow::printer_status_change);
-
-    const auto baud_list = { 9600, 14400, 19200, 38400, 57600, 115200, 128000, 256000, 1000000 };
+    connect(ui->jobPrintButton, &QPushButton::clicked, this, &PrintRolWindow::print_file);
+    connect(ui->jobPauseButton, &QPushButton::clicked, this, [this] { comm_thrd_.get_streamer().pause(); });
+    connect(ui->jobResumeButton, &QPushButton::clicked, this, [this] { comm_thrd_.get_streamer().resume(); });
+    connect(ui->jobCancelButton, &QPushButton::clicked, this, [this] {
+        comm_thrd_.get_streamer().cancel();
+        comm_thrd_.get_transfer().cancel();
+    });
+    connect(ui->jobUploadButton, &QPushButton::clicked, this, &PrintRolWindow::upload_file);
+    connect(ui->emergencyStopButton, &QPushButton::pressed, this, [this] { comm_thrd_.send_emergency("M112\n"); });
+    connect(&job_timer_, &QTimer::timeout, this, &PrintRolWindow::update_job_label);
+    job_timer_.start(500);
+
+    const auto baud_list = { 9600, 14400, 19200, 38400, 57600, 115200, 128000, 250000, 256000, 500000, 1000000 };
 
     for (auto baud : baud_list) {
         ui->portBaudComboBox->addItem(QString::number(baud));
@@ -26,12 +47,14 @@ PrintRolWindow::PrintRolWindow(QWidget* parent) : QMainWindow(parent), ui(new Ui
 
     ui->portBaudComboBox->setCurrentIndex(5);
 
-    filter_.add_filter(LineFilter::temperature_regex());
-    filter_.add_filter(LineFilter::position_regex());
+    comm_thrd_.get_filter().add_filter(LineFilter::temperature_regex());
+    comm_thrd_.get_filter().add_filter(LineFilter::position_regex());
 }
 
 void PrintRolWindow::init() {
     comm_thrd_.set_serial(serial_);
+    serial_->set_ports_changed_callback(
+        [this] { QMetaObject::invokeMethod(this, [this] { refresh_ports(); }, Qt::QueuedConnection); });
 
     refresh_ports();
     update_port_label();
@@ -42,13 +65,28 @@ PrintRolWindow::~PrintRolWindow() {
 }
 
 void PrintRolWindow::refresh_ports() {
-    auto ports = serial_->list_ports();
+    // cached by the backend, does not block
+    const auto ports = serial_->list_port_info();
 
+    const auto current = ui->portSelectBox->currentText();
     ui->portSelectBox->clear();
-    for (const auto& port : ports) {
-        auto qstr = QString::fromStdWString(port);
-        ui->portSelectBox->addItem(qstr);
+    for (const auto& info : ports) {
+        ui->portSelectBox->addItem(QString::fromStdWString(info.port));
+
+        std::wstring tooltip = info.description;
+        if (info.vid || info.pid) {
+            wchar_t ids[16];
+            std::swprintf(ids, 16, L" [%04X:%04X]", info.vid, info.pid);
+            tooltip += ids;
+        }
+        if (not info.serial_number.empty()) {
+            tooltip += L" S/N " + info.serial_number;
+        }
+        ui->portSelectBox->setItemData(ui->portSelectBox->count() - 1, QString::fromStdWString(tooltip),
+                                       Qt::ToolTipRole);
     }
+    // keep the selection when other ports come and go
+    ui->portSelectBox->setCurrentText(current);
 }
 
 
@@ -102,21 +140,19 @@ void PrintRolWindow::send_to_printer(const QString& qstr) {
     if (not serial_->is_open()) {
         return;
     }
-    std::string stdstr = qstr.toStdString();
-
-    serial_->write(stdstr.c_str(), stdstr.length());
-}
-
-void PrintRolWindow::line_received(std::string str) {
-    if (not filter_.check(str)) {
+    if (is_emergency_command(qstr)) {
+        comm_thrd_.send_emergency(qstr.toStdString());
         return;
     }
+    comm_thrd_.send(qstr.toStdString());
+}
 
+void PrintRolWindow::line_received(std::string lines) {
     auto& bar = *ui->historyTextEdit->verticalScrollBar();
     bool scroll = bar.maximum() == bar.sliderPosition();
     auto old_cursor = ui->historyTextEdit->textCursor();
     ui->historyTextEdit->moveCursor(QTextCursor::End);
-    ui->historyTextEdit->insertPlainText(QString::fromStdString(str));
+    ui->historyTextEdit->insertPlainText(QString::fromStdString(lines));
 
     ui->historyTextEdit->setTextCursor(old_cursor);
 
@@ -131,31 +167,122 @@ void PrintRolWindow::enter_on_combobox() {
     }
 }
 
-void PrintRolWindow::printer_status_change() {
-    const auto& printer = comm_thrd_.get_printer();
-    {
-        const auto pos = printer.get_position();
-        if (pos.size() >= 4) {
-            ui->xPosLabel->setText(QString("X:") + QString::number(pos[0]));
-            ui->yPosLabel->setText(QString("Y:") + QString::number(pos[1]));
-            ui->zPosLabel->setText(QString("Z:") + QString::number(pos[2]));
-            ui->ePosLabel->setText(QString("E:") + QString::number(pos[3]));
-        }
+void PrintRolWindow::printer_status_change(PrinterMonitor::change_t changes) {
+    const auto state = comm_thrd_.get_printer().snapshot();
+    if (changes & PrinterChange::POSITION) {
+        auto set_axis_label = [&state](QLabel* label, char axis) {
+            if (const auto pos = state.axis_position(axis)) {
+                label->setText(QString(QChar(axis)) + ":" + QString::number(*pos));
+            }
+        };
+        set_axis_label(ui->xPosLabel, 'X');
+        set_axis_label(ui->yPosLabel, 'Y');
+        set_axis_label(ui->zPosLabel, 'Z');
+        set_axis_label(ui->ePosLabel, 'E');
     }
-    {
-        const auto h0_temp = printer.get_hotend_temp();
-        if (h0_temp.has_value()) {
-            ui->eTempAct->setText(QString::number(h0_temp->actual));
-            ui->eTempSet->setText(QString::number(h0_temp->set));
-            ui->eTempPower->setText(QString::number(h0_temp->power));
-        }
+    if ((changes & PrinterChange::hotend(0)) && not state.hotends.empty()) {
+        const auto& h0_temp = state.hotends[0];
+        ui->eTempAct->setText(QString::number(h0_temp.actual));
+        ui->eTempSet->setText(QString::number(h0_temp.set));
+        ui->eTempPower->setText(QString::number(h0_temp.power));
     }
-    {
-        const auto bed_temp = printer.get_bed_temp();
-        if (bed_temp.has_value()) {
-            ui->bedTempAct->setText(QString::number(bed_temp->actual));
-            ui->bedTempSet->setText(QString::number(bed_temp->set));
-            ui->bedTempPower->setText(QString::number(bed_temp->power));
-        }
+    if ((changes & PrinterChange::BED) && state.bed.has_value()) {
+        const auto& bed_temp = *state.bed;
+        ui->bedTempAct->setText(QString::number(bed_temp.actual));
+        ui->bedTempSet->setText(QString::number(bed_temp.set));
+        ui->bedTempPower->setText(QString::number(bed_temp.power));
+    }
+}
+
+void PrintRolWindow::print_file() {
+    const auto path =
+        QFileDialog::getOpenFileName(this, "Print G-code", QString(), "G-code (*.gcode *.gco *.g);;All (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+    if (auto job = MappedGcodeSource::open(path.toStdString())) {
+        comm_thrd_.get_streamer().start(std::move(job));
+    }
+}
+
+void PrintRolWindow::upload_file() {
+    const auto path =
+        QFileDialog::getOpenFileName(this, "Upload to SD", QString(), "G-code (*.gcode *.gco *.g);;All (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+    // Marlin's SD library handles 8.3 names only
+    const auto info = QFileInfo(path);
+    const auto name = info.completeBaseName().left(8) + "." + info.suffix().left(3);
+    if (not comm_thrd_.get_transfer().start(path.toStdString(), name.toStdString())) {
+        ui->jobStatusLabel->setText("Upload failed to start");
+    }
+}
+
+bool PrintRolWindow::update_upload_label() {
+    using State = BinaryTransfer::State;
+    const auto progress = comm_thrd_.get_transfer().progress();
+
+    QString text;
+    switch (progress.state) {
+        case State::IDLE:
+            return false;
+        case State::CONNECTING:
+            text = "Connecting";
+            break;
+        case State::UPLOADING:
+            text = "Uploading";
+            break;
+        case State::FINISHED:
+            text = "Uploaded";
+            break;
+        case State::CANCELLED:
+            text = "Upload cancelled";
+            break;
+        case State::FAILED:
+            text = "Upload failed";
+            break;
+    }
+    const double percent = progress.size ? 100. * progress.position / progress.size : 100.;
+    text += " " + QString::number(percent, 'f', 1) + "% " + QString::number(progress.bytes_per_second / 1024., 'f', 1) +
+            " KiB/s";
+    if (progress.compressed && progress.wire_bytes) {
+        text += " x" + QString::number(static_cast<double>(progress.position) / progress.wire_bytes, 'f', 2);
+    }
+    ui->jobStatusLabel->setText(text);
+    return true;
+}
+
+void PrintRolWindow::update_job_label() {
+    using State = GcodeStreamer::State;
+    const auto progress = comm_thrd_.get_streamer().progress();
+    const auto upload = comm_thrd_.get_transfer().state();
+    const bool uploading = upload == BinaryTransfer::State::CONNECTING || upload == BinaryTransfer::State::UPLOADING;
+    if ((uploading || progress.state == State::IDLE) && update_upload_label()) {
+        return;
+    }
+
+    QString text;
+    switch (progress.state) {
+        case State::IDLE:
+            ui->jobStatusLabel->setText("No job");
+            return;
+        case State::RUNNING:
+            text = progress.busy ? "Busy" : "Printing";
+            break;
+        case State::PAUSED:
+            text = "Paused";
+            break;
+        case State::FINISHED:
+            text = "Finished";
+            break;
+        case State::CANCELLED:
+            text = "Cancelled";
+            break;
+        case State::FAILED:
+            text = "Failed";
+            break;
     }
+    const double percent = progress.size ? 100. * progress.position / progress.size : 100.;
+    ui->jobStatusLabel->setText(text + " " + QString::number(percent) + "%");
 }
@@ -2,6 +2,7 @@
 #define PRINTROLWINDOW_H
 
 #include <QMainWindow>
+#include <QTimer>
 #include <ISerial/ISerial.h>
 #include "CommThread.h"
 #include <LineFilter/LineFilter.h>
@@ -35,12 +36,19 @@ private slots:
     void send_to_printer(const QString& str);
     void line_received(std::string);
     void enter_on_combobox();
-    void printer_status_change();
+    void printer_status_change(PrinterMonitor::change_t changes);
+    void print_file();
+    void upload_file();
+    void update_job_label();
 
 private:
+    /// @brief Show the upload instead of the job
+    /// @return false if there is no upload to show
+    bool update_upload_label();
+
     Ui::PrintRolWindow* ui;
     ISerial* serial_;
     CommThread comm_thrd_;
-    LineFilter filter_;
+    QTimer job_timer_;
 };
 #endif  // PRINTROLWINDOW_H
@@ -0,0 +1,98 @@
+#include <VirtualPrinter/VirtualPrinter.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+static void on_signal(int) {
+    stop_requested = 1;
+}
+
+static void usage(const char* name) {
+    std::printf(
+        "Usage: %s [options]\n"
+        "Serve virtual Marlin printers on pseudo-terminals until interrupted.\n\n"
+        "  -n COUNT        number of printers (1)\n"
+        "  --latency US    reply latency in microseconds (0)\n"
+        "  --jitter US     random extra latency in microseconds (0)\n"
+        "  --planner N     planner buffer size in moves (16)\n"
+        "  --move-time US  execution time of one move in microseconds (2000)\n"
+        "  --rx-buffer N   printer RX buffer in bytes, 0 for unlimited (128)\n"
+        "  --hotends N     number of hotends (1)\n"
+        "  --no-autoreport do not support M155/M154\n",
+        name);
+}
+
+int main(int argc, char* argv[]) {
+    VirtualPrinterConfig config;
+    int count = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        auto number = [&]() {
+            ++i;
+            return std::strtol(value, nullptr, 10);
+        };
+
+        if (std::strcmp(arg, "--no-autoreport") == 0) {
+            config.autoreport = false;
+        } else if (value == nullptr) {
+            usage(argv[0]);
+            return 1;
+        } else if (std::strcmp(arg, "-n") == 0) {
+            count = static_cast<int>(number());
+        } else if (std::strcmp(arg, "--latency") == 0) {
+            config.latency = std::chrono::microseconds(number());
+        } else if (std::strcmp(arg, "--jitter") == 0) {
+            config.jitter = std::chrono::microseconds(number());
+        } else if (std::strcmp(arg, "--planner") == 0) {
+            config.planner_size = number();
+        } else if (std::strcmp(arg, "--move-time") == 0) {
+            config.move_time = std::chrono::microseconds(number());
+        } else if (std::strcmp(arg, "--rx-buffer") == 0) {
+            config.rx_buffer_size = number();
+        } else if (std::strcmp(arg, "--hotends") == 0) {
+            config.hotends = number();
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<std::unique_ptr<VirtualPrinter>> printers;
+    for (int i = 0; i < count; ++i) {
+        config.seed = i + 1;
+        auto printer = std::make_unique<VirtualPrinter>(config);
+        if (not printer->start()) {
+            std::fprintf(stderr, "Failed to open a pty: %s\n", std::strerror(errno));
+            return 1;
+        }
+        std::printf("%s\n", printer->port_name().c_str());
+        printers.push_back(std::move(printer));
+    }
+    std::fflush(stdout);
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    while (not stop_requested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    for (const auto& printer : printers) {
+        const auto stats = printer->stats();
+        std::printf("%s: %llu commands, %llu bytes in, %llu bytes out, %llu resends, %llu bytes dropped\n",
+                    printer->port_name().c_str(), static_cast<unsigned long long>(stats.commands),
+                    static_cast<unsigned long long>(stats.bytes_in), static_cast<unsigned long long>(stats.bytes_out),
+                    static_cast<unsigned long long>(stats.resends), static_cast<unsigned long long>(stats.dropped));
+    }
+    return 0;
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <ISerial/ISerial.h>
+#include "BinaryTransfer/Heatshrink.h"
+
+
+/// @brief Marlin's binary file transfer protocol, enabled by BINARY_FILE_TRANSFER
+/// @details "M28 B1" switches the firmware to packets:
+/// token 0xB5AD, sync, protocol << 4 | type, payload size, header checksum, then the payload and its checksum.
+/// Numbers are little endian. The payload checksum covers the header too. The firmware answers every packet with
+/// "ok<sync>" or asks for a resend with "rs<sync>", file operations add "PFT:" lines after the ok.
+namespace binary_transfer {
+
+static constexpr std::uint16_t packet_token = 0xB5AD;
+
+enum class Protocol : std::uint8_t {
+    CONTROL = 0,
+    FILE_TRANSFER = 1,
+};
+
+/// @brief Packet types of Protocol::CONTROL
+enum class Control : std::uint8_t {
+    /// answered by "ss<sync>,<max payload>,<version>" whatever the sync is
+    SYNC = 1,
+    /// back to G-code
+    CLOSE = 2,
+};
+
+/// @brief Packet types of Protocol::FILE_TRANSFER
+enum class File : std::uint8_t {
+    /// answered by "PFT:version:<version>:compression:<none or heatshrink,<window>,<lookahead>>"
+    QUERY = 0,
+    /// payload: dummy flag, compression flag, file name, '\0'
+    OPEN = 1,
+    CLOSE = 2,
+    WRITE = 3,
+    ABORT = 4,
+};
+
+/// @brief Continue the checksum @p checksum over @p data, a Fletcher-16 modulo 255
+std::uint16_t checksum(std::string_view data, std::uint16_t checksum = 0);
+
+/// @brief Append the packet to @p out
+/// @param type Control or File value
+void build_packet(std::uint8_t sync, Protocol protocol, std::uint8_t type, std::string_view payload, std::string& out);
+
+}  // namespace binary_transfer
+
+
+struct BinaryTransferConfig {
+    /// packets sent before the first ok returns, 1 waits for every ok like Marlin's reference host
+    std::size_t window{ 1 };
+    /// heatshrink the file if the firmware supports it
+    bool compress{ true };
+    /// without a response for this long the packets are sent again
+    std::chrono::milliseconds timeout{ 1000 };
+    /// timeouts and resend requests in a row before the transfer fails
+    int max_retries{ 10 };
+};
+
+/// @brief Uploads a file to the printer's SD card with Marlin's binary transfer protocol
+/// @details Driven by the comm thread, which hands it the port while active() and passes it every received line. It
+/// switches the firmware to binary mode with "M28 B1", syncs, opens the file and streams WRITE packets of the payload
+/// size the firmware reported. Up to window packets go out ahead of their ok; a resend request or a timeout sends
+/// everything from the requested packet again. The file is heatshrink compressed on the fly if the firmware supports
+/// it. At the end, or after an error or cancel(), the firmware is switched back to G-code.
+///
+/// start(), cancel() and progress() may be called from any thread, everything else only from the comm thread.
+class BinaryTransfer {
+public:
+    using Config = BinaryTransferConfig;
+    using clock_t = std::chrono::steady_clock;
+
+    enum class State : std::uint8_t {
+        IDLE,
+        /// switching to binary mode, syncing and opening the file
+        CONNECTING,
+        UPLOADING,
+        FINISHED,
+        CANCELLED,
+        FAILED,
+    };
+
+    struct Progress {
+        State state;
+        /// bytes of the file acknowledged by the printer and total
+        std::uint64_t position, size;
+        /// bytes written to the port, packets and resends included
+        std::uint64_t wire_bytes;
+        std::uint64_t resends;
+        bool compressed;
+        /// file bytes per second since the transfer started
+        double bytes_per_second;
+    };
+
+    explicit BinaryTransfer(const Config& config = Config());
+
+    /// @brief Upload the file @p path as @p name. Thread safe.
+    /// @return false if the file can not be read or a transfer is running
+    bool start(const std::string& path, const std::string& name);
+    /// @brief Abort the upload and delete the partial file. Thread safe.
+    void cancel();
+    /// @brief Cancel for a command that can not wait, the firmware gets one timeout to leave binary mode. Thread safe.
+    /// @details Afterwards the transfer ends anyway, the firmware may still be in binary mode then.
+    void abort();
+
+    /// @brief Thread safe
+    Progress progress() const;
+    /// @brief Thread safe
+    State state() const {
+        return state_.load(std::memory_order_acquire);
+    }
+
+    /// @brief Whether the port belongs to the transfer, takes a started transfer over
+    /// @details The comm thread must not write G-code while it is active, and should start it only once all G-code was
+    /// acknowledged.
+    bool active();
+    /// @brief Write what is due and send again what timed out
+    /// @return Bytes written, negative on a port error
+    int poll(ISerial& serial, clock_t::time_point now = clock_t::now());
+    /// @brief Handle a line received while active()
+    void handle_line(std::string_view line, clock_t::time_point now = clock_t::now());
+    /// @brief Whether no packet is partly written, so other bytes written now do not split one
+    bool between_packets() const {
+        return written_ == 0;
+    }
+
+    /// @brief Forget the transfer, e.g. after the port was closed
+    void reset();
+
+private:
+    /// @brief Where the transfer is, each waits for one kind of response
+    enum class Step : std::uint8_t {
+        /// "M28 B1" sent, waiting for "Switching to Binary Protocol"
+        SWITCH,
+        /// waiting for "ss"
+        SYNC,
+        /// waiting for "PFT:version"
+        QUERY,
+        /// waiting for "PFT:success"
+        OPEN,
+        /// streaming WRITE packets
+        WRITE,
+        /// waiting for "PFT:success" of the file close or abort
+        CLOSE,
+        /// waiting for the ok of the control CLOSE
+        LEAVE,
+    };
+
+    struct Packet {
+        std::uint8_t sync;
+        std::string data;
+        /// file bytes consumed up to the end of this packet
+        std::uint64_t position;
+    };
+
+    void send_packet(binary_transfer::Protocol protocol, std::uint8_t type, std::string_view payload = {});
+    void send_file(binary_transfer::File type, std::string_view payload = {}) {
+        send_packet(binary_transfer::Protocol::FILE_TRANSFER, static_cast<std::uint8_t>(type), payload);
+    }
+    void send_open();
+    void send_sync();
+    /// @brief Queue WRITE packets while the window has room, CLOSE after the last one
+    void fill_window();
+    /// @brief Next payload of the file, empty at its end
+    std::string_view next_payload();
+    /// @brief Send everything from the unacknowledged packet @p sync again
+    void rewind(std::uint8_t sync);
+    void acknowledged(std::uint8_t sync);
+    /// @brief Leave binary mode and end in @p state
+    void finish(State state);
+    /// @brief End in @p state without leaving binary mode
+    void end(State state);
+    void set_state(State state);
+    void parse_version(std::string_view version);
+
+    Config config_;
+
+    // shared with the other threads
+    mutable std::mutex mtx_;
+    std::unique_ptr<std::ifstream> new_file_;
+    std::string new_name_;
+    std::atomic<bool> start_requested_{ false }, cancel_requested_{ false }, abort_requested_{ false };
+    std::atomic<State> state_{ State::IDLE };
+    std::atomic<std::uint64_t> position_{ 0 }, size_{ 0 }, wire_bytes_{ 0 }, resends_{ 0 };
+    std::atomic<bool> compressed_{ false };
+    std::atomic<clock_t::rep> start_time_{ 0 }, end_time_{ 0 };
+
+    // comm thread only
+    std::unique_ptr<std::ifstream> file_;
+    std::string name_;
+    Step step_{ Step::SWITCH };
+    /// state to end in after Step::LEAVE
+    State final_{ State::FINISHED };
+    /// binary mode and the sync are established
+    bool synced_{ false };
+    std::uint8_t sync_{ 0 };
+    std::size_t max_payload_{ 0 };
+    /// set if the firmware decompresses
+    std::unique_ptr<HeatshrinkEncoder> encoder_;
+    /// bytes of the file read and its size
+    std::uint64_t read_{ 0 }, file_size_{ 0 };
+    /// every WRITE packet is queued
+    bool file_done_{ false };
+    /// compressed bytes not packed yet
+    std::string packed_;
+    std::string payload_;
+    /// PFT:success lines still due for packets before the one waited for
+    int skip_success_{ 0 };
+
+    /// packets sent or due to be sent and not acknowledged yet, in sync order
+    std::deque<Packet> unacked_;
+    /// index of the next packet in unacked_ to write, and bytes of it already written
+    std::size_t next_write_{ 0 }, written_{ 0 };
+    /// a resend request that waits for the packet being written to complete
+    std::optional<std::uint8_t> pending_rewind_;
+    /// raw bytes to write before the packets, "M28 B1" and SYNC
+    std::string raw_;
+    /// last response or write, the timeout runs from here
+    clock_t::time_point last_activity_;
+    /// set by abort(), the transfer ends at the latest then
+    std::optional<clock_t::time_point> abort_deadline_;
+    int retries_{ 0 };
+};
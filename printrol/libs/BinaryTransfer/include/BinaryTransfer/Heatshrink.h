@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// @brief Streaming heatshrink (LZSS) compressor, the format Marlin decompresses binary transfers with
+/// @details The output is a bit stream, most significant bit first. A 1 bit is followed by a literal byte, a 0 bit by
+/// window_bits of (distance - 1) and lookahead_bits of (length - 1) of a back reference. The last byte is padded with 0
+/// bits. Matches are found through hash chains over the window, so compressing does not slow down with the window size.
+class HeatshrinkEncoder {
+public:
+    /// @brief Marlin's HEATSHRINK_STATIC_WINDOW_BITS and HEATSHRINK_STATIC_LOOKAHEAD_BITS are 8 and 4
+    explicit HeatshrinkEncoder(unsigned window_bits = 8, unsigned lookahead_bits = 4);
+
+    /// @brief Compress @p input and append the finished bytes to @p out
+    /// @details The last lookahead bytes are kept back until more input or finish() tells how they continue.
+    void sink(std::string_view input, std::string& out);
+    /// @brief Compress what was kept back and pad the last byte, the encoder is reset afterwards
+    void finish(std::string& out);
+
+private:
+    void compress(std::string& out, bool final);
+    void put_bits(std::uint32_t value, unsigned count, std::string& out);
+    void insert(std::size_t pos);
+    std::uint32_t hash(std::size_t pos) const;
+
+    unsigned window_bits_, lookahead_bits_;
+    std::size_t window_, max_length_, min_length_;
+
+    /// window history followed by the input not compressed yet
+    std::string buf_;
+    /// position in the stream of buf_[0]
+    std::uint64_t base_{ 0 };
+    /// first byte of buf_ not compressed yet
+    std::size_t pos_{ 0 };
+    /// latest stream position + 1 of each hash, 0 for none
+    std::vector<std::uint64_t> head_;
+    /// previous stream position + 1 with the same hash, by position in the window
+    std::vector<std::uint64_t> prev_;
+
+    std::uint32_t bits_{ 0 };
+    unsigned bit_count_{ 0 };
+};
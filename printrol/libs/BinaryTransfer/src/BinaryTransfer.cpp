@@ -0,0 +1,521 @@
+#include "BinaryTransfer/BinaryTransfer.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
+
+
+/// gather write segments per poll()
+static constexpr std::size_t max_segments = 64;
+/// file bytes compressed at once
+static constexpr std::size_t read_chunk = 16 * 1024;
+
+
+/// @brief Parse the unsigned number at the start of @p text
+/// @return false if @p text does not start with one
+template <typename T>
+static bool parse_number(std::string_view text, T& value, std::string_view* rest = nullptr) {
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc()) {
+        return false;
+    }
+    if (rest) {
+        *rest = text.substr(ptr - text.data());
+    }
+    return true;
+}
+
+static void put_u16(std::uint16_t value, std::string& out) {
+    out += static_cast<char>(value & 0xFF);
+    out += static_cast<char>(value >> 8);
+}
+
+
+std::uint16_t binary_transfer::checksum(std::string_view data, std::uint16_t checksum) {
+    unsigned low = checksum & 0xFF, high = checksum >> 8;
+    for (const char c : data) {
+        low = (low + static_cast<std::uint8_t>(c)) % 255;
+        high = (high + low) % 255;
+    }
+    return static_cast<std::uint16_t>(high << 8 | low);
+}
+
+void binary_transfer::build_packet(std::uint8_t sync, Protocol protocol, std::uint8_t type, std::string_view payload,
+                                   std::string& out) {
+    put_u16(packet_token, out);
+    const auto header = out.size();
+    out += static_cast<char>(sync);
+    out += static_cast<char>(static_cast<std::uint8_t>(protocol) << 4 | (type & 0xF));
+    put_u16(static_cast<std::uint16_t>(payload.size()), out);
+    put_u16(checksum(std::string_view(out).substr(header)), out);
+    if (not payload.empty()) {
+        const auto cs = checksum(payload, checksum(std::string_view(out).substr(header)));
+        out.append(payload);
+        put_u16(cs, out);
+    }
+}
+
+
+BinaryTransfer::BinaryTransfer(const Config& config) : config_(config) {
+    config_.window = std::max<std::size_t>(config_.window, 1);
+}
+
+bool BinaryTransfer::start(const std::string& path, const std::string& name) {
+    auto file = std::make_unique<std::ifstream>(path, std::ios::binary);
+    if (not *file) {
+        printf("Error: can not open %s\n", path.c_str());
+        return false;
+    }
+    std::lock_guard<std::mutex> l(mtx_);
+    if (start_requested_ || state() == State::CONNECTING || state() == State::UPLOADING) {
+        return false;
+    }
+    new_file_ = std::move(file);
+    new_name_ = name;
+    cancel_requested_ = false;
+    abort_requested_ = false;
+    start_requested_.store(true, std::memory_order_release);
+    return true;
+}
+
+void BinaryTransfer::cancel() {
+    cancel_requested_ = true;
+}
+
+void BinaryTransfer::abort() {
+    abort_requested_ = true;
+    cancel_requested_ = true;
+}
+
+BinaryTransfer::Progress BinaryTransfer::progress() const {
+    const auto position = position_.load(std::memory_order_relaxed);
+    const auto start = start_time_.load(), end = end_time_.load();
+    const auto elapsed = clock_t::duration((end ? end : clock_t::now().time_since_epoch().count()) - start);
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    return { state(),   position,    size_, wire_bytes_,
+             resends_,  compressed_, start && seconds > 0 ? position / seconds : 0. };
+}
+
+void BinaryTransfer::set_state(State state) {
+    state_.store(state, std::memory_order_release);
+}
+
+bool BinaryTransfer::active() {
+    const auto now = clock_t::now();
+    if (start_requested_.exchange(false, std::memory_order_acquire)) {
+        {
+            std::lock_guard<std::mutex> l(mtx_);
+            file_ = std::move(new_file_);
+            name_ = new_name_;
+        }
+        file_->seekg(0, std::ios::end);
+        file_size_ = static_cast<std::uint64_t>(file_->tellg());
+        file_->seekg(0);
+
+        unacked_.clear();
+        next_write_ = written_ = 0;
+        pending_rewind_.reset();
+        abort_deadline_.reset();
+        encoder_.reset();
+        packed_.clear();
+        read_ = 0;
+        file_done_ = false;
+        skip_success_ = 0;
+        synced_ = false;
+        final_ = State::FINISHED;
+        retries_ = 0;
+        last_activity_ = now;
+
+        position_ = 0;
+        size_ = file_size_;
+        wire_bytes_ = 0;
+        resends_ = 0;
+        compressed_ = false;
+        start_time_ = now.time_since_epoch().count();
+        end_time_ = 0;
+        set_state(State::CONNECTING);
+
+        step_ = Step::SWITCH;
+        raw_ = "M28 B1\n";
+    }
+
+    const auto state = this->state();
+    if (state != State::CONNECTING && state != State::UPLOADING) {
+        cancel_requested_ = false;
+        abort_requested_ = false;
+        return false;
+    }
+
+    if (cancel_requested_.exchange(false)) {
+        switch (step_) {
+            case Step::SWITCH:
+            case Step::SYNC:
+                if (wire_bytes_ == 0) {
+                    // M28 B1 is not sent yet
+                    end(State::CANCELLED);
+                    return false;
+                }
+                // the firmware may be in binary mode already, SYNC is answered whatever the sync is and the CLOSE
+                // after it leaves. Like abort(), the transfer ends anyway after one timeout.
+                final_ = State::CANCELLED;
+                abort_requested_ = true;
+                break;
+            case Step::QUERY:
+                finish(State::CANCELLED);
+                break;
+            case Step::OPEN:
+            case Step::WRITE:
+                // the pending PFT:success of the open comes before the one of the abort
+                skip_success_ += step_ == Step::OPEN;
+                unacked_.resize(next_write_ + (written_ > 0));
+                send_file(binary_transfer::File::ABORT);
+                step_ = Step::CLOSE;
+                final_ = State::CANCELLED;
+                break;
+            case Step::CLOSE:
+            case Step::LEAVE:
+                // ending anyway
+                break;
+        }
+    }
+    return true;
+}
+
+void BinaryTransfer::send_packet(binary_transfer::Protocol protocol, std::uint8_t type, std::string_view payload) {
+    Packet packet{ sync_++, {}, read_ };
+    binary_transfer::build_packet(packet.sync, protocol, type, payload, packet.data);
+    unacked_.push_back(std::move(packet));
+}
+
+void BinaryTransfer::send_open() {
+    std::string payload;
+    // not a dummy transfer
+    payload += '\0';
+    payload += encoder_ ? '\1' : '\0';
+    payload += name_;
+    payload += '\0';
+    send_file(binary_transfer::File::OPEN, payload);
+}
+
+void BinaryTransfer::send_sync() {
+    binary_transfer::build_packet(0, binary_transfer::Protocol::CONTROL,
+                                  static_cast<std::uint8_t>(binary_transfer::Control::SYNC), {}, raw_);
+}
+
+std::string_view BinaryTransfer::next_payload() {
+    if (not encoder_) {
+        payload_.resize(max_payload_);
+        file_->read(&payload_[0], static_cast<std::streamsize>(payload_.size()));
+        payload_.resize(static_cast<std::size_t>(file_->gcount()));
+        read_ += payload_.size();
+        return payload_;
+    }
+
+    std::string chunk;
+    while (packed_.size() < max_payload_ && read_ < file_size_) {
+        chunk.resize(read_chunk);
+        file_->read(&chunk[0], static_cast<std::streamsize>(chunk.size()));
+        chunk.resize(static_cast<std::size_t>(file_->gcount()));
+        if (chunk.empty()) {
+            // shorter than it was when started
+            file_size_ = read_;
+            encoder_->finish(packed_);
+            break;
+        }
+        read_ += chunk.size();
+        encoder_->sink(chunk, packed_);
+        if (read_ >= file_size_) {
+            encoder_->finish(packed_);
+        }
+    }
+    const auto size = std::min(max_payload_, packed_.size());
+    payload_.assign(packed_, 0, size);
+    packed_.erase(0, size);
+    return payload_;
+}
+
+void BinaryTransfer::fill_window() {
+    while (not file_done_ && unacked_.size() < config_.window) {
+        const auto payload = next_payload();
+        if (payload.empty()) {
+            file_done_ = true;
+            break;
+        }
+        send_file(binary_transfer::File::WRITE, payload);
+    }
+    // the close takes a place in the window like the writes
+    if (file_done_ && unacked_.size() < config_.window) {
+        send_file(binary_transfer::File::CLOSE);
+        step_ = Step::CLOSE;
+    }
+}
+
+void BinaryTransfer::rewind(std::uint8_t sync) {
+    const auto it =
+        std::find_if(unacked_.begin(), unacked_.end(), [sync](const Packet& packet) { return packet.sync == sync; });
+    // the firmware waits for a packet that was not sent yet
+    if (it == unacked_.end() || static_cast<std::size_t>(it - unacked_.begin()) >= next_write_ + (written_ > 0)) {
+        return;
+    }
+    if (written_ > 0) {
+        // the packet being written is completed first, the firmware drops it
+        pending_rewind_ = sync;
+        return;
+    }
+    // the firmware received everything before the requested packet
+    const auto received = static_cast<std::size_t>(it - unacked_.begin());
+    if (received > 0) {
+        position_ = unacked_[received - 1].position;
+        unacked_.erase(unacked_.begin(), it);
+    }
+    next_write_ = 0;
+    resends_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BinaryTransfer::acknowledged(std::uint8_t sync) {
+    const auto written = next_write_;
+    std::size_t count = 0;
+    while (count < written && unacked_[count].sync != sync) {
+        ++count;
+    }
+    if (count == written) {
+        // not sent, or an ok repeated for a packet sent twice
+        return;
+    }
+    position_ = unacked_[count].position;
+    unacked_.erase(unacked_.begin(), unacked_.begin() + count + 1);
+    next_write_ -= count + 1;
+    retries_ = 0;
+
+    if (step_ == Step::LEAVE && unacked_.empty()) {
+        if (final_ == State::FINISHED) {
+            position_ = size_.load();
+        }
+        end(final_);
+    }
+}
+
+void BinaryTransfer::parse_version(std::string_view version) {
+    // "0.1.0:compression:heatshrink,8,4"
+    constexpr std::string_view heatshrink = "heatshrink,";
+    const auto pos = version.find(heatshrink);
+    if (not config_.compress || pos == std::string_view::npos) {
+        return;
+    }
+    std::string_view rest = version.substr(pos + heatshrink.size());
+    unsigned window = 0, lookahead = 0;
+    if (parse_number(rest, window, &rest) && rest.size() > 1 && parse_number(rest.substr(1), lookahead) &&
+        window >= 4 && window <= 15 && lookahead >= 3 && lookahead < window) {
+        encoder_ = std::make_unique<HeatshrinkEncoder>(window, lookahead);
+        compressed_ = true;
+    }
+}
+
+void BinaryTransfer::handle_line(std::string_view line, clock_t::time_point now) {
+    while (not line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+        line.remove_suffix(1);
+    }
+    const auto starts = [line](std::string_view prefix) { return line.substr(0, prefix.size()) == prefix; };
+    const auto state = this->state();
+    if (state != State::CONNECTING && state != State::UPLOADING) {
+        return;
+    }
+
+    std::uint8_t sync = 0;
+    if (starts("ok")) {
+        // a plain ok of M28 B1 does not mean binary mode, without BINARY_FILE_TRANSFER it opened the file "B1"
+        if (parse_number(line.substr(2), sync) && synced_) {
+            last_activity_ = now;
+            acknowledged(sync);
+        }
+    } else if (starts("rs")) {
+        if (parse_number(line.substr(2), sync) && synced_) {
+            last_activity_ = now;
+            if (++retries_ > config_.max_retries) {
+                printf("Error: binary transfer, too many resend requests\n");
+                finish(State::FAILED);
+            } else {
+                rewind(sync);
+            }
+        }
+    } else if (starts("ss")) {
+        std::string_view rest;
+        std::size_t max_payload = 0;
+        if (step_ == Step::SYNC && parse_number(line.substr(2), sync, &rest) && rest.substr(0, 1) == "," &&
+            parse_number(rest.substr(1), max_payload) && max_payload > 0) {
+            last_activity_ = now;
+            sync_ = sync;
+            max_payload_ = max_payload;
+            synced_ = true;
+            retries_ = 0;
+            raw_.clear();
+            if (final_ == State::CANCELLED) {
+                finish(State::CANCELLED);
+            } else {
+                step_ = Step::QUERY;
+                send_file(binary_transfer::File::QUERY);
+            }
+        }
+    } else if (starts("fe")) {
+        printf("Error: binary transfer, fatal error in the firmware\n");
+        finish(State::FAILED);
+    } else if (starts("PFT:version:")) {
+        if (step_ == Step::QUERY) {
+            last_activity_ = now;
+            parse_version(line.substr(12));
+            send_open();
+            step_ = Step::OPEN;
+        }
+    } else if (starts("PFT:success")) {
+        last_activity_ = now;
+        if (skip_success_ > 0) {
+            --skip_success_;
+        } else if (step_ == Step::OPEN) {
+            step_ = Step::WRITE;
+            set_state(State::UPLOADING);
+        } else if (step_ == Step::CLOSE) {
+            finish(final_);
+        }
+    } else if (starts("PFT:busy")) {
+        if (step_ == Step::OPEN && skip_success_ == 0) {
+            // a previous transfer is still open, abort it and try again once
+            last_activity_ = now;
+            send_file(binary_transfer::File::ABORT);
+            skip_success_ = 1;
+            send_open();
+        } else {
+            printf("Error: binary transfer, the printer is busy\n");
+            finish(State::FAILED);
+        }
+    } else if (starts("PFT:fail") || starts("PFT:ioerror") || starts("PFT:invalid")) {
+        printf("Error: binary transfer, %.*s\n", static_cast<int>(line.size()), line.data());
+        finish(final_ == State::CANCELLED ? State::CANCELLED : State::FAILED);
+    } else if (step_ == Step::SWITCH && line.find("Binary Protocol") != std::string_view::npos) {
+        step_ = Step::SYNC;
+        send_sync();
+    }
+}
+
+int BinaryTransfer::poll(ISerial& serial, clock_t::time_point now) {
+    if (not active()) {
+        return 0;
+    }
+
+    if (abort_requested_.exchange(false)) {
+        abort_deadline_ = now + config_.timeout;
+    } else if (abort_deadline_ && now > *abort_deadline_) {
+        printf("Error: binary transfer, the printer did not leave binary mode in time\n");
+        end(State::CANCELLED);
+        return 0;
+    }
+    if (now - last_activity_ > config_.timeout) {
+        last_activity_ = now;
+        if (++retries_ > config_.max_retries) {
+            printf("Error: binary transfer, no response from the printer\n");
+            if (step_ == Step::LEAVE) {
+                end(final_);
+            } else {
+                finish(State::FAILED);
+            }
+        } else if (step_ == Step::SWITCH) {
+            // packets would end up in whatever M28 B1 did instead, if it opened a file M29 closes it
+            printf("Error: binary transfer, the printer did not switch to binary mode\n");
+            end(final_ == State::CANCELLED ? State::CANCELLED : State::FAILED);
+            return serial.write("M29\n", 4);
+        } else if (step_ == Step::SYNC) {
+            if (raw_.empty()) {
+                send_sync();
+            }
+        } else if (not unacked_.empty() && next_write_ > 0) {
+            rewind(unacked_.front().sync);
+        }
+    }
+    if (step_ == Step::WRITE) {
+        fill_window();
+    }
+
+    int total = 0;
+    if (not raw_.empty()) {
+        const int ret = serial.write(raw_.data(), static_cast<int>(raw_.size()));
+        if (ret < 0) {
+            return ret;
+        }
+        raw_.erase(0, ret);
+        total += ret;
+    }
+    while (raw_.empty() && next_write_ < unacked_.size()) {
+        std::array<std::string_view, max_segments> segments;
+        std::size_t count = 0;
+        for (auto i = next_write_; i < unacked_.size() && count < segments.size(); ++i) {
+            segments[count++] = std::string_view(unacked_[i].data).substr(i == next_write_ ? written_ : 0);
+        }
+        const int ret = serial.write_gather(segments.data(), static_cast<int>(count));
+        if (ret < 0) {
+            return ret;
+        }
+        total += ret;
+
+        std::size_t left = ret;
+        while (left > 0) {
+            const std::size_t rest = unacked_[next_write_].data.size() - written_;
+            if (left < rest) {
+                written_ += left;
+                break;
+            }
+            left -= rest;
+            written_ = 0;
+            ++next_write_;
+            if (pending_rewind_) {
+                // what followed the packet is discarded, the firmware drops it too
+                const auto sync = *pending_rewind_;
+                pending_rewind_.reset();
+                rewind(sync);
+                break;
+            }
+        }
+        if (ret == 0 || written_ > 0) {
+            break;
+        }
+    }
+    if (total > 0) {
+        wire_bytes_ += total;
+        last_activity_ = now;
+    }
+    return total;
+}
+
+void BinaryTransfer::finish(State state) {
+    if (not synced_) {
+        end(state);
+        return;
+    }
+    // packets not written yet are dropped
+    unacked_.resize(next_write_ + (written_ > 0));
+    send_packet(binary_transfer::Protocol::CONTROL, static_cast<std::uint8_t>(binary_transfer::Control::CLOSE));
+    step_ = Step::LEAVE;
+    final_ = state;
+}
+
+void BinaryTransfer::end(State state) {
+    file_.reset();
+    encoder_.reset();
+    unacked_.clear();
+    next_write_ = written_ = 0;
+    pending_rewind_.reset();
+    abort_deadline_.reset();
+    raw_.clear();
+    packed_.clear();
+    synced_ = false;
+    end_time_ = clock_t::now().time_since_epoch().count();
+    set_state(state);
+}
+
+void BinaryTransfer::reset() {
+    // a transfer started while disconnected is still taken over by the next active()
+    if (const auto state = this->state(); state == State::CONNECTING || state == State::UPLOADING) {
+        end(State::CANCELLED);
+    } else {
+        end(state);
+    }
+}
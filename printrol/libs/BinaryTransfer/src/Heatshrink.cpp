@@ -0,0 +1,130 @@
+#include "BinaryTransfer/Heatshrink.h"
+
+#include <algorithm>
+
+
+/// candidates looked at per position, bounds the time spent on highly repetitive input
+static constexpr int max_chain = 32;
+
+
+HeatshrinkEncoder::HeatshrinkEncoder(unsigned window_bits, unsigned lookahead_bits)
+    : window_bits_(window_bits),
+      lookahead_bits_(lookahead_bits),
+      window_(std::size_t{ 1 } << window_bits),
+      max_length_(std::size_t{ 1 } << lookahead_bits),
+      // a back reference must be shorter than the literals it replaces, heatshrink's break even point
+      min_length_(std::max<std::size_t>((1 + window_bits + lookahead_bits) / 8 + 1, 2)),
+      head_(1 << 16, 0),
+      prev_(2 * window_, 0) {
+}
+
+std::uint32_t HeatshrinkEncoder::hash(std::size_t pos) const {
+    return static_cast<std::uint8_t>(buf_[pos]) << 8 | static_cast<std::uint8_t>(buf_[pos + 1]);
+}
+
+void HeatshrinkEncoder::insert(std::size_t pos) {
+    if (pos + 1 >= buf_.size()) {
+        return;
+    }
+    const auto abs = base_ + pos;
+    auto& head = head_[hash(pos)];
+    prev_[abs % prev_.size()] = head;
+    head = abs + 1;
+}
+
+void HeatshrinkEncoder::put_bits(std::uint32_t value, unsigned count, std::string& out) {
+    bits_ = bits_ << count | value;
+    bit_count_ += count;
+    while (bit_count_ >= 8) {
+        bit_count_ -= 8;
+        out += static_cast<char>(bits_ >> bit_count_);
+    }
+    bits_ &= (1u << bit_count_) - 1;
+}
+
+void HeatshrinkEncoder::compress(std::string& out, bool final) {
+    const std::size_t end = buf_.size();
+    while (pos_ < end) {
+        const std::size_t avail = end - pos_;
+        if (not final && avail < max_length_) {
+            break;
+        }
+
+        const auto abs = base_ + pos_;
+        const std::size_t limit = std::min(avail, max_length_);
+        std::size_t best_len = 0;
+        std::uint64_t best_dist = 0;
+        if (avail >= 2) {
+            auto cand = head_[hash(pos_)];
+            for (int i = 0; i < max_chain && cand != 0; ++i) {
+                const auto c = cand - 1;
+                if (c < base_ || abs - c > window_) {
+                    break;
+                }
+                const std::size_t cp = c - base_;
+                std::size_t len = 0;
+                while (len < limit && buf_[cp + len] == buf_[pos_ + len]) {
+                    ++len;
+                }
+                if (len > best_len) {
+                    best_len = len;
+                    best_dist = abs - c;
+                    if (len == limit) {
+                        break;
+                    }
+                }
+                const auto next = prev_[c % prev_.size()];
+                // the slot was reused by a newer position, the chain ends here
+                if (next >= cand) {
+                    break;
+                }
+                cand = next;
+            }
+        }
+
+        if (best_len >= min_length_) {
+            put_bits(0, 1, out);
+            put_bits(static_cast<std::uint32_t>(best_dist - 1), window_bits_, out);
+            put_bits(static_cast<std::uint32_t>(best_len - 1), lookahead_bits_, out);
+            for (std::size_t i = 0; i < best_len; ++i) {
+                insert(pos_ + i);
+            }
+            pos_ += best_len;
+        } else {
+            put_bits(0x100 | static_cast<std::uint8_t>(buf_[pos_]), 9, out);
+            insert(pos_);
+            ++pos_;
+        }
+    }
+
+    // only the window is needed behind the cursor
+    if (pos_ > window_) {
+        const std::size_t drop = pos_ - window_;
+        buf_.erase(0, drop);
+        base_ += drop;
+        pos_ -= drop;
+    }
+}
+
+void HeatshrinkEncoder::sink(std::string_view input, std::string& out) {
+    // compress in pieces, so buf_ stays small for large inputs
+    constexpr std::size_t piece = 64 * 1024;
+    while (not input.empty()) {
+        const auto part = input.substr(0, piece);
+        buf_.append(part);
+        input.remove_prefix(part.size());
+        compress(out, false);
+    }
+}
+
+void HeatshrinkEncoder::finish(std::string& out) {
+    compress(out, true);
+    if (bit_count_ > 0) {
+        put_bits(0, 8 - bit_count_, out);
+    }
+    buf_.clear();
+    base_ = 0;
+    pos_ = 0;
+    std::fill(head_.begin(), head_.end(), 0);
+    std::fill(prev_.begin(), prev_.end(), 0);
+}
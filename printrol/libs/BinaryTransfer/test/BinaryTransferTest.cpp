@@ -0,0 +1,461 @@
+#include <gtest/gtest.h>
+#include "BinaryTransfer/BinaryTransfer.h"
+#include "BinaryTransfer/Heatshrink.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+/// @brief Decompress a heatshrink stream like Marlin's heatshrink_decoder
+static std::string unshrink(std::string_view in, unsigned window_bits = 8, unsigned lookahead_bits = 4) {
+    std::size_t bit = 0;
+    const auto get = [&](unsigned count, std::uint32_t& value) {
+        if (bit + count > in.size() * 8) {
+            return false;
+        }
+        value = 0;
+        for (unsigned i = 0; i < count; ++i, ++bit) {
+            value = value << 1 | ((static_cast<std::uint8_t>(in[bit / 8]) >> (7 - bit % 8)) & 1);
+        }
+        return true;
+    };
+    std::string out;
+    std::uint32_t flag, value, length;
+    while (get(1, flag)) {
+        if (flag) {
+            if (not get(8, value)) {
+                break;
+            }
+            out += static_cast<char>(value);
+        } else {
+            // the padding of the last byte
+            if (not get(window_bits, value) || not get(lookahead_bits, length)) {
+                break;
+            }
+            const std::size_t from = out.size() - (value + 1);
+            for (std::size_t i = 0; i <= length; ++i) {
+                out += out[from + i];
+            }
+        }
+    }
+    return out;
+}
+
+/// @brief G-code the way slicers write it
+static std::string sample_gcode(std::size_t lines) {
+    std::string ret = "; generated\nG28\nM104 S210\n";
+    char buf[64];
+    for (std::size_t i = 0; i < lines; ++i) {
+        std::snprintf(buf, sizeof(buf), "G1 X%.3f Y%.3f E%.5f\n", 100 + (i * 37 % 400) / 10., 80 + (i * 13 % 300) / 10.,
+                      0.02 + (i % 11) / 1000.);
+        ret += buf;
+    }
+    return ret;
+}
+
+
+/// @brief Marlin's binary stream and file transfer, on the other side of the port
+class FakeMarlin : public ISerial {
+public:
+    void open(std::wstring, int) override {
+    }
+    void close() override {
+    }
+    int write(const void* buff, int size) override {
+        std::string_view data(static_cast<const char*>(buff), size);
+        return write_gather(&data, 1);
+    }
+    int write_gather(const std::string_view* buffs, int count) override {
+        int written = 0;
+        for (int i = 0; i < count; ++i) {
+            in.append(buffs[i]);
+            written += static_cast<int>(buffs[i].size());
+        }
+        process();
+        return written;
+    }
+    int read(void*, int) override {
+        return 0;
+    }
+    bool wait_readable(int) override {
+        return false;
+    }
+    int bytes_available() const override {
+        return 0;
+    }
+    int read_some(void*, int, int) override {
+        return 0;
+    }
+    native_handle_t native_handle() const override {
+        return -1;
+    }
+    void flush() override {
+    }
+    bool is_open() const override {
+        return true;
+    }
+    std::vector<std::wstring> list_ports() const override {
+        return {};
+    }
+    std::vector<SerialPortInfo> list_port_info() const override {
+        return {};
+    }
+
+    /// @brief Hand the responses to @p transfer
+    void respond(BinaryTransfer& transfer) {
+        auto lines = std::move(out);
+        out.clear();
+        for (const auto& line : lines) {
+            transfer.handle_line(line + "\n");
+        }
+    }
+
+    std::string in;
+    std::vector<std::string> out;
+    /// false for SD support without BINARY_FILE_TRANSFER
+    bool binary_transfer{ true };
+    bool binary{ false };
+    /// file written by M28 without binary mode, and what was stored in it
+    std::string sd_file, sd_stored;
+    std::uint8_t sync{ 5 };
+    bool retrying{ false };
+    bool compressed{ false };
+    std::string file_name, file;
+    std::vector<std::uint8_t> types;
+    /// corrupt the payload of the WRITE packet with this index
+    int corrupt_write{ -1 };
+    int writes{ 0 };
+
+private:
+    static std::uint16_t u16(std::string_view data, std::size_t pos) {
+        return static_cast<std::uint8_t>(data[pos]) | static_cast<std::uint8_t>(data[pos + 1]) << 8;
+    }
+
+    void process() {
+        for (;;) {
+            if (not binary) {
+                const auto end = in.find('\n');
+                if (end == std::string::npos) {
+                    return;
+                }
+                const auto line = in.substr(0, end);
+                if (line == "M28 B1" && binary_transfer) {
+                    binary = true;
+                    out.push_back("echo:Switching to Binary Protocol");
+                    out.push_back("ok");
+                } else if (line == "M28 B1") {
+                    // opens the file B1
+                    sd_file = "B1";
+                    out.push_back("ok");
+                } else if (line == "M29") {
+                    sd_file.clear();
+                } else if (not sd_file.empty()) {
+                    sd_stored += line + "\n";
+                }
+                in.erase(0, end + 1);
+                continue;
+            }
+            if (in.size() < 8) {
+                return;
+            }
+            ASSERT_EQ(binary_transfer::packet_token, u16(in, 0));
+            const std::string_view header = std::string_view(in).substr(2, 4);
+            ASSERT_EQ(binary_transfer::checksum(header), u16(in, 6));
+            const std::size_t size = u16(in, 4);
+            const std::size_t total = 8 + size + (size ? 2 : 0);
+            if (in.size() < total) {
+                return;
+            }
+            std::string payload = in.substr(8, size);
+            const bool valid = size == 0 || binary_transfer::checksum(std::string_view(in).substr(2, 6 + size)) ==
+                                                u16(in, 8 + size);
+            const auto packet_sync = static_cast<std::uint8_t>(in[2]);
+            const std::uint8_t protocol = static_cast<std::uint8_t>(in[3]) >> 4, type = in[3] & 0xF;
+            in.erase(0, total);
+            handle(packet_sync, protocol, type, payload, valid);
+        }
+    }
+
+    void handle(std::uint8_t packet_sync, std::uint8_t protocol, std::uint8_t type, std::string payload, bool valid) {
+        if (protocol == 0 && type == 1) {
+            out.push_back("ss" + std::to_string(sync) + ",64,0.1.0");
+            return;
+        }
+        if (protocol == 1 && type == 3 && writes++ == corrupt_write) {
+            valid = false;
+        }
+        if (not valid) {
+            retrying = true;
+            out.push_back("rs" + std::to_string(sync));
+            return;
+        }
+        if (packet_sync != sync) {
+            // out of order after a resend request, dropped without an answer
+            EXPECT_TRUE(retrying);
+            return;
+        }
+        retrying = false;
+        out.push_back("ok" + std::to_string(sync++));
+        types.push_back(protocol << 4 | type);
+
+        if (protocol == 0 && type == 2) {
+            binary = false;
+        } else if (protocol == 1) {
+            switch (type) {
+                case 0:
+                    out.push_back("PFT:version:0.1.0:compression:heatshrink,8,4");
+                    break;
+                case 1:
+                    compressed = payload[1] != 0;
+                    file_name = payload.substr(2, payload.find('\0', 2) - 2);
+                    file.clear();
+                    out.push_back("PFT:success");
+                    break;
+                case 3:
+                    file += payload;
+                    break;
+                case 2:
+                case 4:
+                    out.push_back("PFT:success");
+                    break;
+            }
+        }
+    }
+};
+
+
+/// @brief Drive @p transfer against @p printer until it is no longer active
+static void run(BinaryTransfer& transfer, FakeMarlin& printer, int steps = 100000) {
+    for (int i = 0; i < steps && transfer.active(); ++i) {
+        transfer.poll(printer);
+        printer.respond(transfer);
+    }
+}
+
+/// @brief Write @p content to a temporary file of the running test
+/// @details ctest runs every test in its own process, in parallel with -j, so each test has its own file.
+static std::string temp_file(const std::string& content) {
+    const std::string name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    const auto path = (std::filesystem::temp_directory_path() / ("printrol_" + name + ".gcode")).string();
+    std::ofstream(path, std::ios::binary) << content;
+    return path;
+}
+
+
+TEST(BinaryTransferTest, TestPacket) {
+    std::string packet;
+    binary_transfer::build_packet(0, binary_transfer::Protocol::CONTROL, 1, {}, packet);
+    EXPECT_EQ(std::string("\xAD\xB5\x00\x01\x00\x00\x01\x03", 8), packet);
+
+    packet.clear();
+    binary_transfer::build_packet(7, binary_transfer::Protocol::FILE_TRANSFER, 3, "ab", packet);
+    ASSERT_EQ(12u, packet.size());
+    EXPECT_EQ(std::string("\x07\x13\x02\x00", 4), packet.substr(2, 4));
+    const auto payload_checksum = binary_transfer::checksum(std::string_view(packet).substr(2, 8));
+    EXPECT_EQ(payload_checksum & 0xFF, static_cast<std::uint8_t>(packet[10]));
+    EXPECT_EQ(payload_checksum >> 8, static_cast<std::uint8_t>(packet[11]));
+}
+
+TEST(BinaryTransferTest, TestHeatshrink) {
+    const auto gcode = sample_gcode(5000);
+    std::string repeated(10000, 'a');
+    std::string binary;
+    for (int i = 0; i < 5000; ++i) {
+        binary += static_cast<char>((i * 7919) % 251);
+    }
+
+    for (const auto& input : { gcode, repeated, binary, std::string("x") }) {
+        HeatshrinkEncoder encoder;
+        std::string packed;
+        // in odd pieces, across the kept back lookahead
+        for (std::size_t pos = 0; pos < input.size(); pos += 777) {
+            encoder.sink(std::string_view(input).substr(pos, 777), packed);
+        }
+        encoder.finish(packed);
+        ASSERT_EQ(input, unshrink(packed));
+    }
+
+    HeatshrinkEncoder encoder(10, 5);
+    std::string packed;
+    encoder.sink(gcode, packed);
+    encoder.finish(packed);
+    EXPECT_EQ(gcode, unshrink(packed, 10, 5));
+
+    HeatshrinkEncoder marlin;
+    packed.clear();
+    marlin.sink(gcode, packed);
+    marlin.finish(packed);
+    EXPECT_LT(packed.size() * 10, gcode.size() * 7);
+}
+
+TEST(BinaryTransferTest, TestUpload) {
+    const auto content = sample_gcode(3000);
+    const auto path = temp_file(content);
+
+    for (const bool compress : { false, true }) {
+        BinaryTransferConfig config;
+        config.compress = compress;
+        BinaryTransfer transfer(config);
+        FakeMarlin printer;
+        EXPECT_FALSE(transfer.active());
+        ASSERT_TRUE(transfer.start(path, "job.gco"));
+        EXPECT_FALSE(transfer.start(path, "other.gco"));
+
+        run(transfer, printer);
+        EXPECT_EQ(BinaryTransfer::State::FINISHED, transfer.state());
+        EXPECT_FALSE(printer.binary);
+        EXPECT_EQ("job.gco", printer.file_name);
+        EXPECT_EQ(compress, printer.compressed);
+        EXPECT_EQ(content, compress ? unshrink(printer.file) : printer.file);
+
+        const auto progress = transfer.progress();
+        EXPECT_EQ(content.size(), progress.position);
+        EXPECT_EQ(content.size(), progress.size);
+        EXPECT_EQ(compress, progress.compressed);
+        EXPECT_EQ(0u, progress.resends);
+        if (compress) {
+            EXPECT_LT(progress.wire_bytes, content.size());
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryTransferTest, TestWindowAndResend) {
+    const auto content = sample_gcode(3000);
+    const auto path = temp_file(content);
+
+    BinaryTransferConfig config;
+    config.window = 8;
+    config.compress = false;
+    BinaryTransfer transfer(config);
+    FakeMarlin printer;
+    printer.corrupt_write = 10;
+    ASSERT_TRUE(transfer.start(path, "job.gco"));
+
+    // the writes go out before their oks return
+    for (int i = 0; i < 20 && transfer.state() != BinaryTransfer::State::UPLOADING; ++i) {
+        transfer.poll(printer);
+        printer.respond(transfer);
+    }
+    const auto before = printer.writes;
+    transfer.poll(printer);
+    EXPECT_EQ(8, printer.writes - before);
+
+    run(transfer, printer);
+    EXPECT_EQ(BinaryTransfer::State::FINISHED, transfer.state());
+    EXPECT_EQ(content, printer.file);
+    EXPECT_EQ(1u, transfer.progress().resends);
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryTransferTest, TestCancel) {
+    const auto path = temp_file(sample_gcode(3000));
+    BinaryTransfer transfer;
+    FakeMarlin printer;
+    ASSERT_TRUE(transfer.start(path, "job.gco"));
+    for (int i = 0; i < 20 && printer.writes < 5; ++i) {
+        transfer.poll(printer);
+        printer.respond(transfer);
+    }
+    transfer.cancel();
+    run(transfer, printer);
+    EXPECT_EQ(BinaryTransfer::State::CANCELLED, transfer.state());
+    EXPECT_FALSE(printer.binary);
+    // the file is aborted, then binary mode left
+    ASSERT_GE(printer.types.size(), 2u);
+    EXPECT_EQ(0x14, printer.types[printer.types.size() - 2]);
+    EXPECT_EQ(0x02, printer.types.back());
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryTransferTest, TestCancelWhileSwitching) {
+    const auto path = temp_file(sample_gcode(30));
+    BinaryTransfer transfer;
+    FakeMarlin printer;
+
+    // nothing sent yet
+    ASSERT_TRUE(transfer.start(path, "job.gco"));
+    transfer.cancel();
+    EXPECT_EQ(0, transfer.poll(printer));
+    EXPECT_EQ(BinaryTransfer::State::CANCELLED, transfer.state());
+
+    // the printer switched, the transfer syncs to leave binary mode again
+    ASSERT_TRUE(transfer.start(path, "job.gco"));
+    transfer.poll(printer);
+    EXPECT_TRUE(printer.binary);
+    transfer.cancel();
+    run(transfer, printer);
+    EXPECT_EQ(BinaryTransfer::State::CANCELLED, transfer.state());
+    EXPECT_FALSE(printer.binary);
+    ASSERT_EQ(1u, printer.types.size());
+    EXPECT_EQ(0x02, printer.types[0]);
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryTransferTest, TestAbort) {
+    const auto path = temp_file(sample_gcode(3000));
+    BinaryTransfer transfer;
+    FakeMarlin printer;
+    ASSERT_TRUE(transfer.start(path, "job.gco"));
+    for (int i = 0; i < 20 && printer.writes < 5; ++i) {
+        transfer.poll(printer);
+        printer.respond(transfer);
+    }
+    EXPECT_TRUE(transfer.between_packets());
+
+    // the printer does not answer the abort, the transfer ends after one timeout instead of all retries
+    transfer.abort();
+    auto now = BinaryTransfer::clock_t::now();
+    transfer.poll(printer, now);
+    EXPECT_EQ(BinaryTransfer::State::UPLOADING, transfer.state());
+    transfer.poll(printer, now += BinaryTransferConfig().timeout / 2);
+    EXPECT_EQ(BinaryTransfer::State::UPLOADING, transfer.state());
+    transfer.poll(printer, now += BinaryTransferConfig().timeout);
+    EXPECT_EQ(BinaryTransfer::State::CANCELLED, transfer.state());
+    EXPECT_FALSE(transfer.active());
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryTransferTest, TestNoBinaryMode) {
+    const auto path = temp_file("G28\n");
+    BinaryTransfer transfer;
+    FakeMarlin printer;
+    printer.binary_transfer = false;
+    ASSERT_TRUE(transfer.start(path, "job.gco"));
+
+    // the ok of M28 B1 alone is no switch, nothing is sent until the timeout closes the file again
+    auto now = BinaryTransfer::clock_t::now();
+    for (int i = 0; i < 5; ++i) {
+        transfer.poll(printer, now);
+        printer.respond(transfer);
+    }
+    EXPECT_EQ("B1", printer.sd_file);
+    EXPECT_EQ(BinaryTransfer::State::CONNECTING, transfer.state());
+    transfer.poll(printer, now + BinaryTransferConfig().timeout * 2);
+    EXPECT_EQ(BinaryTransfer::State::FAILED, transfer.state());
+    EXPECT_TRUE(printer.sd_file.empty());
+    EXPECT_EQ("", printer.sd_stored);
+    EXPECT_TRUE(printer.types.empty());
+    std::filesystem::remove(path);
+}
+
+TEST(BinaryTransferTest, TestTimeout) {
+    const auto path = temp_file("G28\n");
+    BinaryTransferConfig config;
+    config.max_retries = 2;
+    BinaryTransfer transfer(config);
+    FakeMarlin printer;
+    ASSERT_TRUE(transfer.start(path, "job.gco"));
+
+    // a printer without binary transfer never answers
+    auto now = BinaryTransfer::clock_t::now();
+    for (int i = 0; i < 5 && transfer.active(); ++i) {
+        transfer.poll(printer, now += config.timeout * 2);
+        printer.out.clear();
+    }
+    EXPECT_EQ(BinaryTransfer::State::FAILED, transfer.state());
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+/// @brief Remove the comment and the surrounding whitespace of a G-code line
+/// @return Empty if only a comment or whitespace was left
+std::string_view strip_gcode(std::string_view line);
+
+/// @brief The commands of a print job in order
+class GcodeSource {
+public:
+    virtual ~GcodeSource() = default;
+
+    /// @brief Next command without comment, surrounding whitespace and line ending, empty lines are skipped
+    /// @param command Valid until the next call
+    /// @return false at the end of the job
+    virtual bool next(std::string_view& command) = 0;
+
+    /// @brief Bytes of the job consumed so far
+    virtual std::size_t position() const = 0;
+    /// @brief Total bytes of the job
+    virtual std::size_t size() const = 0;
+};
+
+/// @brief A job held in memory
+class StringGcodeSource final : public GcodeSource {
+public:
+    explicit StringGcodeSource(std::string text) : text_(std::move(text)) {
+    }
+
+    /// @brief Read the whole file @p path
+    /// @return nullptr if the file cannot be read
+    static std::unique_ptr<StringGcodeSource> load(const std::string& path);
+
+    bool next(std::string_view& command) override;
+
+    std::size_t position() const override {
+        return pos_;
+    }
+    std::size_t size() const override {
+        return text_.size();
+    }
+
+private:
+    std::string text_;
+    std::size_t pos_{ 0 };
+};
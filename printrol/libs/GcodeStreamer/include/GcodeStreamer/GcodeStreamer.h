@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <TxQueue/TxQueue.h>
+#include "GcodeStreamer/GcodeSource.h"
+
+
+/// @brief XOR of all bytes, the checksum Marlin expects after the '*'
+std::uint8_t gcode_checksum(std::string_view data);
+
+struct GcodeStreamerConfig {
+    /// sent lines kept for Resend: requests, must exceed the lines that can be in flight
+    std::size_t resend_history{ 256 };
+};
+
+/// @brief Streams a print job to the printer as line numbered, checksummed commands
+/// @details Set as the TxSource of the comm thread's TxQueue, which sends the lines as the printer's oks make room.
+/// Lines go out as "N<number> <command>*<checksum>", starting with "N0 M110 N0" to reset the printer's line number.
+/// The framed lines are kept in a ring indexed by line number, so a "Resend: N" rewinds the stream without touching the
+/// job. Marlin flushes its RX buffer with the request and TxQueue::resend() takes the dropped lines out of the window.
+/// Lines that were still on the wire are rejected with the same request, which the rewind already serves until the
+/// line goes out again.
+///
+/// start(), pause(), resume(), cancel() and progress() may be called from any thread, everything else only from the
+/// comm thread.
+class GcodeStreamer final : public TxSource {
+public:
+    using Config = GcodeStreamerConfig;
+
+    enum class State : std::uint8_t {
+        IDLE,
+        RUNNING,
+        /// no new lines are sent, resends still are
+        PAUSED,
+        /// every line was acknowledged
+        FINISHED,
+        CANCELLED,
+        /// the printer asked for a line no longer in the resend history
+        FAILED,
+    };
+
+    struct Progress {
+        State state;
+        /// job lines sent, not counting resends
+        std::uint64_t lines_sent;
+        std::uint64_t resends;
+        /// bytes of the job consumed and total
+        std::size_t position, size;
+        /// the printer reported busy: since its last ok
+        bool busy;
+    };
+
+    explicit GcodeStreamer(const Config& config = Config());
+
+    /// @brief Start streaming @p job, replacing a running one. Thread safe.
+    void start(std::unique_ptr<GcodeSource> job);
+    /// @brief Thread safe
+    void pause();
+    /// @brief Thread safe
+    void resume();
+    /// @brief Stop sending the job, lines in flight still complete. Thread safe.
+    void cancel();
+
+    /// @brief Thread safe
+    Progress progress() const;
+    /// @brief Thread safe
+    State state() const {
+        return state_.load(std::memory_order_acquire);
+    }
+
+    /// @brief Look for "Resend:" and "busy:" in a line received from the printer
+    void handle_line(std::string_view line);
+
+    /// @brief Forget the job and all lines in flight, e.g. after reconnecting
+    void reset();
+
+    std::string_view peek() override;
+    void pop() override;
+    void acknowledged() override;
+    void discarded() override;
+
+private:
+    /// @brief Apply the requests of the other threads
+    void apply_requests();
+    /// @brief The printer asks for everything from line @p number on
+    void resend(long number);
+    /// @brief Frame the next line of the job into the history, false if there is none
+    bool frame_next();
+    void set_state(State state);
+    /// @brief FINISHED once the job is exhausted and every line acknowledged
+    void check_finished();
+
+    std::string& slot(long number) {
+        return history_[static_cast<std::size_t>(number) % history_.size()];
+    }
+
+    // shared with the other threads
+    mutable std::mutex mtx_;
+    std::unique_ptr<GcodeSource> new_job_;
+    std::atomic<bool> job_requested_{ false }, pause_requested_{ false }, cancel_requested_{ false };
+    std::atomic<State> state_{ State::IDLE };
+    std::atomic<std::uint64_t> lines_sent_{ 0 }, resends_{ 0 };
+    std::atomic<std::size_t> position_{ 0 }, size_{ 0 };
+    std::atomic<bool> busy_{ false };
+
+    // comm thread only
+    std::unique_ptr<GcodeSource> job_;
+    bool exhausted_{ false };
+    /// framed lines by line number, the last history_.size() of them
+    std::vector<std::string> history_;
+    /// line peek() returns
+    long send_{ 0 };
+    /// first line not framed yet
+    long next_{ 0 };
+    /// first line not sent yet
+    long sent_{ 0 };
+    /// lines taken by TxQueue and not acknowledged yet, of any job
+    std::size_t in_flight_{ 0 };
+    /// of in_flight_, the lines of the previous job
+    std::size_t stale_{ 0 };
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "GcodeStreamer/GcodeSource.h"
+
+
+/// @brief A job file mapped into memory and preprocessed ahead of the send cursor
+/// @details Opening only maps the file, nothing is read or copied. A background thread walks the mapping ahead of next()
+/// and strips every line into a view of the mapping, handed over in batches of batch_lines commands. The index covers
+/// at most batches_ahead batches in front of the cursor, so its memory does not grow with the job. next() only takes the
+/// next ready view.
+///
+/// The file must not be truncated while the job runs, the views point into the mapping.
+class MappedGcodeSource final : public GcodeSource {
+public:
+    static constexpr std::size_t batch_lines = 4096;
+    static constexpr std::size_t batches_ahead = 4;
+
+    /// @brief Map the file @p path and start preprocessing it
+    /// @return nullptr if the file cannot be opened or mapped
+    static std::unique_ptr<MappedGcodeSource> open(const std::string& path);
+
+    /// @brief Stops the preprocessing thread and unmaps the file
+    ~MappedGcodeSource() override;
+
+    MappedGcodeSource(const MappedGcodeSource&) = delete;
+    MappedGcodeSource& operator=(const MappedGcodeSource&) = delete;
+
+    /// @details Waits for the preprocessing thread only if next() caught up with it
+    bool next(std::string_view& command) override;
+
+    std::size_t position() const override {
+        return pos_;
+    }
+    std::size_t size() const override {
+        return text_.size();
+    }
+
+private:
+    /// @brief A stripped command in the mapping
+    struct Line {
+        std::string_view command;
+        /// offset behind its line ending
+        std::size_t end;
+    };
+    using Batch = std::vector<Line>;
+
+    MappedGcodeSource(const void* data, std::size_t size, void* mapping);
+
+    /// @brief Preprocessing thread
+    void run();
+
+    std::string_view text_;
+    /// the file mapping object on Windows, unused elsewhere
+    void* mapping_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    /// preprocessed batches in file order
+    std::deque<Batch> ready_;
+    /// consumed batches for the thread to refill
+    std::vector<Batch> spare_;
+    /// the thread reached the end of the file
+    bool done_{ false };
+    bool stop_{ false };
+    std::thread thread_;
+
+    // next() only
+    Batch current_;
+    std::size_t index_{ 0 };
+    std::size_t pos_{ 0 };
+};
@@ -0,0 +1,43 @@
+#include "GcodeStreamer/GcodeSource.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+
+std::string_view strip_gcode(std::string_view line) {
+    if (const auto comment = line.find(';'); comment != std::string_view::npos) {
+        line = line.substr(0, comment);
+    }
+    const auto begin = line.find_first_not_of(" \t\r\n");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    const auto end = line.find_last_not_of(" \t\r\n");
+    return line.substr(begin, end - begin + 1);
+}
+
+
+std::unique_ptr<StringGcodeSource> StringGcodeSource::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (not file) {
+        printf("Error: can not open %s\n", path.c_str());
+        return nullptr;
+    }
+    return std::make_unique<StringGcodeSource>(
+        std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>()));
+}
+
+bool StringGcodeSource::next(std::string_view& command) {
+    const std::string_view text(text_);
+    while (pos_ < text.size()) {
+        auto end = text.find('\n', pos_);
+        end = end == std::string_view::npos ? text.size() : end + 1;
+        command = strip_gcode(text.substr(pos_, end - pos_));
+        pos_ = end;
+        if (not command.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
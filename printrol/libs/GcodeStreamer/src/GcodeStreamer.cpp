@@ -0,0 +1,215 @@
+#include "GcodeStreamer/GcodeStreamer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+
+
+/// @brief Append the decimal @p value to @p out without allocating
+static void append_number(std::string& out, long value) {
+    char buf[24];
+    const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, end);
+}
+
+
+std::uint8_t gcode_checksum(std::string_view data) {
+    std::uint8_t ret = 0;
+    for (const char c : data) {
+        ret ^= static_cast<std::uint8_t>(c);
+    }
+    return ret;
+}
+
+
+GcodeStreamer::GcodeStreamer(const Config& config) : history_(std::max<std::size_t>(config.resend_history, 1)) {
+}
+
+void GcodeStreamer::start(std::unique_ptr<GcodeSource> job) {
+    std::lock_guard<std::mutex> l(mtx_);
+    new_job_ = std::move(job);
+    pause_requested_ = false;
+    cancel_requested_ = false;
+    job_requested_.store(true, std::memory_order_release);
+}
+
+void GcodeStreamer::pause() {
+    pause_requested_ = true;
+}
+
+void GcodeStreamer::resume() {
+    pause_requested_ = false;
+}
+
+void GcodeStreamer::cancel() {
+    cancel_requested_ = true;
+}
+
+GcodeStreamer::Progress GcodeStreamer::progress() const {
+    return { state(), lines_sent_, resends_, position_, size_, busy_ };
+}
+
+void GcodeStreamer::set_state(State state) {
+    state_.store(state, std::memory_order_release);
+}
+
+void GcodeStreamer::apply_requests() {
+    if (job_requested_.exchange(false, std::memory_order_acquire)) {
+        {
+            std::lock_guard<std::mutex> l(mtx_);
+            job_ = std::move(new_job_);
+        }
+        exhausted_ = false;
+        send_ = next_ = sent_ = 0;
+        // the previous job may still have lines on the way, their resend requests are not for this one
+        stale_ = in_flight_;
+        lines_sent_ = 0;
+        resends_ = 0;
+        position_ = 0;
+        size_ = job_ ? job_->size() : 0;
+        set_state(job_ ? State::RUNNING : State::IDLE);
+    }
+
+    const auto state = this->state();
+    if (cancel_requested_.exchange(false)) {
+        job_.reset();
+        send_ = next_;
+        if (state == State::RUNNING || state == State::PAUSED) {
+            set_state(State::CANCELLED);
+        }
+    } else if (state == State::RUNNING && pause_requested_) {
+        set_state(State::PAUSED);
+    } else if (state == State::PAUSED && not pause_requested_) {
+        set_state(State::RUNNING);
+    }
+}
+
+bool GcodeStreamer::frame_next() {
+    std::string_view command;
+    if (next_ == 0) {
+        command = "M110 N0";
+    } else {
+        if (exhausted_ || not job_->next(command)) {
+            exhausted_ = true;
+            return false;
+        }
+        position_.store(job_->position(), std::memory_order_relaxed);
+    }
+
+    auto& line = slot(next_);
+    line.clear();
+    line += 'N';
+    append_number(line, next_);
+    line += ' ';
+    line += command;
+    const auto checksum = gcode_checksum(line);
+    line += '*';
+    append_number(line, checksum);
+    line += '\n';
+    ++next_;
+    return true;
+}
+
+std::string_view GcodeStreamer::peek() {
+    apply_requests();
+
+    const auto state = this->state();
+    if (state != State::RUNNING && state != State::PAUSED) {
+        return {};
+    }
+    if (send_ < next_) {
+        return slot(send_);
+    }
+    if (state == State::PAUSED || not frame_next()) {
+        check_finished();
+        return {};
+    }
+    return slot(send_);
+}
+
+void GcodeStreamer::pop() {
+    if (send_ >= sent_) {
+        sent_ = send_ + 1;
+        // M110 is not part of the job
+        if (send_ > 0) {
+            lines_sent_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    ++send_;
+    ++in_flight_;
+}
+
+void GcodeStreamer::acknowledged() {
+    if (in_flight_ > 0) {
+        --in_flight_;
+    }
+    if (stale_ > 0) {
+        --stale_;
+    }
+    busy_ = false;
+    check_finished();
+}
+
+void GcodeStreamer::discarded() {
+    if (in_flight_ > 0) {
+        --in_flight_;
+    }
+    stale_ = std::min(stale_, in_flight_);
+}
+
+void GcodeStreamer::check_finished() {
+    if (state() == State::RUNNING && exhausted_ && send_ == next_ && in_flight_ == 0) {
+        job_.reset();
+        set_state(State::FINISHED);
+    }
+}
+
+void GcodeStreamer::handle_line(std::string_view line) {
+    if (const long number = resend_number(line); number >= 0) {
+        resend(number);
+    } else if (line.substr(0, 2) == "ok") {
+        busy_ = false;
+    } else if (line.find("busy:") != std::string_view::npos) {
+        busy_ = true;
+    }
+}
+
+void GcodeStreamer::resend(long number) {
+    const auto state = this->state();
+    if (state != State::RUNNING && state != State::PAUSED) {
+        return;
+    }
+    if (stale_ > 0) {
+        // for a line of the previous job
+        return;
+    }
+    if (number >= next_) {
+        // not sent by this job
+        return;
+    }
+    if (number == send_) {
+        // the rewind is still ahead, e.g. a line that was on the wire during the flush was rejected
+        return;
+    }
+    if (number < 0 || static_cast<std::size_t>(next_ - number) > history_.size()) {
+        printf("Error: line %ld to resend is no longer in the history\n", number);
+        job_.reset();
+        set_state(State::FAILED);
+        return;
+    }
+
+    send_ = number;
+    resends_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void GcodeStreamer::reset() {
+    // a job started while disconnected is still applied by the next peek()
+    if (const auto state = this->state(); state == State::RUNNING || state == State::PAUSED) {
+        set_state(State::CANCELLED);
+    }
+    job_.reset();
+    exhausted_ = false;
+    send_ = next_ = sent_ = 0;
+    in_flight_ = stale_ = 0;
+    busy_ = false;
+}
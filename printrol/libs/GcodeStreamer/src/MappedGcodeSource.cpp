@@ -0,0 +1,163 @@
+#include "GcodeStreamer/MappedGcodeSource.h"
+
+#include <cstdio>
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+std::unique_ptr<MappedGcodeSource> MappedGcodeSource::open(const std::string& path) {
+#if defined(WIN32)
+    const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        printf("Error: can not open %s\n", path.c_str());
+        return nullptr;
+    }
+    LARGE_INTEGER size{};
+    GetFileSizeEx(file, &size);
+    if (size.QuadPart == 0) {
+        // an empty file can not be mapped
+        CloseHandle(file);
+        return std::unique_ptr<MappedGcodeSource>(new MappedGcodeSource(nullptr, 0, nullptr));
+    }
+    const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // the mapping keeps the file open
+    CloseHandle(file);
+    const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr) {
+        printf("Error: can not map %s\n", path.c_str());
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        return nullptr;
+    }
+    return std::unique_ptr<MappedGcodeSource>(
+        new MappedGcodeSource(data, static_cast<std::size_t>(size.QuadPart), mapping));
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("Error: can not open %s\n", path.c_str());
+        return nullptr;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        printf("Error: can not open %s\n", path.c_str());
+        return nullptr;
+    }
+    const auto size = static_cast<std::size_t>(st.st_size);
+    if (size == 0) {
+        // an empty file can not be mapped
+        close(fd);
+        return std::unique_ptr<MappedGcodeSource>(new MappedGcodeSource(nullptr, 0, nullptr));
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file open
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Error: can not map %s\n", path.c_str());
+        return nullptr;
+    }
+    // the job is read once front to back, let the kernel read ahead and drop the pages behind
+    madvise(data, size, MADV_SEQUENTIAL);
+    return std::unique_ptr<MappedGcodeSource>(new MappedGcodeSource(data, size, nullptr));
+#endif
+}
+
+MappedGcodeSource::MappedGcodeSource(const void* data, std::size_t size, void* mapping)
+    : text_(static_cast<const char*>(data), size), mapping_(mapping) {
+    thread_ = std::thread([this] { run(); });
+}
+
+MappedGcodeSource::~MappedGcodeSource() {
+    {
+        std::lock_guard<std::mutex> l(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+
+    if (text_.empty()) {
+        return;
+    }
+#if defined(WIN32)
+    UnmapViewOfFile(text_.data());
+    CloseHandle(mapping_);
+#else
+    munmap(const_cast<char*>(text_.data()), text_.size());
+#endif
+}
+
+void MappedGcodeSource::run() {
+    std::size_t pos = 0;
+    while (pos < text_.size()) {
+        Batch batch;
+        {
+            std::unique_lock<std::mutex> l(mtx_);
+            cv_.wait(l, [this] { return stop_ || ready_.size() < batches_ahead; });
+            if (stop_) {
+                return;
+            }
+            if (not spare_.empty()) {
+                batch = std::move(spare_.back());
+                spare_.pop_back();
+            }
+        }
+
+        batch.clear();
+        batch.reserve(batch_lines);
+        while (pos < text_.size() && batch.size() < batch_lines) {
+            auto end = text_.find('\n', pos);
+            end = end == std::string_view::npos ? text_.size() : end + 1;
+            const auto command = strip_gcode(text_.substr(pos, end - pos));
+            pos = end;
+            if (not command.empty()) {
+                batch.push_back({ command, end });
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> l(mtx_);
+            // a stretch of only comments leaves nothing to hand over
+            if (not batch.empty()) {
+                ready_.push_back(std::move(batch));
+            }
+        }
+        cv_.notify_all();
+    }
+
+    std::lock_guard<std::mutex> l(mtx_);
+    done_ = true;
+    cv_.notify_all();
+}
+
+bool MappedGcodeSource::next(std::string_view& command) {
+    if (index_ >= current_.size()) {
+        std::unique_lock<std::mutex> l(mtx_);
+        cv_.wait(l, [this] { return not ready_.empty() || done_; });
+        if (ready_.empty()) {
+            // only comments and whitespace after the last command
+            pos_ = text_.size();
+            return false;
+        }
+        spare_.push_back(std::move(current_));
+        current_ = std::move(ready_.front());
+        ready_.pop_front();
+        index_ = 0;
+        l.unlock();
+        // the thread may be waiting for room
+        cv_.notify_all();
+    }
+
+    const auto& line = current_[index_++];
+    command = line.command;
+    pos_ = line.end;
+    return true;
+}
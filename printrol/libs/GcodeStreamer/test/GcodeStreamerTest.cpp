@@ -0,0 +1,318 @@
+#include <gtest/gtest.h>
+#include "GcodeStreamer/GcodeStreamer.h"
+#include "GcodeStreamer/MappedGcodeSource.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+/// @brief Frame @p command like the streamer does
+static std::string framed(long number, const std::string& command) {
+    const std::string line = "N" + std::to_string(number) + " " + command;
+    return line + "*" + std::to_string(gcode_checksum(line)) + "\n";
+}
+
+/// @brief Take up to @p count lines from @p streamer like TxQueue does
+static std::vector<std::string> take(GcodeStreamer& streamer, std::size_t count) {
+    std::vector<std::string> ret;
+    for (; ret.size() < count; streamer.pop()) {
+        const auto line = streamer.peek();
+        if (line.empty()) {
+            break;
+        }
+        ret.emplace_back(line);
+    }
+    return ret;
+}
+
+
+/// @brief Port keeping everything written
+class SinkSerial : public ISerial {
+public:
+    void open(std::wstring, int) override {
+    }
+    void close() override {
+    }
+    int write(const void* buff, int size) override {
+        data.append(static_cast<const char*>(buff), size);
+        return size;
+    }
+    int write_gather(const std::string_view* buffs, int count) override {
+        int ret = 0;
+        for (int i = 0; i < count; ++i) {
+            ret += write(buffs[i].data(), static_cast<int>(buffs[i].size()));
+        }
+        return ret;
+    }
+    int read(void*, int) override {
+        return 0;
+    }
+    bool wait_readable(int) override {
+        return false;
+    }
+    int bytes_available() const override {
+        return 0;
+    }
+    int read_some(void*, int, int) override {
+        return 0;
+    }
+    native_handle_t native_handle() const override {
+        return -1;
+    }
+    void flush() override {
+    }
+    bool is_open() const override {
+        return true;
+    }
+    std::vector<std::wstring> list_ports() const override {
+        return {};
+    }
+    std::vector<SerialPortInfo> list_port_info() const override {
+        return {};
+    }
+
+    std::string data;
+};
+
+
+TEST(GcodeStreamerTest, TestStripAndChecksum) {
+    EXPECT_EQ("G1 X10", strip_gcode("  G1 X10 ; move\r\n"));
+    EXPECT_EQ("", strip_gcode("; only a comment\n"));
+    EXPECT_EQ("", strip_gcode(" \t\r\n"));
+    // the line OctoPrint starts with
+    EXPECT_EQ(125, gcode_checksum("N0 M110 N0"));
+
+    StringGcodeSource source("G28\n; comment\n\nG1 X1 ; move\nM400");
+    std::string_view cmd;
+    EXPECT_TRUE(source.next(cmd));
+    EXPECT_EQ("G28", cmd);
+    EXPECT_TRUE(source.next(cmd));
+    EXPECT_EQ("G1 X1", cmd);
+    EXPECT_TRUE(source.next(cmd));
+    EXPECT_EQ("M400", cmd);
+    EXPECT_FALSE(source.next(cmd));
+    EXPECT_EQ(source.size(), source.position());
+}
+
+TEST(GcodeStreamerTest, TestMappedSource) {
+    EXPECT_EQ(nullptr, MappedGcodeSource::open("/nonexistent/job.gcode"));
+
+    const auto path = (std::filesystem::temp_directory_path() / "printrol_mapped_test.gcode").string();
+    std::string text;
+    { std::ofstream(path, std::ios::binary); }
+    {
+        auto empty = MappedGcodeSource::open(path);
+        ASSERT_NE(nullptr, empty);
+        std::string_view cmd;
+        EXPECT_FALSE(empty->next(cmd));
+        EXPECT_EQ(0u, empty->size());
+    }
+
+    // enough lines to cross batches and fill the window ahead, ending in comments without a newline
+    const std::size_t count = MappedGcodeSource::batch_lines * (MappedGcodeSource::batches_ahead + 2) + 7;
+    for (std::size_t i = 0; i < count; ++i) {
+        text += "G1 X" + std::to_string(i) + (i % 3 ? " ; move\r\n" : "\n\n; layer\n");
+    }
+    text += "; end";
+    std::ofstream(path, std::ios::binary) << text;
+
+    auto mapped = MappedGcodeSource::open(path);
+    ASSERT_NE(nullptr, mapped);
+    EXPECT_EQ(text.size(), mapped->size());
+    StringGcodeSource expected(text);
+    std::string_view cmd, expected_cmd;
+    std::size_t lines = 0;
+    while (expected.next(expected_cmd)) {
+        ASSERT_TRUE(mapped->next(cmd));
+        ASSERT_EQ(expected_cmd, cmd);
+        EXPECT_EQ(expected.position(), mapped->position());
+        ++lines;
+    }
+    EXPECT_EQ(count, lines);
+    EXPECT_FALSE(mapped->next(cmd));
+    EXPECT_EQ(mapped->size(), mapped->position());
+
+    // closing a job halfway stops the preprocessing
+    mapped = MappedGcodeSource::open(path);
+    ASSERT_TRUE(mapped->next(cmd));
+    EXPECT_EQ("G1 X0", cmd);
+    mapped.reset();
+    std::filesystem::remove(path);
+}
+
+TEST(GcodeStreamerTest, TestStreamsJob) {
+    GcodeStreamer streamer;
+    EXPECT_TRUE(streamer.peek().empty());
+    streamer.start(std::make_unique<StringGcodeSource>("G28 ; home\n\nG1 X10\n"));
+
+    // peeking does not consume
+    EXPECT_EQ("N0 M110 N0*125\n", streamer.peek());
+    EXPECT_EQ("N0 M110 N0*125\n", streamer.peek());
+    EXPECT_EQ(GcodeStreamer::State::RUNNING, streamer.state());
+
+    const auto lines = take(streamer, 10);
+    ASSERT_EQ(3u, lines.size());
+    EXPECT_EQ(framed(1, "G28"), lines[1]);
+    EXPECT_EQ(framed(2, "G1 X10"), lines[2]);
+
+    // done once everything is acknowledged
+    streamer.acknowledged();
+    streamer.acknowledged();
+    EXPECT_EQ(GcodeStreamer::State::RUNNING, streamer.state());
+    streamer.acknowledged();
+    EXPECT_EQ(GcodeStreamer::State::FINISHED, streamer.state());
+
+    const auto progress = streamer.progress();
+    EXPECT_EQ(2u, progress.lines_sent);
+    EXPECT_EQ(progress.size, progress.position);
+}
+
+TEST(GcodeStreamerTest, TestResend) {
+    GcodeStreamer streamer;
+    streamer.start(std::make_unique<StringGcodeSource>("G1 X1\nG1 X2\nG1 X3\nG1 X4\nG1 X5\n"));
+    ASSERT_EQ(5u, take(streamer, 5).size());
+
+    // line 2 was corrupted, 3 and 4 are rejected as out of order
+    streamer.handle_line("Error:checksum mismatch, Last Line: 1");
+    streamer.handle_line("Resend: 2");
+    streamer.acknowledged();
+    EXPECT_EQ(framed(2, "G1 X2"), streamer.peek());
+    for (int i = 0; i < 2; ++i) {
+        streamer.handle_line("Resend: 2");
+        streamer.acknowledged();
+    }
+
+    auto lines = take(streamer, 10);
+    ASSERT_EQ(4u, lines.size());
+    EXPECT_EQ(framed(2, "G1 X2"), lines[0]);
+    EXPECT_EQ(framed(5, "G1 X5"), lines[3]);
+    EXPECT_EQ(1u, streamer.progress().resends);
+    EXPECT_EQ(5u, streamer.progress().lines_sent);
+
+    // a new request after the old lines are answered is served again
+    streamer.acknowledged();
+    streamer.acknowledged();
+    streamer.handle_line("Resend: 4");
+    lines = take(streamer, 10);
+    ASSERT_EQ(2u, lines.size());
+    EXPECT_EQ(framed(4, "G1 X4"), lines[0]);
+    EXPECT_EQ(2u, streamer.progress().resends);
+}
+
+TEST(GcodeStreamerTest, TestHistoryExceeded) {
+    GcodeStreamerConfig config;
+    config.resend_history = 4;
+    GcodeStreamer streamer(config);
+    streamer.start(std::make_unique<StringGcodeSource>("G1 X1\nG1 X2\nG1 X3\nG1 X4\nG1 X5\nG1 X6\n"));
+    ASSERT_EQ(7u, take(streamer, 7).size());
+    streamer.handle_line("Resend: 1");
+    EXPECT_EQ(GcodeStreamer::State::FAILED, streamer.state());
+    EXPECT_TRUE(streamer.peek().empty());
+}
+
+TEST(GcodeStreamerTest, TestPauseResumeCancel) {
+    GcodeStreamer streamer;
+    streamer.start(std::make_unique<StringGcodeSource>("G1 X1\nG1 X2\nG1 X3\n"));
+    ASSERT_EQ(2u, take(streamer, 2).size());
+
+    streamer.pause();
+    EXPECT_TRUE(streamer.peek().empty());
+    EXPECT_EQ(GcodeStreamer::State::PAUSED, streamer.state());
+    // what was sent before the pause is still resent
+    streamer.handle_line("Resend: 1");
+    EXPECT_EQ(framed(1, "G1 X1"), streamer.peek());
+    streamer.pop();
+    EXPECT_TRUE(streamer.peek().empty());
+
+    streamer.resume();
+    EXPECT_EQ(framed(2, "G1 X2"), streamer.peek());
+    EXPECT_EQ(GcodeStreamer::State::RUNNING, streamer.state());
+
+    streamer.cancel();
+    EXPECT_TRUE(streamer.peek().empty());
+    EXPECT_EQ(GcodeStreamer::State::CANCELLED, streamer.state());
+    streamer.handle_line("Resend: 1");
+    EXPECT_TRUE(streamer.peek().empty());
+}
+
+TEST(GcodeStreamerTest, TestThroughTxQueue) {
+    SinkSerial serial;
+
+    TxQueueConfig config;
+    config.windowed = false;
+    TxQueue txq(config);
+    GcodeStreamer streamer;
+    txq.set_source(&streamer);
+    streamer.start(std::make_unique<StringGcodeSource>("G28\nG1 X1\n"));
+
+    // one line per ok
+    txq.send(serial);
+    EXPECT_EQ("N0 M110 N0*125\n", serial.data);
+    txq.send(serial);
+    EXPECT_EQ(1u, txq.in_flight());
+    for (int i = 0; i < 3; ++i) {
+        txq.acknowledge();
+        txq.send(serial);
+    }
+    EXPECT_EQ("N0 M110 N0*125\n" + framed(1, "G28") + framed(2, "G1 X1"), serial.data);
+    EXPECT_EQ(GcodeStreamer::State::FINISHED, streamer.state());
+}
+
+TEST(GcodeStreamerTest, TestResendRecoversWindow) {
+    SinkSerial serial;
+    TxQueue txq;
+    GcodeStreamer streamer;
+    txq.set_source(&streamer);
+    std::string job;
+    for (int i = 1; i <= 20; ++i) {
+        job += "G1 X" + std::to_string(i) + "\n";
+    }
+    streamer.start(std::make_unique<StringGcodeSource>(job));
+
+    // handled like the comm thread does
+    auto receive = [&](std::string_view line) {
+        if (line.substr(0, 2) == "ok") {
+            txq.acknowledge_ok(line);
+        } else if (const long number = resend_number(line); number >= 0) {
+            txq.resend(number);
+        }
+        streamer.handle_line(line);
+        txq.send(serial);
+    };
+
+    txq.send(serial);
+    ASSERT_LT(4u, txq.in_flight());
+    auto lines_written = [&] {
+        return static_cast<std::size_t>(std::count(serial.data.begin(), serial.data.end(), '\n'));
+    };
+
+    // line 2 was corrupted, Marlin flushed the lines behind it and answers only 0, 1 and the request
+    receive("ok");
+    receive("ok");
+    serial.data.clear();
+    receive("Error:checksum mismatch, Last Line: 1");
+    receive("Resend: 2");
+    EXPECT_EQ(0u, serial.data.find(framed(2, "G1 X2")));
+    receive("ok");
+    // only the lines sent again are owed an ok, and they fill the window again
+    EXPECT_EQ(lines_written(), txq.in_flight());
+    EXPECT_LT(4u, txq.in_flight());
+
+    // the next request is served as well
+    receive("ok");
+    serial.data.clear();
+    receive("Resend: 3");
+    receive("ok");
+    EXPECT_EQ(0u, serial.data.find(framed(3, "G1 X3")));
+    EXPECT_EQ(lines_written(), txq.in_flight());
+    EXPECT_EQ(2u, streamer.progress().resends);
+
+    while (txq.in_flight() > 0) {
+        receive("ok");
+    }
+    EXPECT_EQ(GcodeStreamer::State::FINISHED, streamer.state());
+    EXPECT_EQ(20u, streamer.progress().lines_sent);
+}
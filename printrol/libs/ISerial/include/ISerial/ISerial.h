@@ -1,10 +1,27 @@
 #pragma once
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <string>
+#include <string_view>
 
 
+/// @brief A serial port found by ISerial::list_port_info()
+struct SerialPortInfo {
+    /// name to pass to ISerial::open()
+    std::wstring port;
+    std::wstring description;
+    /// USB vendor and product ID, 0 if unknown
+    std::uint16_t vid{ 0 }, pid{ 0 };
+    /// USB serial number, identifies the same printer across reboots and re-plugging
+    std::wstring serial_number;
+};
+
 class ISerial {
 public:
+    /// @brief OS handle of the port: file descriptor on Linux, HANDLE on Windows
+    using native_handle_t = std::intptr_t;
+
     virtual ~ISerial() = default;
 
     /// @brief Open a serial port with baud
@@ -13,9 +30,34 @@ public:
     virtual void open(std::wstring port, int baud) = 0;
     virtual void close() = 0;
     virtual int write(const void* buff, int size) = 0;
+    /// @brief Write @p count buffers in order with as few system calls as possible
+    /// @return Number of bytes written, may be less than the total. Negative on error.
+    virtual int write_gather(const std::string_view* buffs, int count) = 0;
     virtual int read(void* dest, int size) = 0;
+    /// @brief Block until data can be read, the port is closed or the timeout expires
+    /// @param timeout_ms Maximum time to wait, 0 only checks
+    /// @return true if read() will return data without waiting
+    virtual bool wait_readable(int timeout_ms) = 0;
+    /// @brief Make the wait_readable() in progress, or the next one, return at once. Thread safe.
+    /// @details Lets another thread hand the reading thread something to write without waiting out its timeout.
+    /// Backends that cannot be woken ignore it, the wait then ends with its timeout.
+    virtual void wake() {
+    }
+    /// @brief Number of received bytes that can be read without waiting
+    virtual int bytes_available() const = 0;
+    /// @brief Wait up to @p timeout_ms for data, then read all that is available up to @p capacity
+    /// @return Number of bytes read, 0 on timeout, negative on error
+    virtual int read_some(void* dest, int capacity, int timeout_ms) = 0;
+    /// @brief Handle for use with OS readiness APIs, -1 when closed
+    virtual native_handle_t native_handle() const = 0;
     virtual void flush() = 0;
     virtual bool is_open() const = 0;
 
     virtual std::vector<std::wstring> list_ports() const = 0;
+    virtual std::vector<SerialPortInfo> list_port_info() const = 0;
+
+    /// @brief Set a function to call when ports appear or disappear. It is called from a background thread.
+    /// @details Backends that cannot detect changes never call it.
+    virtual void set_ports_changed_callback(std::function<void()> /*callback*/) {
+    }
 };
@@ -1,11 +1,12 @@
 #pragma once
 #include <regex>
+#include <string_view>
 #include <vector>
 
 
 class LineFilter {
 public:
-    bool check(const std::string& line);
+    bool check(std::string_view line);
 
     void add_filter(const std::regex& filter);
 
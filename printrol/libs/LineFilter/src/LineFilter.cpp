@@ -1,9 +1,9 @@
 #include "LineFilter/LineFilter.h"
 
 
-bool LineFilter::check(const std::string& line) {
+bool LineFilter::check(std::string_view line) {
     for (const auto& rgx : filters_) {
-        if (std::regex_search(line, rgx)) {
+        if (std::regex_search(line.data(), line.data() + line.size(), rgx)) {
             return false;
         }
     }
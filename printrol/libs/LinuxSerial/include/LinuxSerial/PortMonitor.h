@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ISerial/ISerial.h>
+
+
+/// @brief Describe tty @p name, e.g. ttyACM0, from sysfs
+/// @return nullopt if it does not exist or is not a USB device
+std::optional<SerialPortInfo> scan_serial_port(const std::string& name, const std::string& sys_root = "/sys/class/tty",
+                                               const std::string& dev_root = "/dev");
+
+/// @brief All USB serial ports in sysfs, sorted by port
+std::vector<SerialPortInfo> scan_serial_ports(const std::string& sys_root = "/sys/class/tty",
+                                              const std::string& dev_root = "/dev");
+
+
+/// @brief Cached list of USB serial ports, kept up to date through inotify on the device directory
+/// @details The ports are scanned once by the monitor thread after construction, ports() is empty until then and the
+/// callback reports the result. Afterwards only ttys created, changed or removed in the device directory are rescanned,
+/// so neither the constructor nor ports() touch the file system.
+class PortMonitor {
+public:
+    explicit PortMonitor(std::string sys_root = "/sys/class/tty", std::string dev_root = "/dev");
+    ~PortMonitor();
+
+    PortMonitor(const PortMonitor&) = delete;
+    PortMonitor& operator=(const PortMonitor&) = delete;
+
+    std::vector<SerialPortInfo> ports() const;
+
+    /// @brief Called from the monitor thread after the list changed, including the first scan finding ports
+    void set_callback(std::function<void()> callback);
+
+private:
+    void run();
+    void notify();
+    /// @brief Rescan @p name, nullptr rescans everything
+    /// @return true if the list changed
+    bool rescan(const char* name);
+
+    const std::string sys_root_, dev_root_;
+
+    mutable std::mutex mtx_;
+    /// by tty name
+    std::map<std::string, SerialPortInfo> ports_;
+    std::function<void()> callback_;
+
+    int inotify_fd_{ -1 };
+    /// written to stop the thread for destruction
+    int wake_pipe_[2]{ -1, -1 };
+    std::thread thread_;
+};
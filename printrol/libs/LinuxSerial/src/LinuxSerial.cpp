@@ -1,13 +1,20 @@
 #include "LinuxSerial/LinuxSerial.h"
+#include "LinuxSerial/PortMonitor.h"
+#include "Termios2.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <errno.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <codecvt>
 #include <locale>
 
@@ -75,12 +82,24 @@ static constexpr int baud_to_enum(int baud) {
         case 4000000:
             return B4000000;
         default:
-            return baud;
+            // needs termios2
+            return -1;
     }
 }
 
 
+LinuxSerial::LinuxSerial() {
+    if (::pipe(wake_pipe_) == 0) {
+        for (int fd : wake_pipe_) {
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+}
+
 void LinuxSerial::open(std::wstring port, int baud) {
+    close();
+
     std::string port_str = std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t>().to_bytes(port);
 
     port_handle_ = ::open(port_str.c_str(), O_RDWR);
@@ -119,11 +138,39 @@ void LinuxSerial::open(std::wstring port, int baud) {
     tty.c_cc[VTIME] = 0;
     tty.c_cc[VMIN] = 0;
 
-    cfsetspeed(&tty, baud_to_enum(baud));
+    const int speed = baud_to_enum(baud);
+    if (speed >= 0) {
+        cfsetspeed(&tty, speed);
+    }
 
     if (tcsetattr(port_handle_, TCSANOW, &tty) != 0) {
         printf("Error %i from tcsetattr: %s\n", errno, strerror(errno));
     }
+
+    // rates without a Bxxx constant, e.g. 250000, only work through termios2
+    int actual = speed >= 0 ? get_baud(port_handle_) : set_custom_baud(port_handle_, baud);
+    if (actual < 0 && speed >= 0) {
+        // no termios2, cfsetspeed did the job
+        actual = baud;
+    }
+    // UARTs tolerate about 2 % between both ends
+    if (actual <= 0 || abs(actual - baud) > baud / 50) {
+        printf("Error: baud rate %i not supported, the driver set %i\n", baud, actual);
+        close();
+        return;
+    }
+    actual_baud_ = actual;
+
+    if (low_latency_ && not ::set_low_latency(port_handle_, true)) {
+        printf("Low latency mode not supported by %s\n", port_str.c_str());
+    }
+}
+
+void LinuxSerial::set_low_latency(bool enable) {
+    low_latency_ = enable;
+    if (is_open()) {
+        ::set_low_latency(port_handle_, enable);
+    }
 }
 
 
@@ -131,10 +178,80 @@ int LinuxSerial::write(const void* buff, int size) {
     return ::write(port_handle_, buff, size);
 }
 
+int LinuxSerial::write_gather(const std::string_view* buffs, int count) {
+    constexpr int max_iov = 64;
+    iovec iov[max_iov];
+    count = std::min(count, max_iov);
+    for (int i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<char*>(buffs[i].data());
+        iov[i].iov_len = buffs[i].size();
+    }
+    ssize_t ret;
+    do {
+        ret = ::writev(port_handle_, iov, count);
+    } while (ret < 0 && errno == EINTR);
+    return static_cast<int>(ret);
+}
+
 int LinuxSerial::read(void* dest, int size) {
     return ::read(port_handle_, dest, size);
 }
 
+bool LinuxSerial::wait_readable(int timeout_ms) {
+    if (not is_open()) {
+        return false;
+    }
+    pollfd fds[2] = { { port_handle_, POLLIN, 0 }, { wake_pipe_[0], POLLIN, 0 } };
+    int ret;
+    do {
+        ret = ::poll(fds, wake_pipe_[0] >= 0 ? 2 : 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+    if (ret > 0 && fds[1].revents) {
+        // one wake covers any number of wake() calls before it
+        char buf[64];
+        while (::read(wake_pipe_[0], buf, sizeof(buf)) > 0) {
+        }
+    }
+    // after a hangup the read returns at once and tells
+    return ret > 0 && (fds[0].revents & (POLLIN | POLLHUP | POLLERR));
+}
+
+void LinuxSerial::wake() {
+    const char c = 0;
+    // a full pipe already wakes the wait
+    while (::write(wake_pipe_[1], &c, 1) < 0 && errno == EINTR) {
+    }
+}
+
+int LinuxSerial::bytes_available() const {
+    int cnt = 0;
+    if (not is_open() || ::ioctl(port_handle_, FIONREAD, &cnt) < 0) {
+        return 0;
+    }
+    return cnt;
+}
+
+int LinuxSerial::read_some(void* dest, int capacity, int timeout_ms) {
+    if (not wait_readable(timeout_ms)) {
+        return is_open() ? 0 : -1;
+    }
+    int ret;
+    do {
+        ret = ::read(port_handle_, dest, capacity);
+    } while (ret < 0 && errno == EINTR);
+    if (ret == 0 || (ret < 0 && errno != EAGAIN)) {
+        // readable but nothing to read, or EIO: unplugged or the pty master closed
+        printf("Error: port disconnected\n");
+        close();
+        return -1;
+    }
+    return ret;
+}
+
+ISerial::native_handle_t LinuxSerial::native_handle() const {
+    return port_handle_;
+}
+
 void LinuxSerial::flush() {
     return;
 }
@@ -147,13 +264,38 @@ void LinuxSerial::close() {
     if (is_open()) {
         ::close(port_handle_);
         port_handle_ = -1;
+        actual_baud_ = 0;
     }
 }
 
 LinuxSerial::~LinuxSerial() {
     close();
+    for (int fd : wake_pipe_) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
 }
 
 std::vector<std::wstring> LinuxSerial::list_ports() const {
-    return { L"/dev/ttyACM0" };
+    std::vector<std::wstring> ret;
+    for (const auto& info : list_port_info()) {
+        ret.push_back(info.port);
+    }
+    return ret;
+}
+
+std::vector<SerialPortInfo> LinuxSerial::list_port_info() const {
+    return port_monitor().ports();
+}
+
+void LinuxSerial::set_ports_changed_callback(std::function<void()> callback) {
+    port_monitor().set_callback(std::move(callback));
+}
+
+PortMonitor& LinuxSerial::port_monitor() const {
+    if (not port_monitor_) {
+        port_monitor_ = std::make_unique<PortMonitor>();
+    }
+    return *port_monitor_;
 }
@@ -0,0 +1,206 @@
+#include "LinuxSerial/PortMonitor.h"
+
+#include <algorithm>
+#include <codecvt>
+#include <filesystem>
+#include <fstream>
+#include <locale>
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+
+namespace fs = std::filesystem;
+
+static std::wstring to_wide(const std::string& str) {
+    return std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t>().from_bytes(str);
+}
+
+/// @brief First line of a sysfs attribute, empty if it does not exist
+static std::string read_attribute(const fs::path& path) {
+    std::ifstream file(path);
+    std::string ret;
+    std::getline(file, ret);
+    return ret;
+}
+
+/// @brief Whether @p name may be a serial tty, ignores everything else appearing in /dev
+static bool is_tty_name(const char* name) {
+    return std::string_view(name).substr(0, 3) == "tty";
+}
+
+
+std::optional<SerialPortInfo> scan_serial_port(const std::string& name, const std::string& sys_root,
+                                               const std::string& dev_root) {
+    std::error_code ec;
+    // virtual terminals and ptys have no device
+    fs::path device = fs::canonical(fs::path(sys_root) / name / "device", ec);
+    if (ec) {
+        return std::nullopt;
+    }
+
+    // the tty belongs to a USB interface, the USB device holding the IDs is one of its parents
+    for (int depth = 0; depth < 4 && device.has_relative_path(); ++depth, device = device.parent_path()) {
+        const auto vid = read_attribute(device / "idVendor");
+        if (vid.empty()) {
+            continue;
+        }
+
+        SerialPortInfo info;
+        info.port = to_wide(dev_root + "/" + name);
+        info.vid = static_cast<std::uint16_t>(std::strtoul(vid.c_str(), nullptr, 16));
+        info.pid = static_cast<std::uint16_t>(std::strtoul(read_attribute(device / "idProduct").c_str(), nullptr, 16));
+        info.serial_number = to_wide(read_attribute(device / "serial"));
+
+        const auto manufacturer = read_attribute(device / "manufacturer");
+        const auto product = read_attribute(device / "product");
+        info.description = to_wide(manufacturer.empty() || product.empty() ? manufacturer + product
+                                                                           : manufacturer + " " + product);
+        return info;
+    }
+    return std::nullopt;
+}
+
+std::vector<SerialPortInfo> scan_serial_ports(const std::string& sys_root, const std::string& dev_root) {
+    std::vector<SerialPortInfo> ret;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(sys_root, ec)) {
+        if (auto info = scan_serial_port(entry.path().filename().string(), sys_root, dev_root)) {
+            ret.push_back(std::move(*info));
+        }
+    }
+    std::sort(ret.begin(), ret.end(), [](const auto& l, const auto& r) { return l.port < r.port; });
+    return ret;
+}
+
+
+PortMonitor::PortMonitor(std::string sys_root, std::string dev_root)
+  : sys_root_(std::move(sys_root)), dev_root_(std::move(dev_root)) {
+    // watch before the first scan, so nothing created in between is missed
+    inotify_fd_ = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotify_fd_ >= 0 &&
+        inotify_add_watch(inotify_fd_, dev_root_.c_str(), IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO) <
+            0) {
+        ::close(inotify_fd_);
+        inotify_fd_ = -1;
+    }
+
+    // the first scan reads sysfs for every tty, it must not block the caller, e.g. the GUI thread
+    if (::pipe(wake_pipe_) == 0) {
+        thread_ = std::thread(&PortMonitor::run, this);
+    } else {
+        rescan(nullptr);
+    }
+}
+
+PortMonitor::~PortMonitor() {
+    if (thread_.joinable()) {
+        const char c = 0;
+        while (::write(wake_pipe_[1], &c, 1) < 0 && errno == EINTR) {
+        }
+        thread_.join();
+    }
+    for (int fd : { inotify_fd_, wake_pipe_[0], wake_pipe_[1] }) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+std::vector<SerialPortInfo> PortMonitor::ports() const {
+    std::lock_guard<std::mutex> l(mtx_);
+    std::vector<SerialPortInfo> ret;
+    for (const auto& [name, info] : ports_) {
+        ret.push_back(info);
+    }
+    return ret;
+}
+
+void PortMonitor::set_callback(std::function<void()> callback) {
+    std::lock_guard<std::mutex> l(mtx_);
+    callback_ = std::move(callback);
+}
+
+bool PortMonitor::rescan(const char* name) {
+    if (name == nullptr) {
+        std::map<std::string, SerialPortInfo> ports;
+        for (auto& info : scan_serial_ports(sys_root_, dev_root_)) {
+            const auto port = fs::path(info.port).filename().string();
+            ports.emplace(port, std::move(info));
+        }
+        std::lock_guard<std::mutex> l(mtx_);
+        const bool changed = ports.size() != ports_.size() ||
+                             not std::equal(ports.begin(), ports.end(), ports_.begin(), [](const auto& a, const auto& b) {
+                                 return a.first == b.first && a.second.serial_number == b.second.serial_number;
+                             });
+        ports_ = std::move(ports);
+        return changed;
+    }
+
+    // the node may be gone already, then sysfs is gone too
+    auto info = fs::exists(fs::path(dev_root_) / name) ? scan_serial_port(name, sys_root_, dev_root_) : std::nullopt;
+    std::lock_guard<std::mutex> l(mtx_);
+    if (info) {
+        const auto it = ports_.find(name);
+        const bool changed = it == ports_.end() || it->second.serial_number != info->serial_number;
+        ports_[name] = std::move(*info);
+        return changed;
+    }
+    return ports_.erase(name) > 0;
+}
+
+void PortMonitor::notify() {
+    std::function<void()> callback;
+    {
+        std::lock_guard<std::mutex> l(mtx_);
+        callback = callback_;
+    }
+    if (callback) {
+        callback();
+    }
+}
+
+void PortMonitor::run() {
+    if (rescan(nullptr)) {
+        notify();
+    }
+    if (inotify_fd_ < 0) {
+        return;
+    }
+
+    alignas(inotify_event) char buf[4096];
+    for (;;) {
+        pollfd fds[2] = { { inotify_fd_, POLLIN, 0 }, { wake_pipe_[0], POLLIN, 0 } };
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+
+        const auto len = ::read(inotify_fd_, buf, sizeof(buf));
+        if (len <= 0) {
+            continue;
+        }
+
+        bool changed = false;
+        for (const char* p = buf; p < buf + len;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(p);
+            if (event->mask & IN_Q_OVERFLOW) {
+                changed |= rescan(nullptr);
+            } else if (event->len && is_tty_name(event->name)) {
+                changed |= rescan(event->name);
+            }
+            p += sizeof(inotify_event) + event->len;
+        }
+
+        if (changed) {
+            notify();
+        }
+    }
+}
@@ -0,0 +1,64 @@
+// termios2 lives in the kernel headers, which clash with glibc's <termios.h>, so it gets its own translation unit
+#include "Termios2.h"
+
+#if defined(__linux__)
+
+#include <asm/ioctls.h>
+#include <asm/termbits.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+
+
+int set_custom_baud(int fd, int baud) {
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) != 0) {
+        return -1;
+    }
+    tio.c_cflag &= ~CBAUD;
+    tio.c_cflag |= BOTHER;
+    tio.c_ispeed = baud;
+    tio.c_ospeed = baud;
+    // the input rate follows the output rate
+    tio.c_cflag &= ~(CBAUD << IBSHIFT);
+    if (ioctl(fd, TCSETS2, &tio) != 0) {
+        return -1;
+    }
+    return get_baud(fd);
+}
+
+int get_baud(int fd) {
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) != 0) {
+        return -1;
+    }
+    return static_cast<int>(tio.c_ospeed);
+}
+
+bool set_low_latency(int fd, bool enable) {
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) != 0) {
+        return false;
+    }
+    if (enable) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+    } else {
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+    }
+    return ioctl(fd, TIOCSSERIAL, &serial) == 0;
+}
+
+#else
+
+int set_custom_baud(int, int) {
+    return -1;
+}
+
+int get_baud(int) {
+    return -1;
+}
+
+bool set_low_latency(int, bool) {
+    return false;
+}
+
+#endif
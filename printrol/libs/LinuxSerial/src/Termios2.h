@@ -0,0 +1,12 @@
+#pragma once
+
+/// @brief Set an arbitrary baud rate through termios2 and BOTHER
+/// @return The rate the driver reports afterwards, -1 on error
+int set_custom_baud(int fd, int baud);
+
+/// @brief Output baud rate the driver reports, -1 on error
+int get_baud(int fd);
+
+/// @brief Set or clear ASYNC_LOW_LATENCY through TIOCSSERIAL
+/// @return false if the driver does not support it
+bool set_low_latency(int fd, bool enable);
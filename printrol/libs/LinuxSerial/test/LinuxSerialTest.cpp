@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include "LinuxSerial/LinuxSerial.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <pty.h>
+#include <unistd.h>
+
+
+/// @brief A pty pair, LinuxSerial opens the slave
+class LinuxSerialTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char name[128];
+        ASSERT_EQ(0, openpty(&master, &slave, name, nullptr, nullptr));
+        const std::string str(name);
+        port = std::wstring(str.begin(), str.end());
+    }
+    void TearDown() override {
+        ::close(master);
+        ::close(slave);
+    }
+
+    int master{ -1 }, slave{ -1 };
+    std::wstring port;
+};
+
+TEST_F(LinuxSerialTest, TestStandardBaud) {
+    LinuxSerial serial;
+    serial.open(port, 115200);
+    ASSERT_TRUE(serial.is_open());
+    EXPECT_EQ(115200, serial.actual_baud());
+}
+
+TEST_F(LinuxSerialTest, TestCustomBaud) {
+    for (int baud : { 250000, 256000, 128000 }) {
+        LinuxSerial serial;
+        serial.open(port, baud);
+        ASSERT_TRUE(serial.is_open()) << baud;
+        EXPECT_EQ(baud, serial.actual_baud());
+    }
+}
+
+TEST_F(LinuxSerialTest, TestLowLatencyIsOptional) {
+    // ptys have no serial_struct, the port still works
+    LinuxSerial serial;
+    serial.set_low_latency(true);
+    serial.open(port, 115200);
+    ASSERT_TRUE(serial.is_open());
+
+    ASSERT_EQ(3, ::write(master, "ok\n", 3));
+    char buf[8];
+    EXPECT_EQ(3, serial.read_some(buf, sizeof(buf), 1000));
+}
+
+TEST_F(LinuxSerialTest, TestHangup) {
+    LinuxSerial serial;
+    serial.open(port, 115200);
+    ASSERT_TRUE(serial.is_open());
+
+    // like unplugging, the read fails at once and closes the port
+    ::close(master);
+    master = -1;
+    char buf[8];
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_GT(0, serial.read_some(buf, sizeof(buf), 5000));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    EXPECT_FALSE(serial.is_open());
+    EXPECT_GT(0, serial.read_some(buf, sizeof(buf), 0));
+}
+
+TEST_F(LinuxSerialTest, TestWake) {
+    LinuxSerial serial;
+    serial.open(port, 115200);
+    ASSERT_TRUE(serial.is_open());
+
+    // a wake before the wait ends the next one, once
+    serial.wake();
+    serial.wake();
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(serial.wait_readable(5000));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    EXPECT_FALSE(serial.wait_readable(0));
+
+    std::thread waker([&serial] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        serial.wake();
+    });
+    EXPECT_FALSE(serial.wait_readable(5000));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    waker.join();
+
+    // data that arrived is still reported
+    ASSERT_EQ(3, ::write(master, "ok\n", 3));
+    serial.wake();
+    EXPECT_TRUE(serial.wait_readable(1000));
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "LinuxSerial/PortMonitor.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include <unistd.h>
+
+
+namespace fs = std::filesystem;
+
+/// @brief Fake /sys/class/tty and /dev in a temporary directory
+class PortMonitorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root = fs::temp_directory_path() / ("printrol_ports_" + std::to_string(::getpid()));
+        sys = root / "sys";
+        dev = root / "dev";
+        fs::remove_all(root);
+        fs::create_directories(sys);
+        fs::create_directories(dev);
+        // not a USB device
+        fs::create_directories(sys / "tty0");
+    }
+    void TearDown() override {
+        fs::remove_all(root);
+    }
+
+    /// @brief Add a USB CDC ACM device the way the kernel lays it out
+    void add_usb(const std::string& name, const std::string& usb_dev, const std::string& serial) {
+        const auto device = root / "devices" / usb_dev;
+        const auto interface = device / (usb_dev + ":1.0");
+        fs::create_directories(interface);
+        write(device / "idVendor", "2341\n");
+        write(device / "idProduct", "0043\n");
+        write(device / "serial", serial + "\n");
+        write(device / "manufacturer", "Arduino\n");
+        write(device / "product", "Mega 2560\n");
+
+        fs::create_directories(sys / name);
+        fs::create_directory_symlink(interface, sys / name / "device");
+        write(dev / name, "");
+    }
+
+    static void write(const fs::path& path, const std::string& content) {
+        std::ofstream(path) << content;
+    }
+
+    fs::path root, sys, dev;
+};
+
+TEST_F(PortMonitorTest, TestScan) {
+    add_usb("ttyACM1", "1-2", "B");
+    add_usb("ttyACM0", "1-1", "A");
+
+    const auto ports = scan_serial_ports(sys.string(), dev.string());
+    ASSERT_EQ(2u, ports.size());
+    EXPECT_EQ((dev / "ttyACM0").wstring(), ports[0].port);
+    EXPECT_EQ(0x2341, ports[0].vid);
+    EXPECT_EQ(0x0043, ports[0].pid);
+    EXPECT_EQ(L"A", ports[0].serial_number);
+    EXPECT_EQ(L"Arduino Mega 2560", ports[0].description);
+    EXPECT_EQ(L"B", ports[1].serial_number);
+
+    EXPECT_FALSE(scan_serial_port("tty0", sys.string(), dev.string()));
+    EXPECT_FALSE(scan_serial_port("ttyUSB9", sys.string(), dev.string()));
+}
+
+TEST_F(PortMonitorTest, TestHotplug) {
+    add_usb("ttyACM0", "1-1", "A");
+    PortMonitor monitor(sys.string(), dev.string());
+    std::atomic<int> notifications{ 0 };
+    monitor.set_callback([&] { ++notifications; });
+
+    auto wait_for = [&](std::size_t count) {
+        for (int i = 0; i < 200 && monitor.ports().size() != count; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return monitor.ports().size();
+    };
+    // the first scan runs on the monitor thread
+    EXPECT_EQ(1u, wait_for(1));
+
+    add_usb("ttyACM1", "1-2", "B");
+    EXPECT_EQ(2u, wait_for(2));
+
+    fs::remove(dev / "ttyACM0");
+    EXPECT_EQ(1u, wait_for(1));
+    EXPECT_EQ(L"B", monitor.ports()[0].serial_number);
+    EXPECT_GE(notifications, 2);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+/// @brief Marlin's MeatPack serial compression
+/// @details Once enabled by a control sequence, the firmware unpacks every received byte. A packed byte holds two
+/// characters of a 15 character table, the first in the low nibble. A nibble of 0xF means the character did not pack,
+/// it follows as a full byte after the packed one. In no-spaces mode 'E' takes the table slot of ' ' and spaces are not
+/// sent at all. A control sequence is two signal bytes and a command byte, sent between lines.
+namespace meatpack {
+
+static constexpr std::uint8_t signal_byte = 0xFF;
+
+enum class Command : std::uint8_t {
+    ENABLE_PACKING = 251,
+    DISABLE_PACKING = 250,
+    RESET_ALL = 249,
+    QUERY_CONFIG = 248,
+    ENABLE_NO_SPACES = 247,
+    DISABLE_NO_SPACES = 246,
+};
+
+/// @brief Control sequence of @p command
+std::string control(Command command);
+
+}  // namespace meatpack
+
+
+/// @brief Packs outgoing G-code lines for a firmware with MeatPack enabled
+/// @details In no-spaces mode the spaces are dropped and a "*<checksum>" at the end of the line is fixed up, so line
+/// numbered commands keep a valid checksum. Commands with a text argument, e.g. M117 or M23, keep their spaces.
+class MeatPackEncoder {
+public:
+    explicit MeatPackEncoder(bool no_spaces = true);
+
+    /// @brief Append the packed @p line to @p out
+    /// @param line One command including its '\n', a missing one is added
+    void encode(std::string_view line, std::string& out) const;
+
+    /// @brief Control sequences that switch the firmware to this encoder's mode
+    std::string enable_sequence() const;
+    /// @brief Control sequence that switches the firmware back to plain text
+    static std::string disable_sequence();
+
+    bool no_spaces() const {
+        return no_spaces_;
+    }
+
+private:
+    bool no_spaces_;
+    /// 4 bit code of each character, 0xF if it does not pack
+    std::array<std::uint8_t, 256> codes_;
+};
@@ -0,0 +1,159 @@
+#include "MeatPack/MeatPack.h"
+
+#include <algorithm>
+#include <charconv>
+
+
+/// characters by 4 bit code, 0xF marks a full byte
+static constexpr std::string_view table = "0123456789. \nGX";
+/// replaces ' ' in no-spaces mode
+static constexpr char no_spaces_char = 'E';
+static constexpr std::uint8_t not_packed = 0xF;
+
+/// commands whose text argument needs its spaces, M0 and M1 show theirs as the prompt
+static constexpr std::string_view text_commands[] = {
+    "M0", "M1", "M23", "M28", "M30", "M32", "M33", "M117", "M118", "M928",
+};
+
+
+/// @brief Whether the command of @p line, after an optional line number, takes text
+static bool has_text_argument(std::string_view line) {
+    if (not line.empty() && line[0] == 'N') {
+        const auto word_end = line.find(' ');
+        line.remove_prefix(word_end == std::string_view::npos ? line.size() : word_end);
+    }
+    line.remove_prefix(std::min(line.find_first_not_of(' '), line.size()));
+    const auto word = line.substr(0, line.find_first_of(" *\r\n"));
+    for (const auto cmd : text_commands) {
+        if (word == cmd) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+/// @brief Appends characters to a packed stream two at a time
+class Packer {
+public:
+    Packer(const std::array<std::uint8_t, 256>& codes, std::string& out) : codes_(codes), out_(out) {
+    }
+
+    void put(char c) {
+        if (has_first_) {
+            put_pair(first_, c);
+            has_first_ = false;
+        } else {
+            first_ = c;
+            has_first_ = true;
+        }
+    }
+
+    void put(std::string_view chars) {
+        for (const char c : chars) {
+            put(c);
+        }
+    }
+
+    /// @brief Complete the last pair
+    void finish() {
+        if (has_first_) {
+            // the firmware ignores what follows a '\n' in the same byte, it only must not announce a full byte
+            put_pair(first_, '\n');
+            has_first_ = false;
+        }
+    }
+
+private:
+    void put_pair(char first, char second) {
+        const auto low = codes_[static_cast<std::uint8_t>(first)];
+        const auto high = codes_[static_cast<std::uint8_t>(second)];
+        out_ += static_cast<char>(low | high << 4);
+        if (low == not_packed) {
+            out_ += first;
+        }
+        if (high == not_packed) {
+            out_ += second;
+        }
+    }
+
+    const std::array<std::uint8_t, 256>& codes_;
+    std::string& out_;
+    char first_{ 0 };
+    bool has_first_{ false };
+};
+
+}  // namespace
+
+
+std::string meatpack::control(Command command) {
+    return { static_cast<char>(signal_byte), static_cast<char>(signal_byte), static_cast<char>(command) };
+}
+
+
+MeatPackEncoder::MeatPackEncoder(bool no_spaces) : no_spaces_(no_spaces) {
+    codes_.fill(not_packed);
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        codes_[static_cast<std::uint8_t>(table[i])] = static_cast<std::uint8_t>(i);
+    }
+    if (no_spaces_) {
+        codes_[no_spaces_char] = codes_[' '];
+        codes_[' '] = not_packed;
+    }
+}
+
+std::string MeatPackEncoder::enable_sequence() const {
+    using meatpack::Command;
+    return meatpack::control(Command::ENABLE_PACKING) +
+           meatpack::control(no_spaces_ ? Command::ENABLE_NO_SPACES : Command::DISABLE_NO_SPACES);
+}
+
+std::string MeatPackEncoder::disable_sequence() {
+    return meatpack::control(meatpack::Command::DISABLE_PACKING);
+}
+
+void MeatPackEncoder::encode(std::string_view line, std::string& out) const {
+    if (not line.empty() && line.back() == '\n') {
+        line.remove_suffix(1);
+    }
+    Packer packer(codes_, out);
+
+    if (not no_spaces_ || has_text_argument(line)) {
+        packer.put(line);
+        packer.put('\n');
+        packer.finish();
+        return;
+    }
+
+    // the checksum covers the spaces, each dropped one flips bit 5 of it
+    std::string_view body = line, checksum;
+    if (const auto star = line.rfind('*'); star != std::string_view::npos) {
+        const auto digits = line.substr(star + 1);
+        if (not digits.empty() && digits.find_first_not_of("0123456789") == std::string_view::npos) {
+            body = line.substr(0, star + 1);
+            checksum = digits;
+        }
+    }
+    bool odd_spaces = false;
+    for (const char c : body) {
+        if (c == ' ') {
+            odd_spaces = not odd_spaces;
+        } else {
+            packer.put(c);
+        }
+    }
+    if (not checksum.empty()) {
+        if (odd_spaces) {
+            unsigned value = 0;
+            std::from_chars(checksum.data(), checksum.data() + checksum.size(), value);
+            char buf[8];
+            const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value ^ 0x20u);
+            packer.put(std::string_view(buf, end - buf));
+        } else {
+            packer.put(checksum);
+        }
+    }
+    packer.put('\n');
+    packer.finish();
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include "MeatPack/MeatPack.h"
+
+#include <cstdint>
+#include <string>
+
+
+/// @brief Unpack @p packed the way Marlin's MeatPack::handle_rx_char_inner does
+static std::string unpack(std::string_view packed, bool no_spaces) {
+    std::string table = "0123456789. \nGX";
+    if (no_spaces) {
+        table[11] = 'E';
+    }
+    std::string ret;
+    std::size_t full = 0;
+    char second = 0;
+    for (const char byte : packed) {
+        const auto c = static_cast<std::uint8_t>(byte);
+        if (full > 0) {
+            ret += byte;
+            if (second) {
+                ret += second;
+                second = 0;
+            }
+            --full;
+            continue;
+        }
+        const std::uint8_t low = c & 0xF, high = c >> 4;
+        if (low == 0xF) {
+            ++full;
+            if (high == 0xF) {
+                ++full;
+            } else {
+                second = table[high];
+            }
+        } else {
+            ret += table[low];
+            if (table[low] != '\n') {
+                if (high == 0xF) {
+                    ++full;
+                } else {
+                    ret += table[high];
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+/// @brief XOR of the bytes before the '*', the way Marlin checks a line
+static unsigned checksum_before_star(const std::string& line) {
+    unsigned ret = 0;
+    for (std::size_t i = 0; i < line.find('*'); ++i) {
+        ret ^= static_cast<std::uint8_t>(line[i]);
+    }
+    return ret;
+}
+
+
+TEST(MeatPackTest, TestControl) {
+    EXPECT_EQ(std::string("\xFF\xFF\xFB", 3), meatpack::control(meatpack::Command::ENABLE_PACKING));
+    EXPECT_EQ(std::string("\xFF\xFF\xFB\xFF\xFF\xF7", 6), MeatPackEncoder().enable_sequence());
+    EXPECT_EQ(std::string("\xFF\xFF\xFB\xFF\xFF\xF6", 6), MeatPackEncoder(false).enable_sequence());
+    EXPECT_EQ(std::string("\xFF\xFF\xFA", 3), MeatPackEncoder::disable_sequence());
+}
+
+TEST(MeatPackTest, TestPacksLines) {
+    const MeatPackEncoder encoder(false);
+    std::string out;
+
+    // everything packs, two characters per byte
+    encoder.encode("G1 X10.5\n", out);
+    EXPECT_EQ(5u, out.size());
+    EXPECT_EQ("G1 X10.5\n", unpack(out, false));
+
+    // odd length, full bytes on either side of a pair, a missing line ending
+    for (const std::string line : { "G1 X1\n", "M105\n", "G1 Y2 E0.5\n", "MY\n", "T0" }) {
+        out.clear();
+        encoder.encode(line, out);
+        EXPECT_EQ(line.back() == '\n' ? line : line + "\n", unpack(out, false)) << line;
+    }
+
+    // lines are packed independently, so they can be appended to one stream
+    out.clear();
+    encoder.encode("G28\n", out);
+    encoder.encode("M400\n", out);
+    EXPECT_EQ("G28\nM400\n", unpack(out, false));
+}
+
+TEST(MeatPackTest, TestNoSpaces) {
+    const MeatPackEncoder encoder;
+    std::string out;
+
+    encoder.encode("G1 X10 Y20 E0.5\n", out);
+    EXPECT_EQ("G1X10Y20E0.5\n", unpack(out, true));
+    EXPECT_EQ(8u, out.size());
+
+    // the checksum is fixed for an odd number of dropped spaces and kept for an even one
+    for (const std::string line : { "N5 G1 X1", "N6 G1 X1 Y2", "N7 M105" }) {
+        unsigned sum = 0;
+        for (const char c : line) {
+            sum ^= static_cast<std::uint8_t>(c);
+        }
+        out.clear();
+        encoder.encode(line + "*" + std::to_string(sum) + "\n", out);
+        const auto unpacked = unpack(out, true);
+        EXPECT_EQ(std::string::npos, unpacked.find(' ')) << line;
+        EXPECT_EQ(std::to_string(checksum_before_star(unpacked)) + "\n",
+                  unpacked.substr(unpacked.find('*') + 1))
+            << line;
+    }
+
+    // text arguments keep their spaces
+    out.clear();
+    encoder.encode("N8 M117 Hello World*62\n", out);
+    EXPECT_EQ("N8 M117 Hello World*62\n", unpack(out, true));
+    out.clear();
+    encoder.encode("M0 Remove the brim\n", out);
+    EXPECT_EQ("M0 Remove the brim\n", unpack(out, true));
+    // M10 is no text command
+    out.clear();
+    encoder.encode("M10 S1\n", out);
+    EXPECT_EQ("M10S1\n", unpack(out, true));
+}
+
+TEST(MeatPackTest, TestReduction) {
+    const MeatPackEncoder encoder;
+    const std::string line = "N1234 G1 X112.345 Y98.765 E0.04321*87\n";
+    std::string out;
+    encoder.encode(line, out);
+    EXPECT_LT(out.size() * 10, line.size() * 7);
+}
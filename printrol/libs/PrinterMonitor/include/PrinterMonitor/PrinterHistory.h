@@ -0,0 +1,49 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include "PrinterMonitor/TimeSeries.h"
+
+struct PrinterState;
+
+/// @brief Identifies one recorded value of PrinterHistory
+struct HistoryChannel {
+    enum Kind : std::uint8_t { HOTEND, BED, CHAMBER, PROBE, COOLER, BOARD, REDUNDANT, AXIS };
+    Kind kind;
+    /// hotend index, or the index of the axis in "XYZIJKUVWE"
+    std::uint8_t index{ 0 };
+
+    static HistoryChannel hotend(std::size_t index);
+    /// @param letter Axis name, 'E' for the extruder
+    static HistoryChannel axis(char letter);
+};
+
+/// @brief Temperature and position history of a printer in fixed memory
+/// @details Every heater's actual temperature and every axis position get a TimeSeries. All memory is allocated on
+/// construction, recording never allocates. Thread safe.
+class PrinterHistory {
+public:
+    using time_point = TimeSeries::time_point;
+
+    explicit PrinterHistory(const TimeSeries::Config& config = TimeSeries::Config());
+
+    /// @brief Append the temperatures of all heaters present in @p state
+    void record_temperatures(const PrinterState& state, time_point time);
+    /// @brief Append the position of all axes present in @p state
+    void record_position(const PrinterState& state, time_point time);
+
+    void clear();
+
+    std::vector<TimeSeries::Sample> raw(HistoryChannel channel, time_point from, time_point to) const;
+    std::vector<TimeSeries::Aggregate> aggregates(HistoryChannel channel, TimeSeries::Resolution res,
+                                                  time_point from, time_point to) const;
+
+private:
+    const TimeSeries* series(HistoryChannel channel) const;
+
+    mutable std::mutex mtx_;
+    std::vector<TimeSeries> hotends_;
+    /// BED to REDUNDANT
+    std::vector<TimeSeries> heaters_;
+    std::vector<TimeSeries> axes_;
+};
@@ -1,12 +1,76 @@
 #pragma once
 
+#include <string>
 #include <string_view>
 #include <vector>
+#include <array>
 #include <mutex>
 #include <optional>
 #include <chrono>
+#include <bitset>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include "PrinterMonitor/StaticVector.h"
+#include "PrinterMonitor/SeqLock.h"
+#include "PrinterMonitor/PrinterHistory.h"
+#include <memory>
+
+/// Boolean capabilities reported by M115 as "Cap:NAME:0/1"
+#define PRINTER_CAPABILITY_FLAGS(X) \
+    X(PAREN_COMMENTS)               \
+    X(GCODE_QUOTED_STRINGS)         \
+    X(SERIAL_XON_XOFF)              \
+    X(BINARY_FILE_TRANSFER)         \
+    X(EEPROM)                       \
+    X(VOLUMETRIC)                   \
+    X(AUTOREPORT_POS)               \
+    X(AUTOREPORT_TEMP)              \
+    X(PROGRESS)                     \
+    X(PRINT_JOB)                    \
+    X(AUTOLEVEL)                    \
+    X(RUNOUT)                       \
+    X(Z_PROBE)                      \
+    X(LEVELING_DATA)                \
+    X(BUILD_PERCENT)                \
+    X(SOFTWARE_POWER)               \
+    X(TOGGLE_LIGHTS)                \
+    X(CASE_LIGHT_BRIGHTNESS)        \
+    X(SPINDLE)                      \
+    X(LASER)                        \
+    X(EMERGENCY_PARSER)             \
+    X(HOST_ACTION_COMMANDS)         \
+    X(PROMPT_SUPPORT)               \
+    X(SDCARD)                       \
+    X(MULTI_VOLUME)                 \
+    X(REPEAT)                       \
+    X(SD_WRITE)                     \
+    X(AUTOREPORT_SD_STATUS)         \
+    X(LONG_FILENAME)                \
+    X(LFN_WRITE)                    \
+    X(CUSTOM_FIRMWARE_UPLOAD)       \
+    X(EXTENDED_M20)                 \
+    X(THERMAL_PROTECTION)           \
+    X(MOTION_MODES)                 \
+    X(ARCS)                         \
+    X(BABYSTEPPING)                 \
+    X(CHAMBER_TEMPERATURE)          \
+    X(COOLER_TEMPERATURE)           \
+    X(MEATPACK)                     \
+    X(CONFIG_EXPORT)
+
+enum class PrinterCapability : std::uint8_t {
+#define _CAP_ENUM(NAME) NAME,
+    PRINTER_CAPABILITY_FLAGS(_CAP_ENUM)
+#undef _CAP_ENUM
+    COUNT
+};
 
 struct PrinterCapabilities {
+    using Cap = PrinterCapability;
+    using flags_t = std::bitset<static_cast<std::size_t>(Cap::COUNT)>;
+
     std::string FIRMWARE_NAME;
     std::string SOURCE_CODE_URL;
     std::string PROTOCOL_VERSION;
@@ -14,46 +78,19 @@ struct PrinterCapabilities {
     int AXIS_COUNT{ 3 };
     std::string UUID;
     int EXTRUDER_COUNT{ 0 };
-    bool PAREN_COMMENTS{ false };
-    bool GCODE_QUOTED_STRINGS{ false };
-    bool SERIAL_XON_XOFF{ false };
-    bool BINARY_FILE_TRANSFER{ false };
-    bool EEPROM{ false };
-    bool VOLUMETRIC{ false };
-    bool AUTOREPORT_POS{ false };
-    bool AUTOREPORT_TEMP{ false };
-    bool PROGRESS{ false };
-    bool PRINT_JOB{ false };
-    bool AUTOLEVEL{ false };
-    bool RUNOUT{ false };
-    bool Z_PROBE{ false };
-    bool LEVELING_DATA{ false };
-    bool BUILD_PERCENT{ false };
-    bool SOFTWARE_POWER{ false };
-    bool TOGGLE_LIGHTS{ false };
-    bool CASE_LIGHT_BRIGHTNESS{ false };
-    bool SPINDLE{ false };
-    bool LASER{ false };
-    bool EMERGENCY_PARSER{ false };
-    bool HOST_ACTION_COMMANDS{ false };
-    bool PROMPT_SUPPORT{ false };
-    bool SDCARD{ false };
-    bool MULTI_VOLUME{ false };
-    bool REPEAT{ false };
-    bool SD_WRITE{ false };
-    bool AUTOREPORT_SD_STATUS{ false };
-    bool LONG_FILENAME{ false };
-    bool LFN_WRITE{ false };
-    bool CUSTOM_FIRMWARE_UPLOAD{ false };
-    bool EXTENDED_M20{ false };
-    bool THERMAL_PROTECTION{ false };
-    bool MOTION_MODES{ false };
-    bool ARCS{ false };
-    bool BABYSTEPPING{ false };
-    bool CHAMBER_TEMPERATURE{ false };
-    bool COOLER_TEMPERATURE{ false };
-    bool MEATPACK{ false };
-    bool CONFIG_EXPORT{ false };
+    flags_t flags;
+
+    bool has(Cap cap) const {
+        return flags.test(static_cast<std::size_t>(cap));
+    }
+    void set(Cap cap, bool value = true) {
+        flags.set(static_cast<std::size_t>(cap), value);
+    }
+
+    /// @brief Name of the capability as reported by the firmware
+    static std::string_view name(Cap cap);
+    /// @brief Look up a capability by the name reported by the firmware
+    static std::optional<Cap> from_name(std::string_view name);
 };
 
 
@@ -62,120 +99,255 @@ struct PrinterTemperature {
     int power{ 0 };
 };
 
+/// @brief Everything PrinterMonitor knows about the printer, apart from the capabilities
+/// @details Plain data, published by the monitor as a whole so readers always see a consistent state
+struct PrinterState {
+    using temp_t = PrinterTemperature;
+
+    /// Marlin supports at most 8 hotends
+    static constexpr std::size_t max_hotends = 8;
+    using hotends_t = StaticVector<temp_t, max_hotends>;
+
+    /// Marlin supports at most 9 axes, reported in this order, followed by E
+    static constexpr std::string_view axis_letters = "XYZIJKUVW";
+    static constexpr std::size_t max_axes = axis_letters.size();
+    /// positions of the axes, then E if the machine has an extruder
+    using position_t = StaticVector<float, max_axes + 1>;
+    /// stepper positions in steps, E is not reported
+    using counts_t = StaticVector<std::int32_t, max_axes>;
+
+    position_t position;
+    /// number of axes in position, excluding E
+    std::uint8_t axis_count{ 0 };
+    counts_t stepper_counts;
+    bool position_known{ false };
+    bool has_leveling{ false };
+    bool leveling_active{ false };
+
+    hotends_t hotends;
+    std::optional<temp_t> bed;
+    std::optional<temp_t> chamber;
+    std::optional<temp_t> probe;
+    std::optional<temp_t> cooler;
+    std::optional<temp_t> board;
+    std::optional<temp_t> redundant;
+
+    std::chrono::steady_clock::time_point last_position, last_temperature;
+
+    /// @brief Reported position of an axis
+    /// @param letter Axis name, 'E' for the extruder
+    std::optional<float> axis_position(char letter) const {
+        const auto idx = letter == 'E' ? axis_count : axis_letters.find(letter);
+        if (idx == std::string_view::npos || (letter != 'E' && idx >= axis_count) || idx >= position.size()) {
+            return std::nullopt;
+        }
+        return position[idx];
+    }
+};
+
+/// @brief Bits of the mask returned by PrinterMonitor::parse_line, one per group of PrinterState
+struct PrinterChange {
+    using mask_t = std::uint32_t;
+
+    static constexpr mask_t NONE = 0;
+    static constexpr mask_t POSITION = 1u << 0;
+    static constexpr mask_t STEPPER_COUNTS = 1u << 1;
+    static constexpr mask_t BED = 1u << 2;
+    static constexpr mask_t CHAMBER = 1u << 3;
+    static constexpr mask_t PROBE = 1u << 4;
+    static constexpr mask_t COOLER = 1u << 5;
+    static constexpr mask_t BOARD = 1u << 6;
+    static constexpr mask_t REDUNDANT = 1u << 7;
+    static constexpr mask_t CAPABILITIES = 1u << 8;
+    /// first of the PrinterState::max_hotends hotend bits
+    static constexpr mask_t HOTEND_0 = 1u << 16;
+    static constexpr mask_t HOTENDS = ((1u << PrinterState::max_hotends) - 1) * HOTEND_0;
+
+    static constexpr mask_t hotend(std::size_t index) {
+        return HOTEND_0 << index;
+    }
+};
+
 class PrinterMonitor {
 public:
     using temp_t = PrinterTemperature;
-    using pos_t = std::vector<float>;
+    using pos_t = PrinterState::position_t;
     using lck_t = std::unique_lock<std::mutex>;
 
+    using state_t = PrinterState;
+    static constexpr std::size_t max_hotends = PrinterState::max_hotends;
+    using hotends_t = PrinterState::hotends_t;
+    using change_t = PrinterChange::mask_t;
+
     PrinterMonitor() {
         reset();
-        parsers_.push_back(&PrinterMonitor::ok_parser);
-        parsers_.push_back(&PrinterMonitor::parse_position);
-        parsers_.push_back(&PrinterMonitor::parse_temperature);
-        parsers_.push_back(&PrinterMonitor::parse_capability);
+        add_parser("ok", &PrinterMonitor::ok_parser);
+        add_parser("ok T:", &PrinterMonitor::parse_temperature);
+        add_parser("ok T0:", &PrinterMonitor::parse_temperature);
+        add_parser("X:", &PrinterMonitor::parse_position);
+        add_parser(" T:", &PrinterMonitor::parse_temperature);
+        add_parser(" T0:", &PrinterMonitor::parse_temperature);
+        add_parser("T:", &PrinterMonitor::parse_temperature);
+        add_parser("T0:", &PrinterMonitor::parse_temperature);
+        add_parser("Cap:", &PrinterMonitor::parse_capability);
+        add_parser("FIRMWARE_NAME", &PrinterMonitor::parse_capability);
+        // recognized, but carry no printer state
+        add_parser("echo:", &PrinterMonitor::skip_line);
+        add_parser("Error:", &PrinterMonitor::skip_line);
+        add_parser("Resend:", &PrinterMonitor::skip_line);
+        add_parser("busy:", &PrinterMonitor::skip_line);
     }
 
-    bool parse_line(std::string_view line);
+    /// @brief Parse one line received from the printer, with or without the line ending
+    /// @return PrinterChange bits of the state groups that changed, NONE if nothing did
+    change_t parse_line(std::string_view line);
+
+    /// @brief Parse all lines of @p buffer with a single lock and publication
+    /// @param buffer Lines separated by '\n', the last one does not need a line ending
+    /// @return Combined PrinterChange bits of all lines
+    change_t parse_lines(std::string_view buffer);
+
+    /// @brief Parse @p count lines with a single lock and publication
+    /// @return Combined PrinterChange bits of all lines
+    change_t parse_lines(const std::string_view* lines, std::size_t count);
 
     void reset();
 
+    /// @brief Consistent copy of the whole printer state. Does not lock or allocate.
+    state_t snapshot() const {
+        return snapshot_.load();
+    }
+
     // position
     pos_t get_position() const {
-        lck_t l(mtx_);
-        return position_;
+        return snapshot().position;
     }
     bool position_known() const {
-        lck_t l(mtx_);
-        return position_known_;
+        return snapshot().position_known;
     }
     bool has_leveling() const {
-        lck_t l(mtx_);
-        return has_leveling_;
+        return snapshot().has_leveling;
     }
     bool is_leveling_active() const {
-        lck_t l(mtx_);
-        return leveling_active_;
+        return snapshot().leveling_active;
     }
 
     // temperature
     bool has_hotend(int index = 0) const {
-        lck_t l(mtx_);
-        return hotend_temps_.size() > (index + 1);
+        return index >= 0 && snapshot().hotends.size() > static_cast<std::size_t>(index);
     }
     bool has_bed() const {
-        lck_t l(mtx_);
-        return bed_temp_.has_value();
+        return snapshot().bed.has_value();
     }
     bool has_chamber() const {
-        lck_t l(mtx_);
-        return chamber_temp_.has_value();
+        return snapshot().chamber.has_value();
     }
     std::optional<temp_t> get_bed_temp() const {
-        lck_t l(mtx_);
-        return bed_temp_;
+        return snapshot().bed;
     }
     std::optional<temp_t> get_hotend_temp(int index = 0) const {
-        lck_t l(mtx_);
-        if (hotend_temps_.size() < index + 1) {
+        const auto hotends = snapshot().hotends;
+        if (index < 0 || hotends.size() <= static_cast<std::size_t>(index)) {
             return std::nullopt;
         }
-        return hotend_temps_[index];
+        return hotends[index];
     }
     std::optional<temp_t> get_chamber_temp() const {
-        lck_t l(mtx_);
-        return chamber_temp_;
+        return snapshot().chamber;
     }
     std::optional<temp_t> get_probe_temp() const {
-        lck_t l(mtx_);
-        return probe_temp_;
+        return snapshot().probe;
     }
     std::optional<temp_t> get_cooler_temp() const {
-        lck_t l(mtx_);
-        return cooler_temp_;
+        return snapshot().cooler;
     }
     std::optional<temp_t> get_board_temp() const {
-        lck_t l(mtx_);
-        return board_temp_;
+        return snapshot().board;
     }
     std::optional<temp_t> get_redundant_temp() const {
-        lck_t l(mtx_);
-        return redundant_temp_;
+        return snapshot().redundant;
+    }
+
+    /// @brief Start recording temperature and position history. Allocates all of its memory up front.
+    void enable_history(const TimeSeries::Config& config = TimeSeries::Config());
+    /// @brief Recorded history, nullptr unless enable_history was called
+    const PrinterHistory* history() const {
+        return history_.get();
     }
 
     std::optional<PrinterCapabilities> get_capabilities() const {
         lck_t l(mtx_);
         return capabilities_;
     }
+    /// @brief true once the printer answered M115. Does not lock.
+    bool capabilities_known() const {
+        return capabilities_known_.load(std::memory_order_acquire);
+    }
+    /// @brief Test a single capability flag without copying the capabilities. Does not lock.
+    bool has_capability(PrinterCapability cap) const {
+        return (capability_flags_.load(std::memory_order_acquire) >> static_cast<unsigned>(cap)) & 1;
+    }
 
     std::string request_from_printer();
 
+    /// @brief Handles a line without its line ending, returns PrinterChange bits to report
+    using line_parser_t = std::function<change_t(std::string_view)>;
+
+    /// @brief Register @p parser for lines starting with @p prefix, e.g. a firmware specific report
+    /// @details Same dispatch as the built-in parsers, a longer prefix takes lines from a shorter one. Called under
+    /// the monitor's lock, @p parser must not call back into the monitor. Register before parsing lines.
+    void add_parser(std::string prefix, line_parser_t parser);
+
 private:
-    bool ok_parser();
-    bool parse_position();
-    bool parse_temperature();
-    bool parse_capability();
+    using parser_t = change_t (PrinterMonitor::*)(std::string_view);
+
+    struct ParserEntry {
+        std::string_view prefix;
+        parser_t parser;
+        /// set instead of parser for parsers added from outside
+        const line_parser_t* external;
+    };
+
+    /// @brief Register @p parser for lines starting with @p prefix
+    /// @details Lines are dispatched on their first byte, then the longest matching prefix wins,
+    /// so every line is handed to at most one parser.
+    /// @param prefix Must outlive the monitor, use string literals
+    void add_parser(std::string_view prefix, parser_t parser, const line_parser_t* external = nullptr);
+
+    /// @brief Parser registered for @p line, nullptr if none. @p line is stripped of its line ending.
+    const ParserEntry* find_parser(std::string_view& line) const;
+    change_t call(const ParserEntry& entry, std::string_view line) {
+        return entry.external ? (*entry.external)(line) : (this->*entry.parser)(line);
+    }
 
-    std::string current_line_;
+    change_t ok_parser(std::string_view line);
+    change_t parse_position(std::string_view line);
+    change_t parse_temperature(std::string_view line);
+    change_t parse_capability(std::string_view line);
+    change_t skip_line(std::string_view line);
+    void parse_firmware_info(std::string_view line);
 
-    using parser_t = bool (PrinterMonitor::*)();
-    std::vector<parser_t> parsers_;
+    /// registered parsers bucketed by the first byte of their prefix, longest prefix first
+    std::array<std::vector<ParserEntry>, 256> parsers_;
+    /// prefixes and parsers added from outside, a deque keeps them in place for ParserEntry
+    std::deque<std::pair<std::string, line_parser_t>> external_parsers_;
+    /// serializes the writers: parse_line and reset
     mutable std::mutex mtx_;
 
-    std::chrono::steady_clock::time_point last_position_, last_temperature_, last_request_;
+    std::chrono::steady_clock::time_point last_request_;
 
-    pos_t position_;
-    bool position_known_;
-    bool has_leveling_;
-    bool leveling_active_;
+    /// working copy, modified by the parsers under mtx_
+    state_t state_;
+    /// AXIS_COUNT of the printer, decides which axes parse_position expects
+    std::size_t axis_count_{ 3 };
+    /// last published state_, read without locking
+    SeqLock<state_t> snapshot_;
 
-    std::vector<temp_t> hotend_temps_;
-    std::optional<temp_t> bed_temp_;
-    std::optional<temp_t> chamber_temp_;
-    std::optional<temp_t> probe_temp_;
-    std::optional<temp_t> cooler_temp_;
-    std::optional<temp_t> board_temp_;
-    std::optional<temp_t> redundant_temp_;
+    std::unique_ptr<PrinterHistory> history_;
 
     std::optional<PrinterCapabilities> capabilities_;
+    // mirror of capabilities_ for lock-free checks
+    static_assert(static_cast<std::size_t>(PrinterCapability::COUNT) <= 64);
+    std::atomic<std::uint64_t> capability_flags_{ 0 };
+    std::atomic<bool> capabilities_known_{ false };
 };
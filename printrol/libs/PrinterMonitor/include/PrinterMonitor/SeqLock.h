@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+/// @brief Single writer, multiple reader publication of a trivially copyable value
+/// @details The writer never waits. Readers copy the value and retry if the writer published in the meantime, they
+/// never take a lock and never allocate. The value is kept in atomic words, so a torn read is detected, not a data race.
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock needs a trivially copyable type");
+    static_assert(std::is_default_constructible_v<T>, "SeqLock needs a default constructible type");
+
+    using word_t = std::uint64_t;
+    static constexpr std::size_t word_count = (sizeof(T) + sizeof(word_t) - 1) / sizeof(word_t);
+
+public:
+    SeqLock() {
+        store(T{});
+    }
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    /// @brief Publish a new value. Must not be called concurrently.
+    void store(const T& val) {
+        std::array<word_t, word_count> buf{};
+        std::memcpy(buf.data(), &val, sizeof(T));
+
+        const auto seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < word_count; ++i) {
+            data_[i].store(buf[i], std::memory_order_relaxed);
+        }
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    /// @brief Get a consistent copy of the last published value
+    T load() const {
+        std::array<word_t, word_count> buf;
+        for (;;) {
+            const auto seq1 = seq_.load(std::memory_order_acquire);
+            if (seq1 & 1) {
+                // store in progress
+                continue;
+            }
+            for (std::size_t i = 0; i < word_count; ++i) {
+                buf[i] = data_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == seq1) {
+                break;
+            }
+        }
+        T ret;
+        // T is trivially copyable, but may have a non-trivial default constructor, which -Wclass-memaccess flags
+        std::memcpy(static_cast<void*>(&ret), buf.data(), sizeof(T));
+        return ret;
+    }
+
+private:
+    std::atomic<std::uint32_t> seq_{ 0 };
+    std::array<std::atomic<word_t>, word_count> data_;
+};
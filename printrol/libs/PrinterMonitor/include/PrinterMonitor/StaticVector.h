@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+
+
+/// @brief Vector-like container with inline storage of fixed capacity. Never allocates.
+/// @details Trivially copyable if T is, so it can be copied around as plain data
+template <typename T, std::size_t N>
+class StaticVector {
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    constexpr StaticVector() = default;
+    /// @brief Construct from a list of values, values past the capacity are dropped
+    constexpr StaticVector(std::initializer_list<T> init) {
+        for (const auto& val : init) {
+            push_back(val);
+        }
+    }
+
+    constexpr std::size_t size() const {
+        return size_;
+    }
+    static constexpr std::size_t capacity() {
+        return N;
+    }
+    constexpr bool empty() const {
+        return size_ == 0;
+    }
+    constexpr bool full() const {
+        return size_ == N;
+    }
+
+    /// @brief Append an element
+    /// @return false if the container is full, the element is dropped
+    constexpr bool push_back(const T& val) {
+        if (full()) {
+            return false;
+        }
+        data_[size_++] = val;
+        return true;
+    }
+
+    /// @brief Change the size, new elements are value initialized. Clamped to capacity.
+    constexpr void resize(std::size_t count) {
+        if (count > N) {
+            count = N;
+        }
+        for (std::size_t i = size_; i < count; ++i) {
+            data_[i] = T{};
+        }
+        size_ = count;
+    }
+
+    constexpr void clear() {
+        size_ = 0;
+    }
+
+    constexpr T& operator[](std::size_t i) {
+        return data_[i];
+    }
+    constexpr const T& operator[](std::size_t i) const {
+        return data_[i];
+    }
+
+    constexpr T* data() {
+        return data_.data();
+    }
+    constexpr const T* data() const {
+        return data_.data();
+    }
+
+    constexpr iterator begin() {
+        return data();
+    }
+    constexpr iterator end() {
+        return data() + size_;
+    }
+    constexpr const_iterator begin() const {
+        return data();
+    }
+    constexpr const_iterator end() const {
+        return data() + size_;
+    }
+
+    friend constexpr bool operator==(const StaticVector& l, const StaticVector& r) {
+        if (l.size_ != r.size_) {
+            return false;
+        }
+        for (std::size_t i = 0; i < l.size_; ++i) {
+            if (not(l.data_[i] == r.data_[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    friend constexpr bool operator!=(const StaticVector& l, const StaticVector& r) {
+        return not(l == r);
+    }
+
+private:
+    std::array<T, N> data_{};
+    std::size_t size_{ 0 };
+};
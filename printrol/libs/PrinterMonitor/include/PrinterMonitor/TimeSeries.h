@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+
+/// @brief Ring buffer with capacity fixed at construction, the oldest element is overwritten when full
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(std::size_t capacity) : data_(capacity) {
+    }
+
+    void push(const T& val) {
+        if (data_.empty()) {
+            return;
+        }
+        if (size_ < data_.size()) {
+            data_[(first_ + size_) % data_.size()] = val;
+            ++size_;
+        } else {
+            data_[first_] = val;
+            first_ = (first_ + 1) % data_.size();
+        }
+    }
+
+    void clear() {
+        first_ = 0;
+        size_ = 0;
+    }
+
+    std::size_t size() const {
+        return size_;
+    }
+    std::size_t capacity() const {
+        return data_.size();
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    /// @brief Element @p i, 0 being the oldest one
+    const T& operator[](std::size_t i) const {
+        return data_[(first_ + i) % data_.size()];
+    }
+
+private:
+    std::vector<T> data_;
+    std::size_t first_{ 0 }, size_{ 0 };
+};
+
+
+/// @brief Number of entries TimeSeries keeps per resolution
+struct TimeSeriesConfig {
+    /// raw samples, 10 minutes at M155 S1
+    std::size_t raw{ 600 };
+    /// 1 s aggregates, 30 minutes
+    std::size_t seconds{ 1800 };
+    /// 10 s aggregates, 48 hours
+    std::size_t ten_seconds{ 17280 };
+};
+
+/// @brief History of one value in fixed memory
+/// @details Keeps the last raw samples, plus 1 s and 10 s aggregates (average, min, max) built as samples arrive.
+/// Appending is O(1) and never allocates, when a buffer is full its oldest entry is dropped. Samples must be appended
+/// in time order.
+class TimeSeries {
+public:
+    using clock_t = std::chrono::steady_clock;
+    using time_point = clock_t::time_point;
+
+    struct Sample {
+        time_point time;
+        float value;
+    };
+
+    struct Aggregate {
+        time_point start;
+        float min, max, avg;
+        std::uint32_t count;
+    };
+
+    enum class Resolution { SECOND, TEN_SECONDS };
+
+    using Config = TimeSeriesConfig;
+
+    explicit TimeSeries(const Config& config = Config());
+
+    void append(time_point time, float value);
+
+    void clear();
+
+    /// @brief Raw samples with from <= time < to
+    std::vector<Sample> raw(time_point from, time_point to) const;
+
+    /// @brief Aggregates with from <= start < to, including the one still being filled
+    std::vector<Aggregate> aggregates(Resolution res, time_point from, time_point to) const;
+
+private:
+    struct Bucket {
+        time_point start;
+        float min, max;
+        double sum;
+        std::uint32_t count;
+
+        void add(float min_val, float max_val, double sum_val, std::uint32_t cnt);
+        Aggregate to_aggregate() const;
+    };
+
+    void close_second();
+
+    RingBuffer<Sample> raw_;
+    RingBuffer<Aggregate> seconds_, ten_seconds_;
+    std::optional<Bucket> open_second_, open_ten_seconds_;
+};
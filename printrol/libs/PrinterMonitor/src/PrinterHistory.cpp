@@ -0,0 +1,83 @@
+#include "PrinterMonitor/PrinterHistory.h"
+#include "PrinterMonitor/PrinterMonitor.h"
+
+#include <array>
+
+/// axis letters as in PrinterState, followed by the extruder
+static constexpr std::string_view history_axes = "XYZIJKUVWE";
+static_assert(history_axes.size() == PrinterState::max_axes + 1);
+
+
+HistoryChannel HistoryChannel::hotend(std::size_t index) {
+    return HistoryChannel{ HOTEND, static_cast<std::uint8_t>(index) };
+}
+
+HistoryChannel HistoryChannel::axis(char letter) {
+    const auto idx = history_axes.find(letter);
+    return HistoryChannel{ AXIS, static_cast<std::uint8_t>(idx == std::string_view::npos ? history_axes.size() : idx) };
+}
+
+
+PrinterHistory::PrinterHistory(const TimeSeries::Config& config)
+  : hotends_(PrinterState::max_hotends, TimeSeries(config))
+  , heaters_(HistoryChannel::REDUNDANT - HistoryChannel::BED + 1, TimeSeries(config))
+  , axes_(history_axes.size(), TimeSeries(config)) {
+}
+
+void PrinterHistory::record_temperatures(const PrinterState& state, time_point time) {
+    const std::array<const std::optional<PrinterTemperature>*, 6> heaters = {
+        &state.bed, &state.chamber, &state.probe, &state.cooler, &state.board, &state.redundant,
+    };
+
+    std::lock_guard l(mtx_);
+    for (std::size_t i = 0; i < state.hotends.size(); ++i) {
+        hotends_[i].append(time, state.hotends[i].actual);
+    }
+    for (std::size_t i = 0; i < heaters.size(); ++i) {
+        if (heaters[i]->has_value()) {
+            heaters_[i].append(time, (*heaters[i])->actual);
+        }
+    }
+}
+
+void PrinterHistory::record_position(const PrinterState& state, time_point time) {
+    std::lock_guard l(mtx_);
+    for (std::size_t i = 0; i < state.position.size(); ++i) {
+        // everything after the axes is E
+        const auto axis = i < state.axis_count ? i : PrinterState::max_axes;
+        axes_[axis].append(time, state.position[i]);
+    }
+}
+
+void PrinterHistory::clear() {
+    std::lock_guard l(mtx_);
+    for (auto* group : { &hotends_, &heaters_, &axes_ }) {
+        for (auto& series : *group) {
+            series.clear();
+        }
+    }
+}
+
+const TimeSeries* PrinterHistory::series(HistoryChannel channel) const {
+    switch (channel.kind) {
+        case HistoryChannel::HOTEND:
+            return channel.index < hotends_.size() ? &hotends_[channel.index] : nullptr;
+        case HistoryChannel::AXIS:
+            return channel.index < axes_.size() ? &axes_[channel.index] : nullptr;
+        default:
+            return channel.kind <= HistoryChannel::REDUNDANT ? &heaters_[channel.kind - HistoryChannel::BED] : nullptr;
+    }
+}
+
+std::vector<TimeSeries::Sample> PrinterHistory::raw(HistoryChannel channel, time_point from, time_point to) const {
+    std::lock_guard l(mtx_);
+    const auto* s = series(channel);
+    return s ? s->raw(from, to) : std::vector<TimeSeries::Sample>();
+}
+
+std::vector<TimeSeries::Aggregate> PrinterHistory::aggregates(HistoryChannel channel, TimeSeries::Resolution res,
+                                                              time_point from, time_point to) const {
+    std::lock_guard l(mtx_);
+    const auto* s = series(channel);
+    return s ? s->aggregates(res, from, to) : std::vector<TimeSeries::Aggregate>();
+}
@@ -1,286 +1,567 @@
 #include "PrinterMonitor/PrinterMonitor.h"
-#include <regex>
 #include <array>
-#include <tuple>
-#include <sstream>
 #include <optional>
+#include <charconv>
+#include <algorithm>
+
+
+/// @brief Parse a number from the beginning of @p str, leading spaces are skipped
+/// @param str Input, on success advanced past the parsed number
+/// @param out Destination
+/// @return true if a number was parsed
+template <typename T>
+static bool consume_number(std::string_view& str, T& out) {
+    const char* first = str.data();
+    const char* const last = first + str.size();
+    while (first != last && *first == ' ') {
+        ++first;
+    }
+    // from_chars does not accept a leading '+'
+    if (first != last && *first == '+') {
+        ++first;
+    }
+    const auto [ptr, ec] = std::from_chars(first, last, out);
+    if (ec != std::errc()) {
+        return false;
+    }
+    str.remove_prefix(ptr - str.data());
+    return true;
+}
+
+static bool same_temp(const PrinterTemperature& l, const PrinterTemperature& r) {
+    return l.actual == r.actual && l.set == r.set && l.power == r.power;
+}
+
+/// @brief Parse an unsigned index, e.g. the 1 in "T1"
+/// @return the index, or -1 if @p str is not a decimal number
+static int parse_index(std::string_view str) {
+    int idx = -1;
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), idx);
+    if (str.empty() || ec != std::errc() || ptr != str.data() + str.size() || idx < 0) {
+        return -1;
+    }
+    return idx;
+}
+
 
 void PrinterMonitor::reset() {
     lck_t l(mtx_);
-    position_.clear();
-    position_known_ = false;
-    has_leveling_ = false;
-    leveling_active_ = false;
-
-    hotend_temps_.clear();
-    bed_temp_.reset();
-    chamber_temp_.reset();
-    probe_temp_.reset();
-    cooler_temp_.reset();
-    board_temp_.reset();
-    redundant_temp_.reset();
+    state_ = state_t();
+    axis_count_ = PrinterCapabilities().AXIS_COUNT;
+    snapshot_.store(state_);
+    if (history_) {
+        history_->clear();
+    }
+
     capabilities_.reset();
+    capability_flags_ = 0;
+    capabilities_known_ = false;
 }
 
-bool PrinterMonitor::parse_line(std::string_view line) {
-    lck_t l(mtx_);
-    current_line_ = line;
+PrinterMonitor::change_t PrinterMonitor::parse_line(std::string_view line) {
+    const auto parser = find_parser(line);
+    if (parser == nullptr) {
+        return PrinterChange::NONE;
+    }
 
-    for (const auto& parser : parsers_) {
-        if ((this->*parser)()) {
-            return true;
-        }
+    lck_t l(mtx_);
+    const change_t changes = call(*parser, line);
+    if (changes != PrinterChange::NONE) {
+        snapshot_.store(state_);
     }
-    return false;
+    return changes;
 }
 
+PrinterMonitor::change_t PrinterMonitor::parse_lines(std::string_view buffer) {
+    change_t changes = PrinterChange::NONE;
+    lck_t l(mtx_);
+    while (not buffer.empty()) {
+        const auto end = buffer.find('\n');
+        std::string_view line = buffer.substr(0, end);
+        buffer.remove_prefix(end == std::string_view::npos ? buffer.size() : end + 1);
 
-bool PrinterMonitor::parse_position() {
-    // pre-check
-    if (current_line_.size() < 1 || current_line_[0] != 'X') {
-        return false;
+        if (const auto parser = find_parser(line)) {
+            changes |= call(*parser, line);
+        }
+    }
+    if (changes != PrinterChange::NONE) {
+        snapshot_.store(state_);
     }
+    return changes;
+}
 
-    const std::string regex_ending = "([+-]?\\d*.?\\d*).*$";
-    std::array<std::string, 4> axis_names = { "X:", "Y:", "Z:", "E:" };
-    pos_t pos2;
-    pos2.reserve(4);
-    for (const auto& name : axis_names) {
-        const std::string rgx = name + regex_ending;
-        std::smatch m;
-        bool res = std::regex_search(current_line_, m, std::regex(rgx));
-        if (not res || m.size() < 2) {
-            break;
+PrinterMonitor::change_t PrinterMonitor::parse_lines(const std::string_view* lines, std::size_t count) {
+    change_t changes = PrinterChange::NONE;
+    lck_t l(mtx_);
+    for (std::size_t i = 0; i < count; ++i) {
+        std::string_view line = lines[i];
+        if (const auto parser = find_parser(line)) {
+            changes |= call(*parser, line);
         }
-        std::string match(m[1]);
+    }
+    if (changes != PrinterChange::NONE) {
+        snapshot_.store(state_);
+    }
+    return changes;
+}
 
-        try {
-            float pos = std::stof(match);
-            pos2.push_back(pos);
-        } catch (...) {
-        }
+const PrinterMonitor::ParserEntry* PrinterMonitor::find_parser(std::string_view& line) const {
+    while (not line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+        line.remove_suffix(1);
+    }
+    if (line.empty()) {
+        return nullptr;
     }
 
-    if (pos2.size() == 4) {
-        position_ = std::move(pos2);
-        last_position_ = std::chrono::steady_clock::now();
-        return true;
+    const auto& bucket = parsers_[static_cast<unsigned char>(line[0])];
+    for (const auto& entry : bucket) {
+        if (line.substr(0, entry.prefix.size()) == entry.prefix) {
+            return &entry;
+        }
     }
-    return false;
+    return nullptr;
 }
 
+void PrinterMonitor::enable_history(const TimeSeries::Config& config) {
+    lck_t l(mtx_);
+    history_ = std::make_unique<PrinterHistory>(config);
+}
 
-bool PrinterMonitor::parse_temperature() {
-    // pre-check
-    if (current_line_.find("T:") == std::string::npos && current_line_.find("T0:") == std::string::npos) {
-        return false;
+void PrinterMonitor::add_parser(std::string_view prefix, parser_t parser, const line_parser_t* external) {
+    if (prefix.empty()) {
+        return;
     }
+    auto& bucket = parsers_[static_cast<unsigned char>(prefix[0])];
+    const auto pos = std::find_if(bucket.begin(), bucket.end(),
+                                  [&prefix](const ParserEntry& e) { return e.prefix.size() < prefix.size(); });
+    bucket.insert(pos, ParserEntry{ prefix, parser, external });
+}
 
-    const std::string float_regex = "(\\d*.?\\d*) \\/(\\d*.?\\d*)";
+void PrinterMonitor::add_parser(std::string prefix, line_parser_t parser) {
+    if (prefix.empty() || not parser) {
+        return;
+    }
+    lck_t l(mtx_);
+    const auto& entry = external_parsers_.emplace_back(std::move(prefix), std::move(parser));
+    add_parser(std::string_view(entry.first), nullptr, &entry.second);
+}
 
-    const bool has_multi_hotend = current_line_.find("T0:") != std::string::npos;
 
-    // matcher
-    auto match = [&float_regex, this](char prefix_1, char prefix_2, int hotend_num = -1) -> std::optional<temp_t> {
-        std::smatch m;
-        std::string actual, target, power;
+PrinterMonitor::change_t PrinterMonitor::parse_position(std::string_view line) {
+    // X:0.00 Y:0.00 Z:0.00 [I:.. J:.. ...] E:0.00 Count X:0 Y:0 Z:0 [I:.. J:.. ...]
+    static constexpr auto& letters = state_t::axis_letters;
+    std::array<std::optional<float>, state_t::max_axes + 1> pos;
+    std::array<std::optional<std::int32_t>, state_t::max_axes> counts;
+    bool in_counts = false;
 
-        std::stringstream ss1;
-        ss1 << prefix_1;
-        if (hotend_num != -1) {
-            ss1 << hotend_num;
+    while (not line.empty()) {
+        const auto key_end = line.find_first_of(": ");
+        if (key_end == std::string_view::npos) {
+            break;
         }
-        ss1 << ":" << float_regex;
-        std::stringstream ss2;
-        ss2 << prefix_2 << "@";
-        if (hotend_num != -1) {
-            ss2 << hotend_num;
+        const std::string_view key = line.substr(0, key_end);
+        const bool is_field = line[key_end] == ':';
+        line.remove_prefix(key_end + 1);
+        if (not is_field) {
+            // the stepper counts follow "Count"
+            in_counts = in_counts || key == "Count";
+            continue;
         }
-        ss2 << ":(\\d*)";
-        if (std::regex_search(current_line_, m, std::regex(ss1.str())) && m.size() > 2) {
-            actual = m[1];
-            target = m[2];
-            if (std::regex_search(current_line_, m, std::regex(ss2.str())) && m.size() > 1) {
-                power = m[1];
-            } else {
-                power = "0";
+
+        const auto idx = key.size() == 1 ? (key[0] == 'E' ? state_t::max_axes : letters.find(key[0]))
+                                         : std::string_view::npos;
+        if (idx == std::string_view::npos) {
+            // unknown field, skip it
+        } else if (in_counts) {
+            std::int32_t val;
+            if (idx < counts.size() && not counts[idx] && consume_number(line, val)) {
+                counts[idx] = val;
+            }
+        } else if (not pos[idx]) {
+            float val;
+            if (not consume_number(line, val)) {
+                // garbage in a position field, ignore the whole report
+                return PrinterChange::NONE;
             }
+            pos[idx] = val;
         }
-        try {
-            return temp_t{ std::stof(actual), std::stof(target), std::stoi(power) };
-        } catch (...) {
-            return std::nullopt;
+
+        const auto field_end = line.find(' ');
+        line.remove_prefix(field_end == std::string_view::npos ? line.size() : field_end);
+    }
+
+    // every axis of the machine has to be present, E only if reported
+    for (std::size_t i = 0; i < axis_count_; ++i) {
+        if (not pos[i]) {
+            return PrinterChange::NONE;
         }
+    }
+    state_.last_position = std::chrono::steady_clock::now();
+
+    change_t changes = PrinterChange::NONE;
+
+    state_t::position_t position;
+    for (std::size_t i = 0; i < axis_count_; ++i) {
+        position.push_back(*pos[i]);
+    }
+    if (pos[state_t::max_axes]) {
+        position.push_back(*pos[state_t::max_axes]);
+    }
+    if (position != state_.position || state_.axis_count != axis_count_) {
+        state_.position = position;
+        state_.axis_count = static_cast<std::uint8_t>(axis_count_);
+        changes |= PrinterChange::POSITION;
+    }
+
+    bool counts_complete = true;
+    state_t::counts_t stepper_counts;
+    for (std::size_t i = 0; i < axis_count_; ++i) {
+        counts_complete = counts_complete && counts[i].has_value();
+        stepper_counts.push_back(counts[i].value_or(0));
+    }
+    if (counts_complete && stepper_counts != state_.stepper_counts) {
+        state_.stepper_counts = stepper_counts;
+        changes |= PrinterChange::STEPPER_COUNTS;
+    }
+
+    if (history_) {
+        history_->record_position(state_, state_.last_position);
+    }
+
+    return changes;
+}
+
+
+PrinterMonitor::change_t PrinterMonitor::parse_temperature(std::string_view line) {
+    // heaters with a single letter key, in the order of the members they are stored in
+    static constexpr std::string_view heater_keys = "BCPLMR";
+    std::array<std::optional<temp_t>*, heater_keys.size()> heaters = {
+        &state_.bed, &state_.chamber, &state_.probe, &state_.cooler, &state_.board, &state_.redundant,
+    };
+    static constexpr std::array<change_t, heater_keys.size()> heater_changes = {
+        PrinterChange::BED,    PrinterChange::CHAMBER, PrinterChange::PROBE,
+        PrinterChange::COOLER, PrinterChange::BOARD,   PrinterChange::REDUNDANT,
     };
 
-    bool changed = false;
+    // Single hotend machines report "T:" and "@:", multi hotend ones add "T<n>:" and "@<n>:" for every hotend.
+    // Powers are optional and the first occurrence of a key wins.
+    std::optional<temp_t> single_hotend;
+    std::optional<int> single_power;
+    std::array<std::optional<temp_t>, max_hotends> indexed_hotends;
+    std::array<std::optional<int>, max_hotends> indexed_powers;
+    std::array<std::optional<temp_t>, heater_keys.size()> heater_temps;
+    std::array<std::optional<int>, heater_keys.size()> heater_powers;
+
+    while (not line.empty()) {
+        // key is everything up to ':', fields are separated by spaces
+        const auto key_end = line.find_first_of(": ");
+        if (key_end == std::string_view::npos) {
+            break;
+        }
+        if (line[key_end] == ' ') {
+            line.remove_prefix(key_end + 1);
+            continue;
+        }
+        const std::string_view key = line.substr(0, key_end);
+        line.remove_prefix(key_end + 1);
+
+        if (key.size() == 2 && key[1] == '@') {
+            // "B@:" style heater power
+            const auto heater = heater_keys.find(key[0]);
+            int power = 0;
+            if (heater != std::string_view::npos && not heater_powers[heater] && consume_number(line, power)) {
+                heater_powers[heater] = power;
+            }
+        } else if (key.size() >= 1 && key[0] == '@') {
+            // "@:" or "@<n>:" hotend power
+            int power = 0;
+            if (key.size() == 1) {
+                if (not single_power && consume_number(line, power)) {
+                    single_power = power;
+                }
+            } else if (const int idx = parse_index(key.substr(1)); idx >= 0 && idx < static_cast<int>(max_hotends)) {
+                if (not indexed_powers[idx] && consume_number(line, power)) {
+                    indexed_powers[idx] = power;
+                }
+            }
+        } else {
+            // "<key>:actual /target"
+            std::optional<temp_t>* dest = nullptr;
+            if (key == "T") {
+                dest = &single_hotend;
+            } else if (key.size() > 1 && key[0] == 'T') {
+                const int idx = parse_index(key.substr(1));
+                if (idx >= 0 && idx < static_cast<int>(max_hotends)) {
+                    dest = &indexed_hotends[idx];
+                }
+            } else if (key.size() == 1 && heater_keys.find(key[0]) != std::string_view::npos) {
+                dest = &heater_temps[heater_keys.find(key[0])];
+            }
 
-    if (auto res = match('T', ' ')) {
-        // single hotend
-        hotend_temps_.clear();
-        hotend_temps_.push_back(*res);
-        changed = true;
-    } else {
-        // multiple hotends
-        bool need_clear = true;
-        // hotend limit 100
-        for (int i = 0; i < 100; ++i) {
-            if (auto ret = match('T', ' ', i)) {
-                if (need_clear) {
-                    need_clear = false;
-                    hotend_temps_.clear();
+            temp_t temp;
+            if (dest && not dest->has_value() && consume_number(line, temp.actual)) {
+                while (not line.empty() && line[0] == ' ') {
+                    line.remove_prefix(1);
+                }
+                if (not line.empty() && line[0] == '/') {
+                    line.remove_prefix(1);
+                    if (consume_number(line, temp.set)) {
+                        *dest = temp;
+                    }
                 }
-                hotend_temps_.push_back(*ret);
-                changed = true;
             }
         }
+
+        // skip whatever is left of the field
+        const auto field_end = line.find(' ');
+        line.remove_prefix(field_end == std::string_view::npos ? line.size() : field_end);
     }
 
-    auto update = [this, &changed, &match](auto& what, char prefix) {
-        if (auto opt = match(prefix, prefix)) {
-            what = *opt;
-            changed = true;
+    // indexed hotends take precedence, in that case "T:" is a duplicate of the active hotend
+    hotends_t hotends;
+    for (std::size_t i = 0; i < max_hotends; ++i) {
+        if (indexed_hotends[i]) {
+            hotends.resize(i + 1);
         }
-    };
-
-    update(bed_temp_, 'B');
-    update(chamber_temp_, 'C');
-    update(probe_temp_, 'P');
-    update(cooler_temp_, 'L');
-    update(board_temp_, 'M');
-    update(redundant_temp_, 'R');
+    }
+    if (not hotends.empty()) {
+        for (std::size_t i = 0; i < hotends.size(); ++i) {
+            hotends[i] = indexed_hotends[i].value_or(temp_t{});
+            hotends[i].power = indexed_powers[i].value_or(0);
+        }
+    } else if (single_hotend) {
+        hotends.push_back(*single_hotend);
+        hotends[0].power = single_power.value_or(0);
+    }
 
-    if (changed) {
-        last_temperature_ = std::chrono::steady_clock::now();
+    const bool any_reported = not hotends.empty() || std::any_of(heater_temps.begin(), heater_temps.end(),
+                                                                 [](const auto& t) { return t.has_value(); });
+    if (not any_reported) {
+        return PrinterChange::NONE;
     }
+    state_.last_temperature = std::chrono::steady_clock::now();
 
-    return changed;
-}
+    change_t changes = PrinterChange::NONE;
 
+    if (not hotends.empty()) {
+        for (std::size_t i = 0; i < max_hotends; ++i) {
+            const bool was = i < state_.hotends.size();
+            const bool is = i < hotends.size();
+            if (was != is || (is && not same_temp(hotends[i], state_.hotends[i]))) {
+                changes |= PrinterChange::hotend(i);
+            }
+        }
+        state_.hotends = hotends;
+    }
 
-bool PrinterMonitor::parse_capability() {
-    // pre-check
-    const bool check_line = (current_line_.find("FIRMWARE_NAME") == 0) || (current_line_.find("Cap") == 0);
-    if (not check_line) {
-        return false;
+    for (std::size_t i = 0; i < heater_keys.size(); ++i) {
+        if (heater_temps[i]) {
+            heater_temps[i]->power = heater_powers[i].value_or(0);
+            auto& dest = *heaters[i];
+            if (not dest || not same_temp(*dest, *heater_temps[i])) {
+                dest = heater_temps[i];
+                changes |= heater_changes[i];
+            }
+        }
     }
-    if (not capabilities_.has_value()) {
-        capabilities_ = PrinterCapabilities();
+
+    if (history_) {
+        history_->record_temperatures(state_, state_.last_temperature);
     }
 
-    bool parsed = false;
+    return changes;
+}
+
+
+namespace {
+    struct CapabilityKey {
+        std::string_view name;
+        PrinterCapability cap;
+    };
+
+    constexpr std::size_t capability_count = static_cast<std::size_t>(PrinterCapability::COUNT);
+
+    /// capability names indexed by PrinterCapability
+    constexpr std::array<std::string_view, capability_count> capability_names = {
+#define _CAP_NAME(NAME) #NAME,
+        PRINTER_CAPABILITY_FLAGS(_CAP_NAME)
+#undef _CAP_NAME
+    };
 
-    auto match = [this, &parsed](auto& dest, std::string line) -> void {
-        if (parsed) {
-            return;
+    /// capability names sorted for binary search, built at compile time
+    constexpr auto capability_table = [] {
+        std::array<CapabilityKey, capability_count> table{};
+        for (std::size_t i = 0; i < capability_count; ++i) {
+            table[i] = { capability_names[i], static_cast<PrinterCapability>(i) };
         }
-        auto off = current_line_.find(line);
-        if (off != std::string::npos) {
-            auto num_str = current_line_.substr(off + line.size() + 1);
-            try {
-                int res = std::stoi(num_str);
-                dest = res;
-                parsed = true;
-            } catch (...) {
+        // insertion sort, std::sort is not constexpr in C++17
+        for (std::size_t i = 1; i < table.size(); ++i) {
+            for (std::size_t j = i; j > 0 && table[j].name < table[j - 1].name; --j) {
+                const auto tmp = table[j];
+                table[j] = table[j - 1];
+                table[j - 1] = tmp;
             }
         }
+        return table;
+    }();
+}  // namespace
+
+
+std::string_view PrinterCapabilities::name(Cap cap) {
+    const auto idx = static_cast<std::size_t>(cap);
+    return idx < capability_names.size() ? capability_names[idx] : std::string_view();
+}
+
+std::optional<PrinterCapability> PrinterCapabilities::from_name(std::string_view name) {
+    const auto it = std::lower_bound(capability_table.begin(), capability_table.end(), name,
+                                     [](const CapabilityKey& key, std::string_view n) { return key.name < n; });
+    if (it == capability_table.end() || it->name != name) {
+        return std::nullopt;
+    }
+    return it->cap;
+}
+
+
+PrinterMonitor::change_t PrinterMonitor::parse_capability(std::string_view line) {
+    // either "Cap:..." or the "FIRMWARE_NAME:..." line
+    static constexpr std::string_view cap_prefix = "Cap:";
+    const bool is_cap = line.substr(0, cap_prefix.size()) == cap_prefix;
+
+    bool changed = false;
+    // the capabilities are only known once a line was understood
+    const auto allocate = [this, &changed] {
+        if (not capabilities_.has_value()) {
+            capabilities_ = PrinterCapabilities();
+            changed = true;
+        }
     };
 
-    auto extract_str_cap = [this](std::string& dest, const std::string& what, const std::string& next) -> void {
-        auto off = current_line_.find(what);
-        if (off != std::string::npos) {
-            auto val = current_line_.substr(off + what.size() + 1);
-            dest = val.substr(0, val.find(" " + next));
+    if (is_cap) {
+        // Cap:NAME:VALUE
+        line.remove_prefix(cap_prefix.size());
+        const auto colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            return PrinterChange::NONE;
+        }
+        const auto cap = PrinterCapabilities::from_name(line.substr(0, colon));
+        line.remove_prefix(colon + 1);
+        int value = 0;
+        if (not cap || not consume_number(line, value)) {
+            return PrinterChange::NONE;
         }
+        allocate();
+        changed = changed || capabilities_->has(*cap) != (value != 0);
+        capabilities_->set(*cap, value != 0);
+    } else {
+        allocate();
+        // sent once per connection, comparing a copy is fine
+        const auto before = *capabilities_;
+        parse_firmware_info(line);
+        const auto& caps = *capabilities_;
+        changed = changed || before.FIRMWARE_NAME != caps.FIRMWARE_NAME ||
+                  before.SOURCE_CODE_URL != caps.SOURCE_CODE_URL || before.PROTOCOL_VERSION != caps.PROTOCOL_VERSION ||
+                  before.MACHINE_TYPE != caps.MACHINE_TYPE || before.AXIS_COUNT != caps.AXIS_COUNT ||
+                  before.UUID != caps.UUID || before.EXTRUDER_COUNT != caps.EXTRUDER_COUNT;
+    }
+
+    capability_flags_.store(capabilities_->flags.to_ullong(), std::memory_order_release);
+    capabilities_known_.store(true, std::memory_order_release);
+    return changed ? PrinterChange::CAPABILITIES : PrinterChange::NONE;
+}
+
+void PrinterMonitor::parse_firmware_info(std::string_view line) {
+    // values can contain spaces, each one runs until the next known key
+    static constexpr std::array<std::string_view, 7> keys = {
+        "FIRMWARE_NAME", "SOURCE_CODE_URL", "PROTOCOL_VERSION", "MACHINE_TYPE", "EXTRUDER_COUNT", "AXIS_COUNT", "UUID",
     };
+    std::array<std::size_t, keys.size()> starts;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        starts[i] = std::string_view::npos;
+        for (auto off = line.find(keys[i]); off != std::string_view::npos; off = line.find(keys[i], off + 1)) {
+            const auto end = off + keys[i].size();
+            if ((off == 0 || line[off - 1] == ' ') && end < line.size() && line[end] == ':') {
+                starts[i] = off;
+                break;
+            }
+        }
+    }
 
-    extract_str_cap(capabilities_->FIRMWARE_NAME, "FIRMWARE_NAME", "SOURCE_CODE_URL");
-    extract_str_cap(capabilities_->SOURCE_CODE_URL, "SOURCE_CODE_URL", "PROTOCOL_VERSION");
-    extract_str_cap(capabilities_->PROTOCOL_VERSION, "PROTOCOL_VERSION", "MACHINE_TYPE");
-    extract_str_cap(capabilities_->MACHINE_TYPE, "MACHINE_TYPE", "EXTRUDER_COUNT");
-    extract_str_cap(capabilities_->UUID, "UUID", "");
-
-
-#define _FIND_CAP(WHAT) match(capabilities_->WHAT, #WHAT)
-    _FIND_CAP(AXIS_COUNT);
-    // axis count is optional and on the same line as extruder count
-    // if axis count was found, extruder count will be found too
-    parsed = false;
-    _FIND_CAP(EXTRUDER_COUNT);
-    _FIND_CAP(PAREN_COMMENTS);
-    _FIND_CAP(GCODE_QUOTED_STRINGS);
-    _FIND_CAP(SERIAL_XON_XOFF);
-    _FIND_CAP(BINARY_FILE_TRANSFER);
-    _FIND_CAP(EEPROM);
-    _FIND_CAP(VOLUMETRIC);
-    _FIND_CAP(AUTOREPORT_POS);
-    _FIND_CAP(AUTOREPORT_TEMP);
-    _FIND_CAP(PROGRESS);
-    _FIND_CAP(PRINT_JOB);
-    _FIND_CAP(AUTOLEVEL);
-    _FIND_CAP(RUNOUT);
-    _FIND_CAP(Z_PROBE);
-    _FIND_CAP(LEVELING_DATA);
-    _FIND_CAP(BUILD_PERCENT);
-    _FIND_CAP(SOFTWARE_POWER);
-    _FIND_CAP(TOGGLE_LIGHTS);
-    _FIND_CAP(CASE_LIGHT_BRIGHTNESS);
-    _FIND_CAP(SPINDLE);
-    _FIND_CAP(LASER);
-    _FIND_CAP(EMERGENCY_PARSER);
-    _FIND_CAP(HOST_ACTION_COMMANDS);
-    _FIND_CAP(PROMPT_SUPPORT);
-    _FIND_CAP(SDCARD);
-    _FIND_CAP(MULTI_VOLUME);
-    _FIND_CAP(REPEAT);
-    _FIND_CAP(SD_WRITE);
-    _FIND_CAP(AUTOREPORT_SD_STATUS);
-    _FIND_CAP(LONG_FILENAME);
-    _FIND_CAP(LFN_WRITE);
-    _FIND_CAP(CUSTOM_FIRMWARE_UPLOAD);
-    _FIND_CAP(EXTENDED_M20);
-    _FIND_CAP(THERMAL_PROTECTION);
-    _FIND_CAP(MOTION_MODES);
-    _FIND_CAP(ARCS);
-    _FIND_CAP(BABYSTEPPING);
-    _FIND_CAP(CHAMBER_TEMPERATURE);
-    _FIND_CAP(COOLER_TEMPERATURE);
-    _FIND_CAP(MEATPACK);
-    _FIND_CAP(CONFIG_EXPORT);
-
-#undef _FIND_CAP
+    auto value_of = [&](std::size_t i) -> std::optional<std::string_view> {
+        if (starts[i] == std::string_view::npos) {
+            return std::nullopt;
+        }
+        const auto begin = starts[i] + keys[i].size() + 1;
+        auto end = line.size();
+        for (const auto other : starts) {
+            if (other != std::string_view::npos && other > starts[i] && other < end) {
+                end = other;
+            }
+        }
+        auto val = line.substr(begin, end - begin);
+        while (not val.empty() && val.back() == ' ') {
+            val.remove_suffix(1);
+        }
+        return val;
+    };
 
-    return true;
+    auto& caps = *capabilities_;
+    std::array<std::string*, 4> strings = {
+        &caps.FIRMWARE_NAME,
+        &caps.SOURCE_CODE_URL,
+        &caps.PROTOCOL_VERSION,
+        &caps.MACHINE_TYPE,
+    };
+    for (std::size_t i = 0; i < strings.size(); ++i) {
+        if (auto val = value_of(i)) {
+            *strings[i] = *val;
+        }
+    }
+    if (auto val = value_of(4)) {
+        consume_number(*val, caps.EXTRUDER_COUNT);
+    }
+    if (auto val = value_of(5); val && consume_number(*val, caps.AXIS_COUNT)) {
+        axis_count_ = std::clamp<std::size_t>(caps.AXIS_COUNT, 1, state_t::max_axes);
+    }
+    if (auto val = value_of(6)) {
+        caps.UUID = *val;
+    }
+}
+
+PrinterMonitor::change_t PrinterMonitor::ok_parser(std::string_view) {
+    // ok is the most frequent line, it is claimed here so no other parser looks at it
+    return PrinterChange::NONE;
 }
 
-bool PrinterMonitor::ok_parser() {
-    // ok is frequent, skip other parsers if found
-    return current_line_.size() == 3 && current_line_[0] == 'o' && current_line_[1] == 'k' && current_line_[2] == '\n';
+PrinterMonitor::change_t PrinterMonitor::skip_line(std::string_view) {
+    return PrinterChange::NONE;
 }
 
 
 std::string PrinterMonitor::request_from_printer() {
     using namespace std::chrono_literals;
 
-    if (std::chrono::steady_clock::now() - last_request_ < 1s) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_request_ < 1s) {
         return "";
     }
-    last_request_ = std::chrono::steady_clock::now();
+    last_request_ = now;
 
-    if (not capabilities_) {
+    if (not capabilities_known()) {
         return "M115\n";
     }
 
-    if (std::chrono::steady_clock::now() - last_temperature_ > 5s) {
-        if (capabilities_ && capabilities_->AUTOREPORT_TEMP) {
+    // reports that changed nothing are not published, so the timestamps come from state_
+    lck_t l(mtx_);
+    if (now - state_.last_temperature > 5s) {
+        if (has_capability(PrinterCapability::AUTOREPORT_TEMP)) {
             return "M155 S1\n";
         } else {
             return "M105\n";
         }
     }
 
-    if (std::chrono::steady_clock::now() - last_position_ > 10s) {
-        if (capabilities_ && capabilities_->AUTOREPORT_POS) {
+    if (now - state_.last_position > 10s) {
+        if (has_capability(PrinterCapability::AUTOREPORT_POS)) {
             return "M154 S5\n";
         } else {
             return "M114\n";
@@ -0,0 +1,138 @@
+#include "PrinterMonitor/TimeSeries.h"
+
+#include <algorithm>
+
+
+/// @brief Start of the bucket of length @p len that @p time falls into
+template <typename Duration>
+static TimeSeries::time_point bucket_start(TimeSeries::time_point time, Duration len) {
+    const auto since_epoch = time.time_since_epoch();
+    auto start = since_epoch - since_epoch % len;
+    if (since_epoch.count() < 0 && start != since_epoch) {
+        start -= len;
+    }
+    return TimeSeries::time_point(std::chrono::duration_cast<TimeSeries::clock_t::duration>(start));
+}
+
+/// @brief Index of the first element of @p ring whose time is not before @p from
+template <typename T, typename GetTime>
+static std::size_t first_not_before(const RingBuffer<T>& ring, TimeSeries::time_point from, GetTime get_time) {
+    std::size_t lo = 0, hi = ring.size();
+    while (lo < hi) {
+        const std::size_t mid = lo + (hi - lo) / 2;
+        if (get_time(ring[mid]) < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+void TimeSeries::Bucket::add(float min_val, float max_val, double sum_val, std::uint32_t cnt) {
+    if (count == 0) {
+        min = min_val;
+        max = max_val;
+    } else {
+        min = std::min(min, min_val);
+        max = std::max(max, max_val);
+    }
+    sum += sum_val;
+    count += cnt;
+}
+
+TimeSeries::Aggregate TimeSeries::Bucket::to_aggregate() const {
+    return Aggregate{ start, min, max, count ? static_cast<float>(sum / count) : 0.f, count };
+}
+
+
+TimeSeries::TimeSeries(const Config& config)
+  : raw_(config.raw), seconds_(config.seconds), ten_seconds_(config.ten_seconds) {
+}
+
+void TimeSeries::append(time_point time, float value) {
+    using namespace std::chrono_literals;
+
+    raw_.push(Sample{ time, value });
+
+    const auto start = bucket_start(time, 1s);
+    if (open_second_ && open_second_->start != start) {
+        close_second();
+    }
+    if (not open_second_) {
+        open_second_ = Bucket{ start, value, value, 0, 0 };
+    }
+    open_second_->add(value, value, value, 1);
+}
+
+void TimeSeries::close_second() {
+    using namespace std::chrono_literals;
+
+    const auto& sec = *open_second_;
+    seconds_.push(sec.to_aggregate());
+
+    // roll the finished second up into its 10 s bucket
+    const auto start = bucket_start(sec.start, 10s);
+    if (open_ten_seconds_ && open_ten_seconds_->start != start) {
+        ten_seconds_.push(open_ten_seconds_->to_aggregate());
+        open_ten_seconds_.reset();
+    }
+    if (not open_ten_seconds_) {
+        open_ten_seconds_ = Bucket{ start, sec.min, sec.max, 0, 0 };
+    }
+    open_ten_seconds_->add(sec.min, sec.max, sec.sum, sec.count);
+
+    open_second_.reset();
+}
+
+void TimeSeries::clear() {
+    raw_.clear();
+    seconds_.clear();
+    ten_seconds_.clear();
+    open_second_.reset();
+    open_ten_seconds_.reset();
+}
+
+std::vector<TimeSeries::Sample> TimeSeries::raw(time_point from, time_point to) const {
+    std::vector<Sample> ret;
+    auto get_time = [](const Sample& s) { return s.time; };
+    for (auto i = first_not_before(raw_, from, get_time); i < raw_.size() && raw_[i].time < to; ++i) {
+        ret.push_back(raw_[i]);
+    }
+    return ret;
+}
+
+std::vector<TimeSeries::Aggregate> TimeSeries::aggregates(Resolution res, time_point from, time_point to) const {
+    const auto& ring = res == Resolution::SECOND ? seconds_ : ten_seconds_;
+
+    std::vector<Aggregate> ret;
+    auto get_time = [](const Aggregate& a) { return a.start; };
+    for (auto i = first_not_before(ring, from, get_time); i < ring.size() && ring[i].start < to; ++i) {
+        ret.push_back(ring[i]);
+    }
+
+    // the bucket being filled
+    std::optional<Bucket> open = open_second_;
+    if (res == Resolution::TEN_SECONDS) {
+        open = open_ten_seconds_;
+        if (open_second_) {
+            using namespace std::chrono_literals;
+            const auto& sec = *open_second_;
+            if (open && open->start != bucket_start(sec.start, 10s)) {
+                if (open->start >= from && open->start < to) {
+                    ret.push_back(open->to_aggregate());
+                }
+                open.reset();
+            }
+            if (not open) {
+                open = Bucket{ bucket_start(sec.start, 10s), sec.min, sec.max, 0, 0 };
+            }
+            open->add(sec.min, sec.max, sec.sum, sec.count);
+        }
+    }
+    if (open && open->start >= from && open->start < to) {
+        ret.push_back(open->to_aggregate());
+    }
+    return ret;
+}
@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
 #include "PrinterMonitor/PrinterMonitor.h"
+#include <atomic>
+#include <thread>
+
+using Cap = PrinterCapability;
 
 bool operator==(const PrinterMonitor::temp_t& l, const PrinterMonitor::temp_t& r) {
     return l.actual == r.actual && l.set == r.set && l.power == r.power;
@@ -7,7 +11,7 @@ bool operator==(const PrinterMonitor::temp_t& l, const PrinterMonitor::temp_t& r
 
 TEST(PrinterMonitorTest, ParsePosition) {
     PrinterMonitor mon;
-    std::vector<float> res, expected;
+    PrinterMonitor::pos_t res, expected;
 
     mon.parse_line("X:0.00 Y:127.00 Z:145.00 E:0.00 Count X: 0 Y:10160 Z:116000");
     res = mon.get_position();
@@ -33,6 +37,34 @@ TEST(PrinterMonitorTest, ParsePosition) {
     EXPECT_EQ(res, expected);
 }
 
+TEST(PrinterMonitorTest, ParsePositionMultiAxis) {
+    PrinterMonitor mon;
+    mon.parse_line("FIRMWARE_NAME:Marlin 2.1.2 SOURCE_CODE_URL:github.com/MarlinFirmware/Marlin PROTOCOL_VERSION:1.0 "
+                   "MACHINE_TYPE:5 axis EXTRUDER_COUNT:1 AXIS_COUNT:5");
+
+    // I and J missing, the report is incomplete
+    EXPECT_FALSE(mon.parse_line("X:1.00 Y:2.00 Z:3.00 E:4.00 Count X:80 Y:160 Z:1200"));
+
+    EXPECT_TRUE(mon.parse_line("X:1.00 Y:2.00 Z:3.00 I:45.00 J:-90.00 E:4.00 Count X:80 Y:160 Z:1200 I:450 J:-900\n"));
+    const auto state = mon.snapshot();
+    const PrinterMonitor::pos_t expected = { 1, 2, 3, 45, -90, 4 };
+    EXPECT_EQ(expected, state.position);
+    EXPECT_EQ(5, state.axis_count);
+    const PrinterState::counts_t expected_counts = { 80, 160, 1200, 450, -900 };
+    EXPECT_EQ(expected_counts, state.stepper_counts);
+
+    EXPECT_EQ(45.f, state.axis_position('I'));
+    EXPECT_EQ(4.f, state.axis_position('E'));
+    EXPECT_FALSE(state.axis_position('K').has_value());
+}
+
+TEST(PrinterMonitorTest, ParsePositionCounts) {
+    PrinterMonitor mon;
+    mon.parse_line("X:0.00 Y:127.00 Z:145.00 E:0.00 Count X: 0 Y:10160 Z:116000");
+    const PrinterState::counts_t expected = { 0, 10160, 116000 };
+    EXPECT_EQ(expected, mon.snapshot().stepper_counts);
+}
+
 
 struct PrinterMonitorTestTemperature : public ::testing::Test {
 protected:
@@ -120,6 +152,100 @@ TEST_F(PrinterMonitorTestTemperature, TestMultiHotend) {
     EXPECT_EQ(expected, mon.get_hotend_temp(2));
 }
 
+TEST_F(PrinterMonitorTestTemperature, TestMultiHotendWithActive) {
+    // Marlin also reports the active hotend as T: and @:, indexed values take precedence
+    mon.parse_line("ok T:210.00 /210.00 B:60.00 /60.00 T0:210.00 /210.00 T1:25.50 /0.00 @:127 B@:0 @0:64 @1:0\n");
+
+    expected = { 210, 210, 64 };
+    EXPECT_EQ(expected, mon.get_hotend_temp(0));
+    expected = { 25.5, 0, 0 };
+    EXPECT_EQ(expected, mon.get_hotend_temp(1));
+    EXPECT_FALSE(mon.get_hotend_temp(2).has_value());
+    expected = { 60, 60, 0 };
+    EXPECT_EQ(expected, mon.get_bed_temp());
+
+    // back to a single hotend report
+    mon.parse_line(" T:20.00 /0.00 @:0");
+    expected = { 20, 0, 0 };
+    EXPECT_EQ(expected, mon.get_hotend_temp(0));
+    EXPECT_FALSE(mon.get_hotend_temp(1).has_value());
+}
+
+TEST_F(PrinterMonitorTestTemperature, TestDispatch) {
+    // only lines starting with a known prefix reach a parser
+    const auto he_before = mon.get_hotend_temp();
+    EXPECT_FALSE(mon.parse_line("echo: T:10.00 /0.00 @:0\n"));
+    EXPECT_FALSE(mon.parse_line("Error: T:10.00 /0.00 @:0\n"));
+    EXPECT_FALSE(mon.parse_line("ok\n"));
+    EXPECT_EQ(he_before, mon.get_hotend_temp());
+
+    EXPECT_TRUE(mon.parse_line("ok T:10.00 /0.00 @:0\r\n"));
+    expected = { 10, 0, 0 };
+    EXPECT_EQ(expected, mon.get_hotend_temp());
+}
+
+TEST_F(PrinterMonitorTestTemperature, TestAddParser) {
+    std::vector<std::string> seen;
+    mon.add_parser("echo:Probe", [&seen](std::string_view line) {
+        seen.emplace_back(line);
+        return PrinterChange::POSITION;
+    });
+    mon.add_parser("//action:", [&seen](std::string_view line) {
+        seen.emplace_back(line);
+        return PrinterChange::NONE;
+    });
+
+    // the longer prefix takes the line from the built-in "echo:"
+    EXPECT_EQ(PrinterChange::POSITION, mon.parse_line("echo:Probe Offset X0 Y0 Z-1.5\r\n"));
+    EXPECT_EQ(PrinterChange::NONE, mon.parse_line("echo:busy: processing\n"));
+    EXPECT_EQ(PrinterChange::hotend(0), mon.parse_lines("//action:pause\n T:10.00 /0.00 @:0\n"));
+    const std::vector<std::string> expected_lines = { "echo:Probe Offset X0 Y0 Z-1.5", "//action:pause" };
+    EXPECT_EQ(expected_lines, seen);
+}
+
+TEST_F(PrinterMonitorTestTemperature, TestChangeMask) {
+    // same report again, nothing changed
+    EXPECT_EQ(PrinterChange::NONE, mon.parse_line(get_single_extruder_line()));
+
+    EXPECT_EQ(PrinterChange::BED, mon.parse_line(" T:214.32 /220.0 B:46.54 /80.00 @:114 B@:27"));
+    EXPECT_EQ(PrinterChange::hotend(0) | PrinterChange::hotend(1),
+              mon.parse_line(" T0:214.00 /220.0 T1:30.00 /0.00 B:46.54 /80.00 @0:114 @1:0 B@:27"));
+    EXPECT_EQ(PrinterChange::hotend(1), mon.parse_line(" T0:214.00 /220.0 B:46.54 /80.00 @0:114 B@:27"));
+
+    EXPECT_EQ(PrinterChange::POSITION | PrinterChange::STEPPER_COUNTS,
+              mon.parse_line("X:1.00 Y:2.00 Z:3.00 E:4.00 Count X:80 Y:160 Z:1200"));
+    EXPECT_EQ(PrinterChange::STEPPER_COUNTS, mon.parse_line("X:1.00 Y:2.00 Z:3.00 E:4.00 Count X:81 Y:160 Z:1200"));
+
+    // lines not understood leave the capabilities unknown
+    EXPECT_EQ(PrinterChange::NONE, mon.parse_line("Cap:NOT_A_CAPABILITY:1"));
+    EXPECT_EQ(PrinterChange::NONE, mon.parse_line("Cap:EEPROM"));
+    EXPECT_FALSE(mon.capabilities_known());
+    EXPECT_FALSE(mon.get_capabilities().has_value());
+
+    EXPECT_EQ(PrinterChange::CAPABILITIES, mon.parse_line("Cap:EEPROM:1"));
+    EXPECT_TRUE(mon.capabilities_known());
+    EXPECT_EQ(PrinterChange::NONE, mon.parse_line("Cap:EEPROM:1"));
+}
+
+TEST_F(PrinterMonitorTestTemperature, TestParseLines) {
+    const std::string buffer =
+        "ok\n"
+        " T:100.00 /0.00 B:46.54 /80.00 @:0 B@:26\n"
+        "echo:busy: processing\r\n"
+        "\n"
+        "X:1.00 Y:2.00 Z:3.00 E:4.00 Count X:80 Y:160 Z:1200\n"
+        " T:101.00 /0.00 B:46.54 /80.00 @:0 B@:26";
+    EXPECT_EQ(PrinterChange::hotend(0) | PrinterChange::POSITION | PrinterChange::STEPPER_COUNTS,
+              mon.parse_lines(buffer));
+    expected = { 101, 0, 0 };
+    EXPECT_EQ(expected, mon.get_hotend_temp());
+    EXPECT_EQ(2.f, mon.snapshot().axis_position('Y'));
+
+    const std::array<std::string_view, 2> lines = { "ok", " T:102.00 /0.00 B:46.54 /80.00 @:0 B@:26\n" };
+    EXPECT_EQ(PrinterChange::hotend(0), mon.parse_lines(lines.data(), lines.size()));
+    EXPECT_EQ(PrinterChange::NONE, mon.parse_lines(lines.data(), 1));
+}
+
 TEST_F(PrinterMonitorTestTemperature, TestRemembersValues) {
     const auto bed_before = mon.get_bed_temp();
     const auto he_before = mon.get_hotend_temp();
@@ -130,6 +256,39 @@ TEST_F(PrinterMonitorTestTemperature, TestRemembersValues) {
     EXPECT_EQ(he_before, mon.get_hotend_temp());
 }
 
+TEST(PrinterMonitorTest, TestSnapshotConsistent) {
+    // every report has matching hotend and bed values, a reader must never see a mix of two reports
+    PrinterMonitor mon;
+    std::atomic<bool> done{ false };
+    std::thread writer([&mon, &done]() {
+        const std::array<std::string, 2> lines = {
+            " T0:100.00 /100.00 T1:100.00 /100.00 B:100.00 /100.00 @0:1 @1:1 B@:1",
+            " T0:200.00 /200.00 T1:200.00 /200.00 B:200.00 /200.00 @0:2 @1:2 B@:2",
+        };
+        for (int i = 0; i < 20000; ++i) {
+            mon.parse_line(lines[i % 2]);
+        }
+        done = true;
+    });
+
+    int checked = 0;
+    while (not done || checked == 0) {
+        const auto state = mon.snapshot();
+        if (state.hotends.size() == 0) {
+            continue;
+        }
+        ASSERT_EQ(2u, state.hotends.size());
+        ASSERT_TRUE(state.bed.has_value());
+        const float val = state.bed->actual;
+        EXPECT_EQ(val, state.bed->set);
+        EXPECT_EQ(val, state.hotends[0].actual);
+        EXPECT_EQ(val, state.hotends[1].set);
+        EXPECT_EQ(val / 100, state.hotends[1].power);
+        ++checked;
+    }
+    writer.join();
+}
+
 TEST(PrinterMonitorTest, TestCapabilitiesDefaults) {
     PrinterMonitor mon;
     EXPECT_FALSE(mon.get_capabilities().has_value());
@@ -143,46 +302,46 @@ TEST(PrinterMonitorTest, TestCapabilitiesDefaults) {
     EXPECT_EQ(std::string(), caps.UUID);
     EXPECT_EQ(3, caps.AXIS_COUNT);
     EXPECT_EQ(0, caps.EXTRUDER_COUNT);
-    EXPECT_FALSE(caps.PAREN_COMMENTS);
-    EXPECT_FALSE(caps.GCODE_QUOTED_STRINGS);
-    EXPECT_FALSE(caps.SERIAL_XON_XOFF);
-    EXPECT_FALSE(caps.BINARY_FILE_TRANSFER);
-    EXPECT_FALSE(caps.EEPROM);
-    EXPECT_FALSE(caps.VOLUMETRIC);
-    EXPECT_FALSE(caps.AUTOREPORT_POS);
-    EXPECT_FALSE(caps.AUTOREPORT_TEMP);
-    EXPECT_FALSE(caps.PROGRESS);
-    EXPECT_FALSE(caps.PRINT_JOB);
-    EXPECT_FALSE(caps.AUTOLEVEL);
-    EXPECT_FALSE(caps.RUNOUT);
-    EXPECT_FALSE(caps.Z_PROBE);
-    EXPECT_FALSE(caps.LEVELING_DATA);
-    EXPECT_FALSE(caps.BUILD_PERCENT);
-    EXPECT_FALSE(caps.SOFTWARE_POWER);
-    EXPECT_FALSE(caps.TOGGLE_LIGHTS);
-    EXPECT_FALSE(caps.CASE_LIGHT_BRIGHTNESS);
-    EXPECT_FALSE(caps.SPINDLE);
-    EXPECT_FALSE(caps.LASER);
-    EXPECT_FALSE(caps.EMERGENCY_PARSER);
-    EXPECT_FALSE(caps.HOST_ACTION_COMMANDS);
-    EXPECT_FALSE(caps.PROMPT_SUPPORT);
-    EXPECT_FALSE(caps.SDCARD);
-    EXPECT_FALSE(caps.MULTI_VOLUME);
-    EXPECT_FALSE(caps.REPEAT);
-    EXPECT_FALSE(caps.SD_WRITE);
-    EXPECT_FALSE(caps.AUTOREPORT_SD_STATUS);
-    EXPECT_FALSE(caps.LONG_FILENAME);
-    EXPECT_FALSE(caps.LFN_WRITE);
-    EXPECT_FALSE(caps.CUSTOM_FIRMWARE_UPLOAD);
-    EXPECT_FALSE(caps.EXTENDED_M20);
-    EXPECT_FALSE(caps.THERMAL_PROTECTION);
-    EXPECT_FALSE(caps.MOTION_MODES);
-    EXPECT_FALSE(caps.ARCS);
-    EXPECT_FALSE(caps.BABYSTEPPING);
-    EXPECT_FALSE(caps.CHAMBER_TEMPERATURE);
-    EXPECT_FALSE(caps.COOLER_TEMPERATURE);
-    EXPECT_FALSE(caps.MEATPACK);
-    EXPECT_FALSE(caps.CONFIG_EXPORT);
+    EXPECT_FALSE(caps.has(Cap::PAREN_COMMENTS));
+    EXPECT_FALSE(caps.has(Cap::GCODE_QUOTED_STRINGS));
+    EXPECT_FALSE(caps.has(Cap::SERIAL_XON_XOFF));
+    EXPECT_FALSE(caps.has(Cap::BINARY_FILE_TRANSFER));
+    EXPECT_FALSE(caps.has(Cap::EEPROM));
+    EXPECT_FALSE(caps.has(Cap::VOLUMETRIC));
+    EXPECT_FALSE(caps.has(Cap::AUTOREPORT_POS));
+    EXPECT_FALSE(caps.has(Cap::AUTOREPORT_TEMP));
+    EXPECT_FALSE(caps.has(Cap::PROGRESS));
+    EXPECT_FALSE(caps.has(Cap::PRINT_JOB));
+    EXPECT_FALSE(caps.has(Cap::AUTOLEVEL));
+    EXPECT_FALSE(caps.has(Cap::RUNOUT));
+    EXPECT_FALSE(caps.has(Cap::Z_PROBE));
+    EXPECT_FALSE(caps.has(Cap::LEVELING_DATA));
+    EXPECT_FALSE(caps.has(Cap::BUILD_PERCENT));
+    EXPECT_FALSE(caps.has(Cap::SOFTWARE_POWER));
+    EXPECT_FALSE(caps.has(Cap::TOGGLE_LIGHTS));
+    EXPECT_FALSE(caps.has(Cap::CASE_LIGHT_BRIGHTNESS));
+    EXPECT_FALSE(caps.has(Cap::SPINDLE));
+    EXPECT_FALSE(caps.has(Cap::LASER));
+    EXPECT_FALSE(caps.has(Cap::EMERGENCY_PARSER));
+    EXPECT_FALSE(caps.has(Cap::HOST_ACTION_COMMANDS));
+    EXPECT_FALSE(caps.has(Cap::PROMPT_SUPPORT));
+    EXPECT_FALSE(caps.has(Cap::SDCARD));
+    EXPECT_FALSE(caps.has(Cap::MULTI_VOLUME));
+    EXPECT_FALSE(caps.has(Cap::REPEAT));
+    EXPECT_FALSE(caps.has(Cap::SD_WRITE));
+    EXPECT_FALSE(caps.has(Cap::AUTOREPORT_SD_STATUS));
+    EXPECT_FALSE(caps.has(Cap::LONG_FILENAME));
+    EXPECT_FALSE(caps.has(Cap::LFN_WRITE));
+    EXPECT_FALSE(caps.has(Cap::CUSTOM_FIRMWARE_UPLOAD));
+    EXPECT_FALSE(caps.has(Cap::EXTENDED_M20));
+    EXPECT_FALSE(caps.has(Cap::THERMAL_PROTECTION));
+    EXPECT_FALSE(caps.has(Cap::MOTION_MODES));
+    EXPECT_FALSE(caps.has(Cap::ARCS));
+    EXPECT_FALSE(caps.has(Cap::BABYSTEPPING));
+    EXPECT_FALSE(caps.has(Cap::CHAMBER_TEMPERATURE));
+    EXPECT_FALSE(caps.has(Cap::COOLER_TEMPERATURE));
+    EXPECT_FALSE(caps.has(Cap::MEATPACK));
+    EXPECT_FALSE(caps.has(Cap::CONFIG_EXPORT));
 }
 
 
@@ -250,44 +409,65 @@ TEST(PrinterMonitorTest, TestAllCapabilities) {
     EXPECT_EQ(std::string("cede2a2f-41a2-4748-9b12-c55c62f367ff"), caps.UUID);
     EXPECT_EQ(5, caps.AXIS_COUNT);
     EXPECT_EQ(1, caps.EXTRUDER_COUNT);
-    EXPECT_TRUE(caps.PAREN_COMMENTS);
-    EXPECT_TRUE(caps.GCODE_QUOTED_STRINGS);
-    EXPECT_TRUE(caps.SERIAL_XON_XOFF);
-    EXPECT_TRUE(caps.BINARY_FILE_TRANSFER);
-    EXPECT_TRUE(caps.EEPROM);
-    EXPECT_TRUE(caps.VOLUMETRIC);
-    EXPECT_TRUE(caps.AUTOREPORT_POS);
-    EXPECT_TRUE(caps.AUTOREPORT_TEMP);
-    EXPECT_TRUE(caps.PROGRESS);
-    EXPECT_TRUE(caps.PRINT_JOB);
-    EXPECT_TRUE(caps.AUTOLEVEL);
-    EXPECT_TRUE(caps.RUNOUT);
-    EXPECT_TRUE(caps.Z_PROBE);
-    EXPECT_TRUE(caps.LEVELING_DATA);
-    EXPECT_TRUE(caps.BUILD_PERCENT);
-    EXPECT_TRUE(caps.SOFTWARE_POWER);
-    EXPECT_TRUE(caps.TOGGLE_LIGHTS);
-    EXPECT_TRUE(caps.CASE_LIGHT_BRIGHTNESS);
-    EXPECT_TRUE(caps.SPINDLE);
-    EXPECT_TRUE(caps.LASER);
-    EXPECT_TRUE(caps.EMERGENCY_PARSER);
-    EXPECT_TRUE(caps.HOST_ACTION_COMMANDS);
-    EXPECT_TRUE(caps.PROMPT_SUPPORT);
-    EXPECT_TRUE(caps.SDCARD);
-    EXPECT_TRUE(caps.MULTI_VOLUME);
-    EXPECT_TRUE(caps.REPEAT);
-    EXPECT_TRUE(caps.SD_WRITE);
-    EXPECT_TRUE(caps.AUTOREPORT_SD_STATUS);
-    EXPECT_TRUE(caps.LONG_FILENAME);
-    EXPECT_TRUE(caps.LFN_WRITE);
-    EXPECT_TRUE(caps.CUSTOM_FIRMWARE_UPLOAD);
-    EXPECT_TRUE(caps.EXTENDED_M20);
-    EXPECT_TRUE(caps.THERMAL_PROTECTION);
-    EXPECT_TRUE(caps.MOTION_MODES);
-    EXPECT_TRUE(caps.ARCS);
-    EXPECT_TRUE(caps.BABYSTEPPING);
-    EXPECT_TRUE(caps.CHAMBER_TEMPERATURE);
-    EXPECT_TRUE(caps.COOLER_TEMPERATURE);
-    EXPECT_TRUE(caps.MEATPACK);
-    EXPECT_TRUE(caps.CONFIG_EXPORT);
+    EXPECT_TRUE(caps.has(Cap::PAREN_COMMENTS));
+    EXPECT_TRUE(caps.has(Cap::GCODE_QUOTED_STRINGS));
+    EXPECT_TRUE(caps.has(Cap::SERIAL_XON_XOFF));
+    EXPECT_TRUE(caps.has(Cap::BINARY_FILE_TRANSFER));
+    EXPECT_TRUE(caps.has(Cap::EEPROM));
+    EXPECT_TRUE(caps.has(Cap::VOLUMETRIC));
+    EXPECT_TRUE(caps.has(Cap::AUTOREPORT_POS));
+    EXPECT_TRUE(caps.has(Cap::AUTOREPORT_TEMP));
+    EXPECT_TRUE(caps.has(Cap::PROGRESS));
+    EXPECT_TRUE(caps.has(Cap::PRINT_JOB));
+    EXPECT_TRUE(caps.has(Cap::AUTOLEVEL));
+    EXPECT_TRUE(caps.has(Cap::RUNOUT));
+    EXPECT_TRUE(caps.has(Cap::Z_PROBE));
+    EXPECT_TRUE(caps.has(Cap::LEVELING_DATA));
+    EXPECT_TRUE(caps.has(Cap::BUILD_PERCENT));
+    EXPECT_TRUE(caps.has(Cap::SOFTWARE_POWER));
+    EXPECT_TRUE(caps.has(Cap::TOGGLE_LIGHTS));
+    EXPECT_TRUE(caps.has(Cap::CASE_LIGHT_BRIGHTNESS));
+    EXPECT_TRUE(caps.has(Cap::SPINDLE));
+    EXPECT_TRUE(caps.has(Cap::LASER));
+    EXPECT_TRUE(caps.has(Cap::EMERGENCY_PARSER));
+    EXPECT_TRUE(caps.has(Cap::HOST_ACTION_COMMANDS));
+    EXPECT_TRUE(caps.has(Cap::PROMPT_SUPPORT));
+    EXPECT_TRUE(caps.has(Cap::SDCARD));
+    EXPECT_TRUE(caps.has(Cap::MULTI_VOLUME));
+    EXPECT_TRUE(caps.has(Cap::REPEAT));
+    EXPECT_TRUE(caps.has(Cap::SD_WRITE));
+    EXPECT_TRUE(caps.has(Cap::AUTOREPORT_SD_STATUS));
+    EXPECT_TRUE(caps.has(Cap::LONG_FILENAME));
+    EXPECT_TRUE(caps.has(Cap::LFN_WRITE));
+    EXPECT_TRUE(caps.has(Cap::CUSTOM_FIRMWARE_UPLOAD));
+    EXPECT_TRUE(caps.has(Cap::EXTENDED_M20));
+    EXPECT_TRUE(caps.has(Cap::THERMAL_PROTECTION));
+    EXPECT_TRUE(caps.has(Cap::MOTION_MODES));
+    EXPECT_TRUE(caps.has(Cap::ARCS));
+    EXPECT_TRUE(caps.has(Cap::BABYSTEPPING));
+    EXPECT_TRUE(caps.has(Cap::CHAMBER_TEMPERATURE));
+    EXPECT_TRUE(caps.has(Cap::COOLER_TEMPERATURE));
+    EXPECT_TRUE(caps.has(Cap::MEATPACK));
+    EXPECT_TRUE(caps.has(Cap::CONFIG_EXPORT));
+}
+
+TEST(PrinterMonitorTest, TestCapabilityFlags) {
+    PrinterMonitor mon;
+    EXPECT_FALSE(mon.capabilities_known());
+    EXPECT_FALSE(mon.has_capability(Cap::EEPROM));
+
+    mon.parse_line("Cap:EEPROM:1\n");
+    mon.parse_line("Cap:AUTOREPORT_TEMP:0\n");
+    mon.parse_line("Cap:SOME_FUTURE_CAP:1\n");
+    EXPECT_TRUE(mon.capabilities_known());
+    EXPECT_TRUE(mon.has_capability(Cap::EEPROM));
+    EXPECT_FALSE(mon.has_capability(Cap::AUTOREPORT_TEMP));
+
+    EXPECT_EQ(std::string_view("BABYSTEPPING"), PrinterCapabilities::name(Cap::BABYSTEPPING));
+    EXPECT_EQ(Cap::BABYSTEPPING, PrinterCapabilities::from_name("BABYSTEPPING"));
+    EXPECT_FALSE(PrinterCapabilities::from_name("BABYSTEP").has_value());
+
+    mon.reset();
+    EXPECT_FALSE(mon.capabilities_known());
+    EXPECT_FALSE(mon.has_capability(Cap::EEPROM));
 }
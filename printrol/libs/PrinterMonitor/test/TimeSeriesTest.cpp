@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include "PrinterMonitor/TimeSeries.h"
+#include "PrinterMonitor/PrinterMonitor.h"
+
+using namespace std::chrono_literals;
+
+
+struct TimeSeriesTest : public ::testing::Test {
+protected:
+    TimeSeries::Config config{ 10, 10, 10 };
+    // aligned to a 10 s boundary so bucket edges are predictable
+    const TimeSeries::time_point t0 = TimeSeries::time_point(1000s);
+    const TimeSeries::time_point end = TimeSeries::time_point::max();
+};
+
+TEST_F(TimeSeriesTest, TestRawDropsOldest) {
+    TimeSeries series(config);
+    for (int i = 0; i < 15; ++i) {
+        series.append(t0 + i * 100ms, static_cast<float>(i));
+    }
+
+    const auto raw = series.raw(t0, end);
+    ASSERT_EQ(10u, raw.size());
+    EXPECT_EQ(5.f, raw.front().value);
+    EXPECT_EQ(14.f, raw.back().value);
+
+    const auto range = series.raw(t0 + 700ms, t0 + 900ms);
+    ASSERT_EQ(2u, range.size());
+    EXPECT_EQ(7.f, range[0].value);
+    EXPECT_EQ(8.f, range[1].value);
+}
+
+TEST_F(TimeSeriesTest, TestSecondAggregates) {
+    TimeSeries series(config);
+    // two samples per second, values 0, 1, 2, ...
+    for (int i = 0; i < 6; ++i) {
+        series.append(t0 + i * 500ms, static_cast<float>(i));
+    }
+
+    const auto secs = series.aggregates(TimeSeries::Resolution::SECOND, t0, end);
+    ASSERT_EQ(3u, secs.size());
+    EXPECT_EQ(t0 + 1s, secs[1].start);
+    EXPECT_EQ(2.f, secs[1].min);
+    EXPECT_EQ(3.f, secs[1].max);
+    EXPECT_EQ(2.5f, secs[1].avg);
+    EXPECT_EQ(2u, secs[1].count);
+    // still open
+    EXPECT_EQ(4.5f, secs[2].avg);
+
+    const auto tens = series.aggregates(TimeSeries::Resolution::TEN_SECONDS, t0, end);
+    ASSERT_EQ(1u, tens.size());
+    EXPECT_EQ(0.f, tens[0].min);
+    EXPECT_EQ(5.f, tens[0].max);
+    EXPECT_EQ(2.5f, tens[0].avg);
+    EXPECT_EQ(6u, tens[0].count);
+}
+
+TEST_F(TimeSeriesTest, TestLongRunConstantSize) {
+    TimeSeries series(config);
+    // one sample per second for 10 minutes, only the last 10 of each resolution are kept
+    for (int i = 0; i < 600; ++i) {
+        series.append(t0 + i * 1s, static_cast<float>(i % 10));
+    }
+
+    EXPECT_EQ(10u, series.raw(t0, end).size());
+    EXPECT_EQ(11u, series.aggregates(TimeSeries::Resolution::SECOND, t0, end).size());
+
+    const auto tens = series.aggregates(TimeSeries::Resolution::TEN_SECONDS, t0, end);
+    ASSERT_EQ(11u, tens.size());
+    EXPECT_EQ(0.f, tens[0].min);
+    EXPECT_EQ(9.f, tens[0].max);
+    EXPECT_EQ(4.5f, tens[0].avg);
+    EXPECT_EQ(t0 + 590s, tens.back().start);
+}
+
+TEST(PrinterHistoryTest, TestRecordsReports) {
+    PrinterMonitor mon;
+    EXPECT_EQ(nullptr, mon.history());
+    mon.enable_history();
+
+    mon.parse_line(" T:200.00 /200.00 B:60.00 /60.00 @:100 B@:10");
+    mon.parse_line(" T:200.00 /200.00 B:60.00 /60.00 @:100 B@:10");
+    mon.parse_line("X:1.00 Y:2.00 Z:3.00 E:4.00 Count X:80 Y:160 Z:1200");
+
+    const auto* history = mon.history();
+    ASSERT_NE(nullptr, history);
+    const auto from = TimeSeries::time_point::min(), to = TimeSeries::time_point::max();
+
+    // unchanged reports are recorded too
+    EXPECT_EQ(2u, history->raw(HistoryChannel::hotend(0), from, to).size());
+    EXPECT_EQ(2u, history->raw(HistoryChannel{ HistoryChannel::BED }, from, to).size());
+    EXPECT_EQ(0u, history->raw(HistoryChannel{ HistoryChannel::CHAMBER }, from, to).size());
+    EXPECT_EQ(0u, history->raw(HistoryChannel::hotend(1), from, to).size());
+
+    const auto e = history->raw(HistoryChannel::axis('E'), from, to);
+    ASSERT_EQ(1u, e.size());
+    EXPECT_EQ(4.f, e[0].value);
+    const auto z = history->aggregates(HistoryChannel::axis('Z'), TimeSeries::Resolution::SECOND, from, to);
+    ASSERT_EQ(1u, z.size());
+    EXPECT_EQ(3.f, z[0].avg);
+
+    mon.reset();
+    EXPECT_EQ(0u, history->raw(HistoryChannel::hotend(0), from, to).size());
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+
+/// @brief Receive buffer the serial port reads into directly, framing lines in place
+/// @details Bytes are written at the tail through write_area()/commit(). next_line() hands out complete lines as views
+/// into the buffer, which stay valid until release(). Data is only moved in release(), and then only the incomplete line
+/// at the tail, so a line is never copied on its way from the port to the parsers.
+class RxBuffer {
+public:
+    explicit RxBuffer(std::size_t capacity = 16 * 1024);
+
+    RxBuffer(const RxBuffer&) = delete;
+    RxBuffer& operator=(const RxBuffer&) = delete;
+
+    /// @brief Start of the free space at the tail, write at most write_space() bytes there and then commit()
+    char* write_area() {
+        return data_.data() + write_;
+    }
+    std::size_t write_space() const {
+        return data_.size() - write_;
+    }
+    /// @brief Mark @p count bytes of write_area() as received
+    void commit(std::size_t count);
+
+    /// @brief Get the next complete line
+    /// @param line Set to the line including its '\n', valid until release()
+    /// @return false if no complete line is buffered
+    bool next_line(std::string_view& line);
+
+    /// @brief Drop all lines returned by next_line(), invalidating their views
+    void release();
+
+    /// @brief Drop everything, including the incomplete line
+    void clear();
+
+    /// @brief Bytes received but not yet returned by next_line()
+    std::size_t pending() const {
+        return write_ - line_end_;
+    }
+    std::size_t capacity() const {
+        return data_.size();
+    }
+    /// @brief Number of bytes dropped because a line did not fit into the buffer
+    std::size_t overflow() const {
+        return overflow_;
+    }
+
+    /// @brief Position of the first '\n' in [begin, end), or end if there is none
+    static const char* find_newline(const char* begin, const char* end);
+
+private:
+    /// @brief Move the data after read_ to the front, invalidating the views
+    void compact();
+
+    std::vector<char> data_;
+    /// start of data not yet released
+    std::size_t read_{ 0 };
+    /// end of the last line returned by next_line()
+    std::size_t line_end_{ 0 };
+    /// data before this has been scanned and contains no newline after line_end_
+    std::size_t scanned_{ 0 };
+    /// end of received data
+    std::size_t write_{ 0 };
+    std::size_t overflow_{ 0 };
+};
@@ -0,0 +1,122 @@
+#include "RxBuffer/RxBuffer.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#define RXBUFFER_SIMD
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RXBUFFER_SIMD
+#define RXBUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+
+#ifdef RXBUFFER_SIMD
+/// @brief Index of the lowest set bit, @p mask must not be 0
+static unsigned lowest_bit(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return idx;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+
+const char* RxBuffer::find_newline(const char* begin, const char* end) {
+#if defined(__AVX2__)
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; end - begin >= 32; begin += 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl)));
+        if (mask) {
+            return begin + lowest_bit(mask);
+        }
+    }
+#elif defined(RXBUFFER_SSE2)
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; end - begin >= 16; begin += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl)));
+        if (mask) {
+            return begin + lowest_bit(mask);
+        }
+    }
+#endif
+    // tail, or everything without SIMD
+    for (; begin != end; ++begin) {
+        if (*begin == '\n') {
+            return begin;
+        }
+    }
+    return end;
+}
+
+
+RxBuffer::RxBuffer(std::size_t capacity) : data_(capacity) {
+}
+
+void RxBuffer::commit(std::size_t count) {
+    if (count > write_space()) {
+        count = write_space();
+    }
+    write_ += count;
+}
+
+bool RxBuffer::next_line(std::string_view& line) {
+    const char* base = data_.data();
+    const char* nl = find_newline(base + scanned_, base + write_);
+    if (nl == base + write_) {
+        scanned_ = write_;
+        if (write_ == data_.size()) {
+            if (line_end_ == 0) {
+                // the line does not fit, drop what we have so the port does not stall
+                overflow_ += write_;
+                clear();
+            } else if (read_ == line_end_) {
+                // released lines are still in front of the incomplete one, no view points into the buffer
+                compact();
+            }
+            // otherwise release() makes room
+        }
+        return false;
+    }
+
+    const std::size_t end = nl - base + 1;
+    line = std::string_view(base + line_end_, end - line_end_);
+    line_end_ = end;
+    scanned_ = end;
+    return true;
+}
+
+void RxBuffer::release() {
+    read_ = line_end_;
+    if (read_ == write_) {
+        // common case, the burst ended with a complete line
+        clear();
+        return;
+    }
+    if (write_space() < data_.size() / 4) {
+        compact();
+    }
+}
+
+void RxBuffer::compact() {
+    // move the incomplete line to the front to make room
+    const std::size_t len = write_ - read_;
+    std::memmove(data_.data(), data_.data() + read_, len);
+    scanned_ -= read_;
+    read_ = line_end_ = 0;
+    write_ = len;
+}
+
+void RxBuffer::clear() {
+    read_ = line_end_ = scanned_ = write_ = 0;
+}
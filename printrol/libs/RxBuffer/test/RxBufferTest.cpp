@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include "RxBuffer/RxBuffer.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+static void receive(RxBuffer& buf, std::string_view data) {
+    ASSERT_LE(data.size(), buf.write_space());
+    std::memcpy(buf.write_area(), data.data(), data.size());
+    buf.commit(data.size());
+}
+
+static std::vector<std::string> lines(RxBuffer& buf) {
+    std::vector<std::string> ret;
+    std::string_view line;
+    while (buf.next_line(line)) {
+        ret.emplace_back(line);
+    }
+    return ret;
+}
+
+
+TEST(RxBufferTest, TestFindNewline) {
+    // cover the vector loops, the scalar tail and every position in between
+    for (std::size_t len = 0; len < 100; ++len) {
+        for (std::size_t pos = 0; pos <= len; ++pos) {
+            std::string s(len, 'a');
+            if (pos < len) {
+                s[pos] = '\n';
+            }
+            const char* begin = s.data();
+            EXPECT_EQ(begin + pos, RxBuffer::find_newline(begin, begin + len)) << len << " " << pos;
+        }
+    }
+}
+
+TEST(RxBufferTest, TestFraming) {
+    RxBuffer buf(64);
+    receive(buf, "ok\nT:20");
+    EXPECT_EQ(std::vector<std::string>{ "ok\n" }, lines(buf));
+    EXPECT_EQ(4u, buf.pending());
+
+    receive(buf, ".00\nok\n");
+    EXPECT_EQ((std::vector<std::string>{ "T:20.00\n", "ok\n" }), lines(buf));
+    EXPECT_EQ(0u, buf.pending());
+}
+
+TEST(RxBufferTest, TestViewsPointIntoBuffer) {
+    RxBuffer buf(64);
+    const char* area = buf.write_area();
+    receive(buf, "ok\nok\n");
+
+    std::string_view first, second;
+    ASSERT_TRUE(buf.next_line(first));
+    ASSERT_TRUE(buf.next_line(second));
+    EXPECT_EQ(area, first.data());
+    EXPECT_EQ(area + 3, second.data());
+
+    buf.release();
+    EXPECT_EQ(64u, buf.write_space());
+}
+
+TEST(RxBufferTest, TestReleaseKeepsPartialLine) {
+    RxBuffer buf(16);
+    receive(buf, "0123456789\nabc");
+    EXPECT_EQ(1u, lines(buf).size());
+    buf.release();
+    // the partial line moved to the front
+    EXPECT_EQ(13u, buf.write_space());
+
+    receive(buf, "def\n");
+    EXPECT_EQ(std::vector<std::string>{ "abcdef\n" }, lines(buf));
+}
+
+TEST(RxBufferTest, TestOverflow) {
+    RxBuffer buf(8);
+    receive(buf, "01234567");
+    EXPECT_TRUE(lines(buf).empty());
+    EXPECT_EQ(8u, buf.overflow());
+
+    receive(buf, "ok\n");
+    EXPECT_EQ(std::vector<std::string>{ "ok\n" }, lines(buf));
+}
+
+TEST(RxBufferTest, TestFullAfterRelease) {
+    RxBuffer buf(16);
+    receive(buf, "abc\ndefgh");
+    EXPECT_EQ(std::vector<std::string>{ "abc\n" }, lines(buf));
+    // enough space left, the partial line stays where it is
+    buf.release();
+    EXPECT_EQ(7u, buf.write_space());
+
+    // a full buffer without a newline makes room instead of stalling the port
+    receive(buf, "ijklmno");
+    EXPECT_TRUE(lines(buf).empty());
+    EXPECT_EQ(4u, buf.write_space());
+    EXPECT_EQ(0u, buf.overflow());
+
+    receive(buf, "p\n");
+    EXPECT_EQ(std::vector<std::string>{ "defghijklmnop\n" }, lines(buf));
+
+    // a line longer than the buffer is dropped
+    buf.release();
+    receive(buf, "0123456789abcdef");
+    EXPECT_TRUE(lines(buf).empty());
+    EXPECT_EQ(16u, buf.overflow());
+    EXPECT_EQ(16u, buf.write_space());
+}
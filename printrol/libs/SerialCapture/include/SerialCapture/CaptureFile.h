@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+/// @brief Capture file format
+/// @details An 8 byte magic, then one record per chunk of bytes:
+/// varint((time since the previous record in ns) << 1 | direction), varint(size), the bytes.
+/// Varints are LEB128, 7 bits per byte with the high bit set on all but the last byte. A record usually costs 3-5 bytes.
+namespace capture {
+
+static constexpr std::string_view magic{ "PRCAP\0\0\1", 8 };
+
+enum class Direction : std::uint8_t {
+    /// printer to host
+    RX = 0,
+    /// host to printer
+    TX = 1,
+};
+
+struct Record {
+    /// since the start of the capture
+    std::chrono::nanoseconds time;
+    Direction direction;
+    std::string data;
+};
+
+}  // namespace capture
+
+
+/// @brief Appends capture records to a file from a background thread
+/// @details record() only copies the bytes into a buffer, the file is written by the writer thread every flush_interval
+/// or once flush_size bytes are buffered. Safe to call from several threads.
+class CaptureWriter {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    static constexpr auto flush_interval = std::chrono::milliseconds(100);
+    static constexpr std::size_t flush_size = 64 * 1024;
+
+    explicit CaptureWriter(const std::string& path);
+    /// @brief Writes what is still buffered
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    bool is_open() const {
+        return open_;
+    }
+
+    void record(capture::Direction direction, std::string_view data, clock_t::time_point time = clock_t::now());
+
+private:
+    void run();
+
+    std::ofstream file_;
+    bool open_{ false };
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::string buffer_;
+    clock_t::time_point start_, last_;
+    bool stop_{ false };
+    std::thread thread_;
+};
+
+
+/// @brief Reads a whole capture file
+/// @return The records, empty if the file is missing or not a capture. A truncated last record is dropped.
+std::vector<capture::Record> read_capture(const std::string& path);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <ISerial/ISerial.h>
+#include "SerialCapture/CaptureFile.h"
+
+
+/// @brief Passes everything through to another ISerial and records the bytes read and written
+class CaptureSerial final : public ISerial {
+public:
+    /// @param inner The port doing the I/O, must outlive this
+    CaptureSerial(ISerial& inner, const std::string& capture_path);
+
+    /// @brief Whether the capture file could be created
+    bool is_capturing() const {
+        return writer_.is_open();
+    }
+
+    void open(std::wstring port, int baud) override;
+
+    int write(const void* buff, int size) override;
+    int write_gather(const std::string_view* buffs, int count) override;
+    int read(void* dest, int size) override;
+    bool wait_readable(int timeout_ms) override;
+    void wake() override;
+    int bytes_available() const override;
+    int read_some(void* dest, int capacity, int timeout_ms) override;
+    native_handle_t native_handle() const override;
+
+    void flush() override;
+
+    bool is_open() const override;
+
+    void close() override;
+
+    std::vector<std::wstring> list_ports() const override;
+    std::vector<SerialPortInfo> list_port_info() const override;
+    void set_ports_changed_callback(std::function<void()> callback) override;
+
+private:
+    ISerial& inner_;
+    CaptureWriter writer_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <ISerial/ISerial.h>
+#include "SerialCapture/CaptureFile.h"
+
+
+/// @brief Plays the received side of a capture back, what is written to it is discarded
+/// @details open() takes the path of the capture file. Received bytes become readable at their recorded time divided by
+/// the speed, counted from open(). A speed of 0 delivers everything at once.
+class ReplaySerial final : public ISerial {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    /// @param speed 1 for real time, N for N times faster, 0 for no delays
+    explicit ReplaySerial(double speed = 1.0);
+
+    void open(std::wstring port, int baud) override;
+
+    int write(const void* buff, int size) override;
+    int write_gather(const std::string_view* buffs, int count) override;
+    int read(void* dest, int size) override;
+    bool wait_readable(int timeout_ms) override;
+    int bytes_available() const override;
+    int read_some(void* dest, int capacity, int timeout_ms) override;
+    /// @brief There is no OS handle, returns -1
+    native_handle_t native_handle() const override;
+
+    void flush() override;
+
+    bool is_open() const override;
+
+    void close() override;
+
+    std::vector<std::wstring> list_ports() const override;
+    std::vector<SerialPortInfo> list_port_info() const override;
+
+    /// @brief All received bytes were read
+    bool finished() const;
+
+    /// @brief Received bytes in the capture
+    std::size_t total_bytes() const {
+        return total_bytes_;
+    }
+
+private:
+    /// @brief Time the record at index becomes readable
+    clock_t::time_point due(std::size_t index) const;
+
+    double speed_;
+    bool open_{ false };
+    std::vector<capture::Record> records_;
+    std::size_t current_{ 0 }, offset_{ 0 }, total_bytes_{ 0 };
+    clock_t::time_point start_;
+};
@@ -0,0 +1,109 @@
+#include "SerialCapture/CaptureFile.h"
+
+#include <algorithm>
+#include <iterator>
+
+
+static void put_varint(std::string& out, std::uint64_t val) {
+    while (val >= 0x80) {
+        out += static_cast<char>((val & 0x7f) | 0x80);
+        val >>= 7;
+    }
+    out += static_cast<char>(val);
+}
+
+static bool get_varint(std::string_view& in, std::uint64_t& val) {
+    val = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (in.empty()) {
+            return false;
+        }
+        const auto byte = static_cast<std::uint8_t>(in.front());
+        in.remove_prefix(1);
+        val |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (not(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+CaptureWriter::CaptureWriter(const std::string& path)
+  : file_(path, std::ios::binary | std::ios::trunc), start_(clock_t::now()), last_(start_) {
+    open_ = file_.is_open();
+    if (open_) {
+        file_.write(capture::magic.data(), capture::magic.size());
+        thread_ = std::thread(&CaptureWriter::run, this);
+    }
+}
+
+CaptureWriter::~CaptureWriter() {
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> l(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+}
+
+void CaptureWriter::record(capture::Direction direction, std::string_view data, clock_t::time_point time) {
+    if (not open_ || data.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> l(mtx_);
+    // records from several threads may arrive slightly out of order, time never goes backwards in the file
+    const auto delta = time > last_ ? std::chrono::duration_cast<std::chrono::nanoseconds>(time - last_).count() : 0;
+    last_ = std::max(last_, time);
+
+    put_varint(buffer_, static_cast<std::uint64_t>(delta) << 1 | static_cast<std::uint8_t>(direction));
+    put_varint(buffer_, data.size());
+    buffer_.append(data);
+    // the writer wakes up on its own, only hurry it when a lot piled up
+    if (buffer_.size() >= flush_size) {
+        cv_.notify_one();
+    }
+}
+
+void CaptureWriter::run() {
+    std::string chunk;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> l(mtx_);
+            cv_.wait_for(l, flush_interval, [this] { return stop_ || buffer_.size() >= flush_size; });
+            if (buffer_.empty() && stop_) {
+                break;
+            }
+            chunk.swap(buffer_);
+        }
+        if (chunk.empty()) {
+            continue;
+        }
+        file_.write(chunk.data(), chunk.size());
+        file_.flush();
+        chunk.clear();
+    }
+}
+
+
+std::vector<capture::Record> read_capture(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    const std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::string_view in(content);
+    if (in.substr(0, capture::magic.size()) != capture::magic) {
+        return {};
+    }
+    in.remove_prefix(capture::magic.size());
+
+    std::vector<capture::Record> ret;
+    std::chrono::nanoseconds time{ 0 };
+    std::uint64_t head, size;
+    while (get_varint(in, head) && get_varint(in, size) && size <= in.size()) {
+        time += std::chrono::nanoseconds(head >> 1);
+        ret.push_back(capture::Record{ time, static_cast<capture::Direction>(head & 1), std::string(in.substr(0, size)) });
+        in.remove_prefix(size);
+    }
+    return ret;
+}
@@ -0,0 +1,87 @@
+#include "SerialCapture/CaptureSerial.h"
+
+#include <algorithm>
+
+
+CaptureSerial::CaptureSerial(ISerial& inner, const std::string& capture_path)
+  : inner_(inner), writer_(capture_path) {
+}
+
+void CaptureSerial::open(std::wstring port, int baud) {
+    inner_.open(port, baud);
+}
+
+int CaptureSerial::write(const void* buff, int size) {
+    const int ret = inner_.write(buff, size);
+    if (ret > 0) {
+        writer_.record(capture::Direction::TX, std::string_view(static_cast<const char*>(buff), ret));
+    }
+    return ret;
+}
+
+int CaptureSerial::write_gather(const std::string_view* buffs, int count) {
+    const int ret = inner_.write_gather(buffs, count);
+    // record what was actually written, a short write ends inside a buffer
+    std::string written;
+    for (int i = 0; i < count && written.size() < static_cast<std::size_t>(std::max(ret, 0)); ++i) {
+        written += buffs[i].substr(0, ret - written.size());
+    }
+    writer_.record(capture::Direction::TX, written);
+    return ret;
+}
+
+int CaptureSerial::read(void* dest, int size) {
+    const int ret = inner_.read(dest, size);
+    if (ret > 0) {
+        writer_.record(capture::Direction::RX, std::string_view(static_cast<const char*>(dest), ret));
+    }
+    return ret;
+}
+
+bool CaptureSerial::wait_readable(int timeout_ms) {
+    return inner_.wait_readable(timeout_ms);
+}
+
+void CaptureSerial::wake() {
+    inner_.wake();
+}
+
+int CaptureSerial::bytes_available() const {
+    return inner_.bytes_available();
+}
+
+int CaptureSerial::read_some(void* dest, int capacity, int timeout_ms) {
+    const int ret = inner_.read_some(dest, capacity, timeout_ms);
+    if (ret > 0) {
+        writer_.record(capture::Direction::RX, std::string_view(static_cast<const char*>(dest), ret));
+    }
+    return ret;
+}
+
+ISerial::native_handle_t CaptureSerial::native_handle() const {
+    return inner_.native_handle();
+}
+
+void CaptureSerial::flush() {
+    inner_.flush();
+}
+
+bool CaptureSerial::is_open() const {
+    return inner_.is_open();
+}
+
+void CaptureSerial::close() {
+    inner_.close();
+}
+
+std::vector<std::wstring> CaptureSerial::list_ports() const {
+    return inner_.list_ports();
+}
+
+std::vector<SerialPortInfo> CaptureSerial::list_port_info() const {
+    return inner_.list_port_info();
+}
+
+void CaptureSerial::set_ports_changed_callback(std::function<void()> callback) {
+    inner_.set_ports_changed_callback(std::move(callback));
+}
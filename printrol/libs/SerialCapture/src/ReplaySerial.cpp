@@ -0,0 +1,138 @@
+#include "SerialCapture/ReplaySerial.h"
+
+#include <algorithm>
+#include <codecvt>
+#include <cstring>
+#include <locale>
+#include <thread>
+
+
+ReplaySerial::ReplaySerial(double speed) : speed_(speed) {
+}
+
+void ReplaySerial::open(std::wstring port, int) {
+    close();
+
+    records_ = read_capture(std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t>().to_bytes(port));
+    // only the printer's side is played back
+    records_.erase(std::remove_if(records_.begin(), records_.end(),
+                                  [](const auto& r) { return r.direction != capture::Direction::RX; }),
+                   records_.end());
+    total_bytes_ = 0;
+    for (const auto& r : records_) {
+        total_bytes_ += r.data.size();
+    }
+
+    current_ = offset_ = 0;
+    start_ = clock_t::now();
+    open_ = true;
+}
+
+ReplaySerial::clock_t::time_point ReplaySerial::due(std::size_t index) const {
+    if (speed_ <= 0) {
+        return start_;
+    }
+    const auto scaled = std::chrono::duration<double, std::nano>(records_[index].time.count() / speed_);
+    return start_ + std::chrono::duration_cast<clock_t::duration>(scaled);
+}
+
+int ReplaySerial::write(const void*, int size) {
+    return open_ ? size : -1;
+}
+
+int ReplaySerial::write_gather(const std::string_view* buffs, int count) {
+    if (not open_) {
+        return -1;
+    }
+    int ret = 0;
+    for (int i = 0; i < count; ++i) {
+        ret += static_cast<int>(buffs[i].size());
+    }
+    return ret;
+}
+
+int ReplaySerial::read(void* dest, int size) {
+    if (not open_) {
+        return -1;
+    }
+    // hand out all records that are due, like a driver buffer would
+    int ret = 0;
+    const auto now = clock_t::now();
+    while (ret < size && not finished() && due(current_) <= now) {
+        const auto& data = records_[current_].data;
+        const auto cnt = std::min<std::size_t>(size - ret, data.size() - offset_);
+        std::memcpy(static_cast<char*>(dest) + ret, data.data() + offset_, cnt);
+        ret += static_cast<int>(cnt);
+        offset_ += cnt;
+        if (offset_ == data.size()) {
+            ++current_;
+            offset_ = 0;
+        }
+    }
+    return ret;
+}
+
+bool ReplaySerial::wait_readable(int timeout_ms) {
+    if (not open_ || finished()) {
+        if (timeout_ms > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+        }
+        return false;
+    }
+    const auto deadline = clock_t::now() + std::chrono::milliseconds(timeout_ms);
+    if (due(current_) > deadline) {
+        std::this_thread::sleep_until(deadline);
+        return false;
+    }
+    std::this_thread::sleep_until(due(current_));
+    return true;
+}
+
+int ReplaySerial::bytes_available() const {
+    if (not open_) {
+        return 0;
+    }
+    std::size_t ret = 0;
+    const auto now = clock_t::now();
+    for (auto i = current_; i < records_.size() && due(i) <= now; ++i) {
+        ret += records_[i].data.size();
+    }
+    return static_cast<int>(ret - offset_);
+}
+
+int ReplaySerial::read_some(void* dest, int capacity, int timeout_ms) {
+    if (not wait_readable(timeout_ms)) {
+        return open_ ? 0 : -1;
+    }
+    return read(dest, capacity);
+}
+
+ISerial::native_handle_t ReplaySerial::native_handle() const {
+    return -1;
+}
+
+void ReplaySerial::flush() {
+    return;
+}
+
+bool ReplaySerial::is_open() const {
+    return open_;
+}
+
+void ReplaySerial::close() {
+    open_ = false;
+    records_.clear();
+    current_ = offset_ = 0;
+}
+
+std::vector<std::wstring> ReplaySerial::list_ports() const {
+    return {};
+}
+
+std::vector<SerialPortInfo> ReplaySerial::list_port_info() const {
+    return {};
+}
+
+bool ReplaySerial::finished() const {
+    return current_ >= records_.size();
+}
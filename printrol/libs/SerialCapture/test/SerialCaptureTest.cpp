@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include "SerialCapture/CaptureSerial.h"
+#include "SerialCapture/ReplaySerial.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+
+/// @brief Port reading a fixed script and accepting at most write_limit bytes per write
+class ScriptedSerial : public ISerial {
+public:
+    void open(std::wstring, int) override {
+        open_ = true;
+    }
+    void close() override {
+        open_ = false;
+    }
+    int write(const void* buff, int size) override {
+        std::string_view data(static_cast<const char*>(buff), size);
+        return write_gather(&data, 1);
+    }
+    int write_gather(const std::string_view* buffs, int count) override {
+        int written = 0;
+        for (int i = 0; i < count; ++i) {
+            const auto part = buffs[i].substr(0, write_limit - written);
+            written += static_cast<int>(part.size());
+        }
+        return written;
+    }
+    int read(void* dest, int size) override {
+        const auto cnt = std::min<std::size_t>(size, script.size());
+        std::memcpy(dest, script.data(), cnt);
+        script.erase(0, cnt);
+        return static_cast<int>(cnt);
+    }
+    bool wait_readable(int) override {
+        return not script.empty();
+    }
+    int bytes_available() const override {
+        return static_cast<int>(script.size());
+    }
+    int read_some(void* dest, int capacity, int) override {
+        return read(dest, capacity);
+    }
+    native_handle_t native_handle() const override {
+        return -1;
+    }
+    void flush() override {
+    }
+    bool is_open() const override {
+        return open_;
+    }
+    std::vector<std::wstring> list_ports() const override {
+        return { L"scripted" };
+    }
+    std::vector<SerialPortInfo> list_port_info() const override {
+        return {};
+    }
+
+    std::string script;
+    std::size_t write_limit{ 1 << 20 };
+    bool open_{ false };
+};
+
+
+class SerialCaptureTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = (std::filesystem::temp_directory_path() /
+                ("printrol_capture_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) + "_" +
+                 ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".cap"))
+                   .string();
+    }
+    void TearDown() override {
+        std::filesystem::remove(path);
+    }
+
+    std::string path;
+};
+
+
+TEST_F(SerialCaptureTest, TestRoundTrip) {
+    ScriptedSerial inner;
+    inner.script = "ok\nT:20.0 /0.0\n";
+    inner.write_limit = 6;
+    {
+        CaptureSerial serial(inner, path);
+        ASSERT_TRUE(serial.is_capturing());
+        serial.open(L"scripted", 115200);
+        EXPECT_TRUE(serial.is_open());
+        EXPECT_EQ(serial.list_ports(), inner.list_ports());
+
+        char buff[64];
+        EXPECT_EQ(serial.read_some(buff, 3, 10), 3);
+        EXPECT_EQ(serial.write("M105\n", 5), 5);
+        const std::string_view parts[] = { "G28", "\n" };
+        // only part of the gather is accepted
+        inner.write_limit = 2;
+        EXPECT_EQ(serial.write_gather(parts, 2), 2);
+        EXPECT_EQ(serial.read(buff, sizeof(buff)), 12);
+    }
+
+    const auto records = read_capture(path);
+    ASSERT_EQ(records.size(), 4u);
+    EXPECT_EQ(records[0].direction, capture::Direction::RX);
+    EXPECT_EQ(records[0].data, "ok\n");
+    EXPECT_EQ(records[1].direction, capture::Direction::TX);
+    EXPECT_EQ(records[1].data, "M105\n");
+    EXPECT_EQ(records[2].direction, capture::Direction::TX);
+    EXPECT_EQ(records[2].data, "G2");
+    EXPECT_EQ(records[3].direction, capture::Direction::RX);
+    EXPECT_EQ(records[3].data, "T:20.0 /0.0\n");
+    for (std::size_t i = 1; i < records.size(); ++i) {
+        EXPECT_LE(records[i - 1].time, records[i].time);
+    }
+}
+
+TEST_F(SerialCaptureTest, TestReadRejectsGarbage) {
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "not a capture file";
+    }
+    EXPECT_TRUE(read_capture(path).empty());
+    EXPECT_TRUE(read_capture(path + ".missing").empty());
+}
+
+TEST_F(SerialCaptureTest, TestReplayMaxSpeed) {
+    const auto start = CaptureWriter::clock_t::now();
+    {
+        CaptureWriter writer(path);
+        writer.record(capture::Direction::RX, "start\n", start);
+        writer.record(capture::Direction::TX, "M105\n", start + std::chrono::seconds(10));
+        writer.record(capture::Direction::RX, "ok T:20.0\n", start + std::chrono::seconds(3600));
+    }
+
+    ReplaySerial serial(0);
+    serial.open(std::filesystem::path(path).wstring(), 115200);
+    ASSERT_TRUE(serial.is_open());
+    EXPECT_EQ(serial.total_bytes(), 16u);
+    EXPECT_EQ(serial.bytes_available(), 16);
+    EXPECT_EQ(serial.write("M105\n", 5), 5);
+
+    std::string received;
+    char buff[4];
+    while (not serial.finished()) {
+        const int ret = serial.read_some(buff, sizeof(buff), 100);
+        ASSERT_GT(ret, 0);
+        received.append(buff, ret);
+    }
+    EXPECT_EQ(received, "start\nok T:20.0\n");
+    EXPECT_FALSE(serial.wait_readable(0));
+
+    serial.close();
+    EXPECT_FALSE(serial.is_open());
+    EXPECT_EQ(serial.read(buff, sizeof(buff)), -1);
+}
+
+TEST_F(SerialCaptureTest, TestReplayRealTime) {
+    const auto start = CaptureWriter::clock_t::now();
+    {
+        CaptureWriter writer(path);
+        writer.record(capture::Direction::RX, "first\n", start);
+        writer.record(capture::Direction::RX, "second\n", start + std::chrono::milliseconds(100));
+    }
+
+    ReplaySerial serial(1.0);
+    const auto opened = ReplaySerial::clock_t::now();
+    serial.open(std::filesystem::path(path).wstring(), 115200);
+
+    char buff[64];
+    EXPECT_EQ(serial.read_some(buff, sizeof(buff), 50), 6);
+    // the second line is not due yet
+    EXPECT_EQ(serial.read_some(buff, sizeof(buff), 10), 0);
+    EXPECT_EQ(serial.read_some(buff, sizeof(buff), 1000), 7);
+    const auto elapsed = ReplaySerial::clock_t::now() - opened;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(100));
+    EXPECT_LT(elapsed, std::chrono::milliseconds(500));
+    EXPECT_TRUE(serial.finished());
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <ISerial/ISerial.h>
+
+/// @brief ISerial over a raw TCP connection, e.g. to a ser2net or ESP3D bridge
+/// @details The port is given as "host:port", optionally prefixed with "tcp://". The baud rate is ignored, it is set up
+/// on the bridge. Nagle's algorithm is off so every command leaves at once, and keepalive detects dead bridges.
+class TcpSerial final : public ISerial {
+public:
+    /// @param connect_timeout_ms Time open() waits for the connection
+    explicit TcpSerial(int connect_timeout_ms = 3000);
+
+    void open(std::wstring port, int baud) override;
+
+    int write(const void* buff, int size) override;
+    int write_gather(const std::string_view* buffs, int count) override;
+    int read(void* dest, int size) override;
+    bool wait_readable(int timeout_ms) override;
+    void wake() override;
+    int bytes_available() const override;
+    int read_some(void* dest, int capacity, int timeout_ms) override;
+    native_handle_t native_handle() const override;
+
+    void flush() override;
+
+    bool is_open() const override;
+
+    void close() override;
+
+    virtual ~TcpSerial();
+
+    /// @brief Network ports cannot be enumerated, returns nothing
+    std::vector<std::wstring> list_ports() const override;
+    std::vector<SerialPortInfo> list_port_info() const override;
+
+private:
+    /// @brief Handle the result of a failed recv/send, closes the socket if the connection is gone
+    /// @return 0 if the call would have blocked, -1 otherwise
+    int handle_error();
+
+    int connect_timeout_ms_;
+    int socket_{ -1 };
+    /// written by wake() to end the poll of wait_readable()
+    int wake_pipe_[2]{ -1, -1 };
+};
@@ -0,0 +1,265 @@
+#include "TcpSerial/TcpSerial.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <codecvt>
+#include <locale>
+
+
+/// @brief Split "tcp://host:port" into host and port, the brackets of "[::1]:23" are removed
+static bool split_address(std::string address, std::string& host, std::string& service) {
+    if (address.compare(0, 6, "tcp://") == 0) {
+        address.erase(0, 6);
+    }
+    const auto colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == address.size()) {
+        return false;
+    }
+    host = address.substr(0, colon);
+    service = address.substr(colon + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    return true;
+}
+
+static void set_option(int fd, int level, int name, int value) {
+    setsockopt(fd, level, name, &value, sizeof(value));
+}
+
+/// @brief Start a non-blocking connect to @p addr and wait up to @p timeout_ms for it
+/// @return The connected socket, -1 on failure
+static int connect_with_timeout(const addrinfo& addr, int timeout_ms) {
+    const int fd = ::socket(addr.ai_family, addr.ai_socktype | SOCK_CLOEXEC, addr.ai_protocol);
+    if (fd < 0) {
+        return -1;
+    }
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    if (::connect(fd, addr.ai_addr, addr.ai_addrlen) != 0) {
+        if (errno != EINPROGRESS) {
+            ::close(fd);
+            return -1;
+        }
+        pollfd pfd{ fd, POLLOUT, 0 };
+        int ret;
+        do {
+            ret = ::poll(&pfd, 1, timeout_ms);
+        } while (ret < 0 && errno == EINTR);
+
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (ret <= 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0) {
+            ::close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+
+TcpSerial::TcpSerial(int connect_timeout_ms) : connect_timeout_ms_(connect_timeout_ms) {
+    if (::pipe(wake_pipe_) == 0) {
+        for (int fd : wake_pipe_) {
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+}
+
+void TcpSerial::open(std::wstring port, int) {
+    close();
+
+    std::string host, service;
+    if (not split_address(std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t>().to_bytes(port), host,
+                          service)) {
+        printf("Invalid address, expected host:port\n");
+        return;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addrs = nullptr;
+    if (const int err = getaddrinfo(host.c_str(), service.c_str(), &hints, &addrs); err != 0) {
+        printf("Error resolving %s: %s\n", host.c_str(), gai_strerror(err));
+        return;
+    }
+
+    // the timeout covers all addresses of the host together
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(connect_timeout_ms_);
+    for (const addrinfo* addr = addrs; addr != nullptr && socket_ < 0; addr = addr->ai_next) {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline -
+                                                                                std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            break;
+        }
+        socket_ = connect_with_timeout(*addr, static_cast<int>(left.count()));
+    }
+    freeaddrinfo(addrs);
+
+    if (not is_open()) {
+        printf("Error connecting to %s:%s\n", host.c_str(), service.c_str());
+        return;
+    }
+
+    set_option(socket_, IPPROTO_TCP, TCP_NODELAY, 1);
+    set_option(socket_, SOL_SOCKET, SO_KEEPALIVE, 1);
+#if defined(TCP_KEEPIDLE)
+    // notice a dead bridge within ~25 s instead of hours
+    set_option(socket_, IPPROTO_TCP, TCP_KEEPIDLE, 10);
+    set_option(socket_, IPPROTO_TCP, TCP_KEEPINTVL, 5);
+    set_option(socket_, IPPROTO_TCP, TCP_KEEPCNT, 3);
+#endif
+}
+
+int TcpSerial::handle_error() {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return 0;
+    }
+    close();
+    return -1;
+}
+
+int TcpSerial::write(const void* buff, int size) {
+    // like a tty, write everything unless the connection fails
+    const char* data = static_cast<const char*>(buff);
+    int written = 0;
+    while (written < size && is_open()) {
+        const auto ret = ::send(socket_, data + written, size - written, MSG_NOSIGNAL);
+        if (ret > 0) {
+            written += ret;
+            continue;
+        }
+        if (handle_error() < 0) {
+            break;
+        }
+        pollfd pfd{ socket_, POLLOUT, 0 };
+        ::poll(&pfd, 1, 1000);
+    }
+    return written;
+}
+
+int TcpSerial::write_gather(const std::string_view* buffs, int count) {
+    if (not is_open()) {
+        return -1;
+    }
+    constexpr int max_iov = 64;
+    iovec iov[max_iov];
+    count = std::min(count, max_iov);
+    for (int i = 0; i < count; ++i) {
+        iov[i].iov_base = const_cast<char*>(buffs[i].data());
+        iov[i].iov_len = buffs[i].size();
+    }
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    const auto ret = ::sendmsg(socket_, &msg, MSG_NOSIGNAL);
+    return ret >= 0 ? static_cast<int>(ret) : handle_error();
+}
+
+int TcpSerial::read(void* dest, int size) {
+    if (not is_open()) {
+        return -1;
+    }
+    if (size <= 0) {
+        // recv would return 0, which means the peer closed
+        return 0;
+    }
+    const auto ret = ::recv(socket_, dest, size, 0);
+    if (ret == 0) {
+        // closed by the peer
+        close();
+        return -1;
+    }
+    return ret > 0 ? static_cast<int>(ret) : handle_error();
+}
+
+bool TcpSerial::wait_readable(int timeout_ms) {
+    if (not is_open()) {
+        return false;
+    }
+    pollfd fds[2] = { { socket_, POLLIN, 0 }, { wake_pipe_[0], POLLIN, 0 } };
+    int ret;
+    do {
+        ret = ::poll(fds, wake_pipe_[0] >= 0 ? 2 : 1, timeout_ms);
+    } while (ret < 0 && errno == EINTR);
+    if (ret > 0 && fds[1].revents) {
+        char buf[64];
+        while (::read(wake_pipe_[0], buf, sizeof(buf)) > 0) {
+        }
+    }
+    // a hangup is readable too, read() then reports it
+    return ret > 0 && fds[0].revents;
+}
+
+void TcpSerial::wake() {
+    const char c = 0;
+    while (::write(wake_pipe_[1], &c, 1) < 0 && errno == EINTR) {
+    }
+}
+
+int TcpSerial::bytes_available() const {
+    int cnt = 0;
+    if (not is_open() || ::ioctl(socket_, FIONREAD, &cnt) < 0) {
+        return 0;
+    }
+    return cnt;
+}
+
+int TcpSerial::read_some(void* dest, int capacity, int timeout_ms) {
+    if (not wait_readable(timeout_ms)) {
+        return is_open() ? 0 : -1;
+    }
+    return read(dest, capacity);
+}
+
+ISerial::native_handle_t TcpSerial::native_handle() const {
+    return socket_;
+}
+
+void TcpSerial::flush() {
+    return;
+}
+
+bool TcpSerial::is_open() const {
+    return socket_ >= 0;
+}
+
+void TcpSerial::close() {
+    if (is_open()) {
+        ::close(socket_);
+        socket_ = -1;
+    }
+}
+
+TcpSerial::~TcpSerial() {
+    close();
+    for (int fd : wake_pipe_) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+std::vector<std::wstring> TcpSerial::list_ports() const {
+    return {};
+}
+
+std::vector<SerialPortInfo> TcpSerial::list_port_info() const {
+    return {};
+}
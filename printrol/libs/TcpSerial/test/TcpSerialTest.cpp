@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "TcpSerial/TcpSerial.h"
+
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+/// @brief Loopback stand-in for a serial bridge, answers "ok\n" to every received line and hangs up on M112
+class TcpSerialTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_GE(listener, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ASSERT_EQ(0, ::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+        ASSERT_EQ(0, ::listen(listener, 1));
+        socklen_t len = sizeof(addr);
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len);
+        port = L"127.0.0.1:" + std::to_wstring(ntohs(addr.sin_port));
+
+        server = std::thread([this] {
+            const int client = ::accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                return;
+            }
+            char buf[256];
+            ssize_t cnt;
+            while ((cnt = ::recv(client, buf, sizeof(buf), 0)) > 0) {
+                received.append(buf, cnt);
+                if (received.find("M112\n") != std::string::npos) {
+                    break;
+                }
+                for (ssize_t i = 0; i < cnt; ++i) {
+                    if (buf[i] == '\n') {
+                        ::send(client, "ok\n", 3, MSG_NOSIGNAL);
+                    }
+                }
+            }
+            ::close(client);
+        });
+    }
+    void TearDown() override {
+        ::shutdown(listener, SHUT_RDWR);
+        ::close(listener);
+        server.join();
+    }
+
+    /// @brief Read until @p count bytes arrived
+    static std::string read_n(TcpSerial& serial, std::size_t count) {
+        std::string ret;
+        char buf[64];
+        while (ret.size() < count) {
+            const int cnt = serial.read_some(buf, sizeof(buf), 1000);
+            if (cnt <= 0) {
+                break;
+            }
+            ret.append(buf, cnt);
+        }
+        return ret;
+    }
+
+    int listener{ -1 };
+    std::thread server;
+    std::wstring port;
+    std::string received;
+};
+
+TEST_F(TcpSerialTest, TestRoundTrip) {
+    TcpSerial serial;
+    serial.open(L"tcp://" + port, 0);
+    ASSERT_TRUE(serial.is_open());
+    EXPECT_GE(serial.native_handle(), 0);
+
+    EXPECT_EQ(0, serial.read_some(nullptr, 0, 0));
+    EXPECT_EQ(5, serial.write("M105\n", 5));
+    EXPECT_EQ("ok\n", read_n(serial, 3));
+
+    const std::string_view parts[] = { "G1 X1\n", "G1 X2\n" };
+    EXPECT_EQ(12, serial.write_gather(parts, 2));
+    EXPECT_EQ("ok\nok\n", read_n(serial, 6));
+    EXPECT_EQ(0, serial.bytes_available());
+
+    serial.close();
+    EXPECT_FALSE(serial.is_open());
+}
+
+TEST_F(TcpSerialTest, TestPeerClose) {
+    TcpSerial serial;
+    serial.open(port, 0);
+    ASSERT_TRUE(serial.is_open());
+
+    serial.write("M112\n", 5);
+    char buf[8];
+    EXPECT_EQ(-1, serial.read_some(buf, sizeof(buf), 1000));
+    EXPECT_FALSE(serial.is_open());
+}
+
+TEST_F(TcpSerialTest, TestConnectFailure) {
+    TcpSerial serial(500);
+    serial.open(L"127.0.0.1:1", 0);
+    EXPECT_FALSE(serial.is_open());
+    serial.open(L"no port", 0);
+    EXPECT_FALSE(serial.is_open());
+
+    // unblock the server
+    serial.open(port, 0);
+    EXPECT_TRUE(serial.is_open());
+}
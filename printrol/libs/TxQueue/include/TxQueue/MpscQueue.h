@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+
+/// @brief Unbounded multiple producer, single consumer queue
+/// @details push() is lock-free and may be called from any thread, pop() only from the consumer. Based on the intrusive
+/// queue by Dmitry Vyukov: a producer swaps itself in as the head with a single atomic exchange and then links the
+/// previous head to itself.
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() {
+        stub_.next.store(nullptr, std::memory_order_relaxed);
+        head_.store(&stub_, std::memory_order_relaxed);
+        tail_ = &stub_;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue() {
+        while (pop()) {
+        }
+    }
+
+    void push(T val) {
+        push_node(new Node{ {}, std::move(val) });
+    }
+
+    /// @brief Take the oldest element
+    /// @return nullopt if empty, or if the oldest producer has not finished linking its element yet
+    std::optional<T> pop() {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_) {
+            if (next == nullptr) {
+                return std::nullopt;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next == nullptr) {
+            if (tail != head_.load(std::memory_order_acquire)) {
+                // a producer is between its exchange and its link
+                return std::nullopt;
+            }
+            // tail is the last node, put the stub behind it so it can be unlinked
+            push_node(&stub_);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return std::nullopt;
+            }
+        }
+        tail_ = next;
+        std::optional<T> ret(std::move(*tail->val));
+        delete tail;
+        return ret;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{ nullptr };
+        std::optional<T> val;
+    };
+
+    void push_node(Node* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    std::atomic<Node*> head_;
+    Node* tail_;
+    Node stub_;
+};
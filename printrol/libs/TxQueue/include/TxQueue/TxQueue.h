@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ISerial/ISerial.h>
+#include <MeatPack/MeatPack.h>
+#include "TxQueue/MpscQueue.h"
+
+
+/// @brief Line number the printer asks for in a "Resend: N" line, -1 for any other line
+long resend_number(std::string_view line);
+
+/// @brief Limits TxQueue keeps to not overflow the printer
+struct TxQueueConfig {
+    /// bytes the printer can buffer, Marlin's default RX_BUFFER_SIZE
+    std::size_t rx_buffer_size{ 128 };
+    /// commands the printer queues, Marlin's default BUFSIZE. Learned from the oks if the printer has ADVANCED_OK.
+    std::size_t max_commands{ 4 };
+    /// upper bound of one write
+    std::size_t max_write{ 4096 };
+    /// keep the printer's buffers full, false to wait for the ok of every command before sending the next
+    bool windowed{ true };
+};
+
+/// @brief Lines TxQueue sends after the pushed commands, e.g. a print job
+/// @details Only called from the writer thread.
+class TxSource {
+public:
+    virtual ~TxSource() = default;
+
+    /// @brief Next line to send including its line ending, empty if there is none right now
+    /// @details The view stays valid until pop() and is not consumed until then, TxQueue may peek without sending.
+    virtual std::string_view peek() = 0;
+    /// @brief The line returned by peek() was taken for sending
+    virtual void pop() = 0;
+    /// @brief The printer acknowledged a line of this source
+    virtual void acknowledged() {
+    }
+    /// @brief The printer dropped a line of this source unanswered, see TxQueue::resend()
+    virtual void discarded() {
+    }
+};
+
+/// @brief Ordered transmit queue with a single writer
+/// @details Any thread may push() commands. The thread owning the port calls send(), which writes as many queued commands
+/// as the printer can take with one gather write and resumes short writes where they stopped. A command counts as in
+/// flight from its first written byte until acknowledge() is called for its "ok". Commands are always written whole and
+/// in order, nothing is inserted in the middle of one. Lines of a TxSource fill the room left by pushed commands.
+///
+/// The window follows Marlin's buffering: the oldest max_commands commands in flight sit in the printer's command queue,
+/// the newer ones wait in its RX buffer and count against rx_buffer_size byte by byte. Several commands go out before
+/// the first ok returns, so the link does not idle for a round trip between commands.
+///
+/// With MeatPack enabled commands are packed when they are queued, so the window counts the bytes on the wire.
+///
+/// Emergency commands have their own lane: they go out with the next send() ahead of everything pending, see
+/// push_emergency().
+class TxQueue {
+public:
+    using Config = TxQueueConfig;
+
+    explicit TxQueue(const Config& config = Config());
+
+    /// @brief Queue one or more lines, a missing final line ending is added. Thread safe, lock-free.
+    void push(std::string commands);
+    /// @brief Queue commands ahead of everything pending, for M112, M108, M410 and M876. Thread safe, lock-free.
+    /// @details They go out plain and without a line number right after the rest of a partly written command. With
+    /// set_emergency_parser() they do not wait for room in the window either, the firmware acts on them as the bytes
+    /// arrive. Wake the writer thread afterwards, e.g. with ISerial::wake(), so they do not wait for its next round.
+    void push_emergency(std::string commands);
+
+    /// @brief Take the emergency commands not sent yet, to write them while something else owns the port, e.g. between
+    /// the packets of an upload. Only from the writer thread.
+    std::string take_emergency();
+
+    /// @brief Write what the printer has room for. Only from the writer thread.
+    /// @return Bytes written, negative on a port error
+    int send(ISerial& serial);
+
+    /// @brief The printer acknowledged @p count commands
+    void acknowledge(std::size_t count = 1);
+    /// @brief Acknowledge the command answered by the ok line @p line
+    /// @details ADVANCED_OK fields, "ok N<line> P<free planner blocks> B<free command slots>", size the window to the
+    /// printer's actual command buffer. N names the line answered, commands before it whose ok got lost are
+    /// acknowledged with it and an ok for a line no longer in flight is ignored.
+    void acknowledge_ok(std::string_view line);
+    /// @brief The printer asked for line @p number again, see resend_number()
+    /// @details Marlin flushes its RX buffer along with the request, so only the commands up to the line get an ok.
+    /// The ones sent after it leave the window.
+    void resend(long number);
+
+    /// @brief Drop everything queued and in flight, e.g. after reconnecting. The source stays set.
+    /// @details If MeatPack was on, the first thing sent afterwards turns it off in the firmware.
+    void reset();
+
+    /// @brief Turn on MeatPack in the firmware and pack every command queued from now on. Only from the writer thread.
+    void enable_meatpack(bool no_spaces = true);
+    /// @brief Turn off MeatPack in the firmware and send plain text again. Only from the writer thread.
+    void disable_meatpack();
+    bool meatpack() const {
+        return encoder_.has_value();
+    }
+
+    /// @brief The firmware has EMERGENCY_PARSER. Only from the writer thread.
+    void set_emergency_parser(bool enable) {
+        emergency_parser_ = enable;
+    }
+    bool emergency_parser() const {
+        return emergency_parser_;
+    }
+
+    /// @brief Take lines from @p source whenever pushed commands leave room. nullptr to unset. Only from the writer
+    /// thread.
+    void set_source(TxSource* source) {
+        source_ = source;
+    }
+
+    /// @brief Commands queued and not fully written yet
+    std::size_t pending() const {
+        return pending_.size();
+    }
+    /// @brief Commands written and not acknowledged yet
+    std::size_t in_flight() const {
+        return in_flight_.size();
+    }
+    std::size_t in_flight_bytes() const {
+        return in_flight_bytes_;
+    }
+    /// @brief Commands the printer is assumed to queue
+    std::size_t command_slots() const {
+        return command_slots_;
+    }
+    /// @brief Free planner blocks in the last ADVANCED_OK, -1 if there was none
+    int planner_free() const {
+        return planner_free_;
+    }
+
+private:
+    struct Command {
+        std::string data;
+        /// from source_
+        bool sourced;
+        /// a MeatPack control sequence, not answered by an ok
+        bool control{ false };
+        /// from push_emergency()
+        bool emergency{ false };
+        /// the N<line> the command starts with, -1 if none
+        long line{ -1 };
+    };
+    struct InFlight {
+        std::size_t size;
+        bool sourced;
+        long line;
+    };
+
+    /// @brief What a send would leave in flight
+    struct Window {
+        std::size_t commands;
+        /// bytes of the commands waiting in the printer's RX buffer
+        std::size_t rx_bytes;
+    };
+
+    /// @brief Move pushed commands to pending_, one line each
+    void drain();
+    /// @brief Move emergency commands in front of the pending commands, behind a partly written one
+    void drain_emergency();
+    /// @brief Move source lines to pending_ while they would fit behind the pending commands
+    void pull_source();
+    /// @brief Set @p data to @p line, packed if MeatPack is on
+    void assign(std::string& data, std::string_view line) const;
+    /// @brief Queue a MeatPack control sequence behind the pending commands
+    void push_control(std::string sequence);
+
+    /// @brief The command of line @p number in flight, in_flight_.end() if there is none
+    std::deque<InFlight>::iterator find_line(long number);
+
+    /// @brief The commands in flight now
+    Window window() const;
+    /// @brief Whether a command of @p size may follow @p window
+    bool fits(std::size_t size, const Window& window) const;
+    /// @brief Add a command of @p size to @p window
+    void add(std::size_t size, Window& window) const;
+
+    Config config_;
+    MpscQueue<std::string> incoming_, emergency_;
+    std::deque<Command> pending_;
+    /// bytes of pending_.front() already written
+    std::size_t front_written_{ 0 };
+    /// commands waiting for their ok
+    std::deque<InFlight> in_flight_;
+    std::size_t in_flight_bytes_{ 0 };
+    std::size_t command_slots_;
+    /// an ADVANCED_OK arrived, command_slots_ is learned
+    bool slots_learned_{ false };
+    int planner_free_{ -1 };
+    TxSource* source_{ nullptr };
+    /// strings of sent commands, reused for source lines
+    std::vector<std::string> spare_;
+    /// set while MeatPack is on
+    std::optional<MeatPackEncoder> encoder_;
+    bool emergency_parser_{ false };
+};
@@ -0,0 +1,345 @@
+#include "TxQueue/TxQueue.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+
+
+/// gather write segments per send()
+static constexpr std::size_t max_segments = 64;
+
+
+/// @brief Value of the field @p letter followed by digits, e.g. "P15", in the ok line @p line
+static int ok_field(std::string_view line, char letter) {
+    for (std::size_t pos = line.find(' '); pos != std::string_view::npos; pos = line.find(' ', pos + 1)) {
+        if (pos + 1 < line.size() && line[pos + 1] == letter) {
+            int val = 0;
+            const auto end = line.data() + line.size();
+            const auto [ptr, ec] = std::from_chars(line.data() + pos + 2, end, val);
+            // a field ends at a space or the line end, "B:20.0" in temperature reports is not one
+            if (ec == std::errc() && (ptr == end || *ptr == ' ' || *ptr == '\r' || *ptr == '\n')) {
+                return val;
+            }
+        }
+    }
+    return -1;
+}
+
+
+/// @brief Value of the "N<line>" a command starts with, -1 if it has none
+static long line_number(std::string_view command) {
+    long val = -1;
+    if (not command.empty() && command[0] == 'N') {
+        std::from_chars(command.data() + 1, command.data() + command.size(), val);
+    }
+    return val;
+}
+
+
+/// @brief Call @p fn with each line of @p commands that is not blank, including its '\n'
+template <typename F>
+static void for_each_line(std::string_view commands, F fn) {
+    while (not commands.empty()) {
+        const auto end = commands.find('\n') + 1;
+        const auto line = commands.substr(0, end);
+        commands.remove_prefix(end);
+        if (line.find_first_not_of(" \t\r\n") != std::string_view::npos) {
+            fn(line);
+        }
+    }
+}
+
+
+long resend_number(std::string_view line) {
+    constexpr std::string_view prefix = "Resend:";
+    if (line.substr(0, prefix.size()) != prefix) {
+        return -1;
+    }
+    line.remove_prefix(prefix.size());
+    line.remove_prefix(std::min(line.find_first_not_of(' '), line.size()));
+    long number = -1;
+    std::from_chars(line.data(), line.data() + line.size(), number);
+    return number;
+}
+
+
+TxQueue::TxQueue(const Config& config) : config_(config), command_slots_(std::max<std::size_t>(config.max_commands, 1)) {
+}
+
+void TxQueue::push(std::string commands) {
+    if (commands.empty()) {
+        return;
+    }
+    if (commands.back() != '\n') {
+        commands += '\n';
+    }
+    incoming_.push(std::move(commands));
+}
+
+void TxQueue::push_emergency(std::string commands) {
+    if (commands.empty()) {
+        return;
+    }
+    if (commands.back() != '\n') {
+        commands += '\n';
+    }
+    emergency_.push(std::move(commands));
+}
+
+void TxQueue::drain() {
+    while (auto commands = incoming_.pop()) {
+        for_each_line(*commands, [this](std::string_view line) {
+            std::string data;
+            assign(data, line);
+            Command cmd{ std::move(data), false };
+            cmd.line = line_number(line);
+            pending_.push_back(std::move(cmd));
+        });
+    }
+}
+
+void TxQueue::drain_emergency() {
+    // nothing goes into the middle of a command, and earlier emergency commands stay ahead
+    std::size_t pos = front_written_ > 0 ? 1 : 0;
+    while (pos < pending_.size() && pending_[pos].emergency) {
+        ++pos;
+    }
+    // the firmware unpacks at pos if MeatPack is on and not toggled behind it, or if it is turned off behind it
+    const auto control =
+        std::find_if(pending_.begin() + pos, pending_.end(), [](const Command& cmd) { return cmd.control; });
+    const bool packed =
+        control == pending_.end() ? encoder_.has_value() : control->data == MeatPackEncoder::disable_sequence();
+    while (auto commands = emergency_.pop()) {
+        for_each_line(*commands, [this, &pos, packed](std::string_view line) {
+            Command cmd{ {}, false };
+            cmd.emergency = true;
+            if (packed) {
+                // Marlin's emergency parser sees the raw bytes before they are unpacked, so the command goes out
+                // plain. The '\n' ends whatever the parser made of the packed bytes before.
+                cmd.data = MeatPackEncoder::disable_sequence() + "\n";
+                cmd.data.append(line);
+                cmd.data += encoder_ ? encoder_->enable_sequence() : MeatPackEncoder().enable_sequence();
+            } else {
+                cmd.data.assign(line);
+            }
+            pending_.insert(pending_.begin() + pos++, std::move(cmd));
+        });
+    }
+}
+
+std::string TxQueue::take_emergency() {
+    std::string ret;
+    // moved in front of the pending commands already, unless one is partly written before them
+    for (std::size_t i = front_written_ > 0 ? 1 : 0; i < pending_.size() && pending_[i].emergency;) {
+        ret += pending_[i].data;
+        pending_.erase(pending_.begin() + static_cast<std::ptrdiff_t>(i));
+    }
+    while (auto commands = emergency_.pop()) {
+        ret += *commands;
+    }
+    return ret;
+}
+
+void TxQueue::pull_source() {
+    if (source_ == nullptr) {
+        return;
+    }
+    auto window = this->window();
+    for (std::size_t i = front_written_ > 0 ? 1 : 0; i < pending_.size(); ++i) {
+        if (not pending_[i].control) {
+            add(pending_[i].data.size(), window);
+        }
+    }
+    // the source never gets ahead of the window, so a resend or cancel does not have queued lines to take back
+    for (auto line = source_->peek(); not line.empty() && fits(line.size(), window); line = source_->peek()) {
+        std::string data;
+        if (not spare_.empty()) {
+            data = std::move(spare_.back());
+            spare_.pop_back();
+        }
+        assign(data, line);
+        Command cmd{ std::move(data), true };
+        cmd.line = line_number(line);
+        source_->pop();
+        add(cmd.data.size(), window);
+        pending_.push_back(std::move(cmd));
+    }
+}
+
+void TxQueue::assign(std::string& data, std::string_view line) const {
+    if (encoder_) {
+        data.clear();
+        encoder_->encode(line, data);
+    } else {
+        data.assign(line);
+    }
+}
+
+void TxQueue::push_control(std::string sequence) {
+    Command cmd{ std::move(sequence), false };
+    cmd.control = true;
+    pending_.push_back(std::move(cmd));
+}
+
+TxQueue::Window TxQueue::window() const {
+    Window ret{ in_flight_.size(), 0 };
+    for (std::size_t i = command_slots_; i < in_flight_.size(); ++i) {
+        ret.rx_bytes += in_flight_[i].size;
+    }
+    return ret;
+}
+
+bool TxQueue::fits(std::size_t size, const Window& window) const {
+    if (window.commands == 0) {
+        // a command larger than the whole buffer still goes out once nothing else is in flight
+        return true;
+    }
+    if (not config_.windowed) {
+        return false;
+    }
+    return window.commands < command_slots_ || window.rx_bytes + size <= config_.rx_buffer_size;
+}
+
+void TxQueue::add(std::size_t size, Window& window) const {
+    if (window.commands >= command_slots_) {
+        window.rx_bytes += size;
+    }
+    ++window.commands;
+}
+
+int TxQueue::send(ISerial& serial) {
+    drain();
+    drain_emergency();
+    pull_source();
+
+    std::array<std::string_view, max_segments> segments;
+    std::size_t count = 0, total = 0;
+    auto window = this->window();
+    for (std::size_t i = 0; i < pending_.size() && count < segments.size() && total < config_.max_write; ++i) {
+        std::string_view cmd(pending_[i].data);
+        if (i == 0 && front_written_ > 0) {
+            // the rest of a short write, already in flight
+            cmd.remove_prefix(front_written_);
+        } else if (not pending_[i].control) {
+            // the emergency parser takes the command even from a full buffer
+            if (not (pending_[i].emergency && emergency_parser_) && not fits(cmd.size(), window)) {
+                break;
+            }
+            add(cmd.size(), window);
+        }
+        segments[count++] = cmd;
+        total += cmd.size();
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    const int ret = serial.write_gather(segments.data(), static_cast<int>(count));
+    if (ret <= 0) {
+        return ret;
+    }
+
+    std::size_t left = ret;
+    while (left > 0) {
+        auto& cmd = pending_.front();
+        if (front_written_ == 0 && not cmd.control) {
+            in_flight_.push_back({ cmd.data.size(), cmd.sourced, cmd.line });
+            in_flight_bytes_ += cmd.data.size();
+        }
+        const std::size_t rest = cmd.data.size() - front_written_;
+        if (left < rest) {
+            front_written_ += left;
+            break;
+        }
+        left -= rest;
+        front_written_ = 0;
+        if (cmd.sourced) {
+            spare_.push_back(std::move(cmd.data));
+        }
+        pending_.pop_front();
+    }
+    return ret;
+}
+
+void TxQueue::acknowledge(std::size_t count) {
+    // oks without a command in flight, e.g. for commands sent before a reset, are ignored
+    for (; count > 0 && not in_flight_.empty(); --count) {
+        const auto cmd = in_flight_.front();
+        in_flight_bytes_ -= cmd.size;
+        in_flight_.pop_front();
+        if (cmd.sourced && source_) {
+            source_->acknowledged();
+        }
+    }
+}
+
+void TxQueue::acknowledge_ok(std::string_view line) {
+    if (const int number = ok_field(line, 'N'); number >= 0) {
+        if (const auto it = find_line(number); it != in_flight_.end()) {
+            acknowledge(static_cast<std::size_t>(it - in_flight_.begin()) + 1);
+        }
+    } else {
+        acknowledge();
+    }
+
+    const int buffer_free = ok_field(line, 'B');
+    if (buffer_free < 0) {
+        return;
+    }
+    planner_free_ = ok_field(line, 'P');
+    // B counts the slot of the command being acknowledged as taken, the most ever free plus it is the buffer size
+    const auto slots = static_cast<std::size_t>(buffer_free) + 1;
+    command_slots_ = slots_learned_ ? std::max(command_slots_, slots) : slots;
+    slots_learned_ = true;
+}
+
+void TxQueue::resend(long number) {
+    const auto it = find_line(number);
+    if (it == in_flight_.end()) {
+        return;
+    }
+    // the rest of a partly written command arrives after the flush and is answered as a line error
+    const auto end = in_flight_.end() - (front_written_ > 0 && it + 1 != in_flight_.end() ? 1 : 0);
+    for (auto cmd = it + 1; cmd != end; ++cmd) {
+        in_flight_bytes_ -= cmd->size;
+        if (cmd->sourced && source_) {
+            source_->discarded();
+        }
+    }
+    in_flight_.erase(it + 1, end);
+}
+
+std::deque<TxQueue::InFlight>::iterator TxQueue::find_line(long number) {
+    return std::find_if(in_flight_.begin(), in_flight_.end(),
+                        [number](const InFlight& cmd) { return cmd.line == number; });
+}
+
+void TxQueue::enable_meatpack(bool no_spaces) {
+    // commands pushed before go out plain
+    drain();
+    encoder_.emplace(no_spaces);
+    push_control(encoder_->enable_sequence());
+}
+
+void TxQueue::disable_meatpack() {
+    drain();
+    if (encoder_) {
+        encoder_.reset();
+        push_control(MeatPackEncoder::disable_sequence());
+    }
+}
+
+void TxQueue::reset() {
+    drain();
+    drain_emergency();
+    pending_.clear();
+    front_written_ = 0;
+    in_flight_.clear();
+    in_flight_bytes_ = 0;
+    command_slots_ = std::max<std::size_t>(config_.max_commands, 1);
+    slots_learned_ = false;
+    planner_free_ = -1;
+    emergency_parser_ = false;
+    // the firmware may still unpack, e.g. when the port was reopened without resetting the printer
+    disable_meatpack();
+}
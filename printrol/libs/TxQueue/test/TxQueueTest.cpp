@@ -0,0 +1,381 @@
+#include <gtest/gtest.h>
+#include "TxQueue/TxQueue.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+
+/// @brief Port recording gather writes, accepting at most write_limit bytes per call
+class RecordingSerial : public ISerial {
+public:
+    void open(std::wstring, int) override {
+    }
+    void close() override {
+    }
+    int write(const void* buff, int size) override {
+        std::string_view data(static_cast<const char*>(buff), size);
+        return write_gather(&data, 1);
+    }
+    int write_gather(const std::string_view* buffs, int count) override {
+        ++writes;
+        int written = 0;
+        for (int i = 0; i < count; ++i) {
+            const auto part = buffs[i].substr(0, write_limit - written);
+            data.append(part);
+            written += static_cast<int>(part.size());
+        }
+        return written;
+    }
+    int read(void*, int) override {
+        return 0;
+    }
+    bool wait_readable(int) override {
+        return false;
+    }
+    int bytes_available() const override {
+        return 0;
+    }
+    int read_some(void*, int, int) override {
+        return 0;
+    }
+    native_handle_t native_handle() const override {
+        return -1;
+    }
+    void flush() override {
+    }
+    bool is_open() const override {
+        return true;
+    }
+    std::vector<std::wstring> list_ports() const override {
+        return {};
+    }
+    std::vector<SerialPortInfo> list_port_info() const override {
+        return {};
+    }
+
+    std::string data;
+    int writes{ 0 };
+    std::size_t write_limit{ 1 << 20 };
+};
+
+
+TEST(MpscQueueTest, TestOrderPerProducer) {
+    constexpr int producers = 4, per_producer = 10000;
+    MpscQueue<int> queue;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, p] {
+            for (int i = 0; i < per_producer; ++i) {
+                queue.push(p * per_producer + i);
+            }
+        });
+    }
+
+    std::vector<int> last(producers, -1);
+    int received = 0;
+    while (received < producers * per_producer) {
+        if (const auto val = queue.pop()) {
+            const int p = *val / per_producer;
+            EXPECT_LT(last[p], *val);
+            last[p] = *val;
+            ++received;
+        }
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_FALSE(queue.pop());
+}
+
+TEST(TxQueueTest, TestCoalesces) {
+    RecordingSerial serial;
+    TxQueue txq;
+    txq.push("G28\nG1 X10");
+    txq.push("M105\n");
+
+    EXPECT_EQ(16, txq.send(serial));
+    EXPECT_EQ(1, serial.writes);
+    EXPECT_EQ("G28\nG1 X10\nM105\n", serial.data);
+    EXPECT_EQ(3u, txq.in_flight());
+    EXPECT_EQ(0u, txq.pending());
+}
+
+TEST(TxQueueTest, TestShortWrite) {
+    RecordingSerial serial;
+    serial.write_limit = 5;
+    TxQueue txq;
+    txq.push("G1 X10\nG1 Y10\n");
+
+    EXPECT_EQ(5, txq.send(serial));
+    EXPECT_EQ(1u, txq.in_flight());
+    EXPECT_EQ(5, txq.send(serial));
+    EXPECT_EQ(2u, txq.in_flight());
+    EXPECT_EQ(4, txq.send(serial));
+    EXPECT_EQ(0, txq.send(serial));
+    EXPECT_EQ("G1 X10\nG1 Y10\n", serial.data);
+}
+
+TEST(TxQueueTest, TestBackPressure) {
+    RecordingSerial serial;
+    TxQueueConfig config;
+    config.rx_buffer_size = 10;
+    config.max_commands = 2;
+    TxQueue txq(config);
+    txq.push("G1 X1\nG1 X2\nG1 X3\nG1 X4\n");
+
+    // two commands for the printer's queue, one more fits its RX buffer
+    EXPECT_EQ(18, txq.send(serial));
+    EXPECT_EQ(0, txq.send(serial));
+    txq.acknowledge();
+    EXPECT_EQ(6, txq.send(serial));
+    txq.acknowledge(5);
+    EXPECT_EQ(0u, txq.in_flight());
+
+    // byte limit, an oversized command still goes out once it goes to the queue
+    txq.push("G1 X5\nG1 X6\n" + std::string(30, 'a'));
+    EXPECT_EQ(12, txq.send(serial));
+    EXPECT_EQ(0, txq.send(serial));
+    txq.acknowledge();
+    EXPECT_EQ(31, txq.send(serial));
+    EXPECT_EQ(37u, txq.in_flight_bytes());
+}
+
+TEST(TxQueueTest, TestPingPong) {
+    RecordingSerial serial;
+    TxQueueConfig config;
+    config.windowed = false;
+    TxQueue txq(config);
+    txq.push("G1 X1\nG1 X2\n");
+
+    EXPECT_EQ(6, txq.send(serial));
+    EXPECT_EQ(0, txq.send(serial));
+    txq.acknowledge();
+    EXPECT_EQ(6, txq.send(serial));
+}
+
+TEST(TxQueueTest, TestAdvancedOk) {
+    RecordingSerial serial;
+    TxQueueConfig config;
+    config.rx_buffer_size = 0;
+    TxQueue txq(config);
+    EXPECT_EQ(4u, txq.command_slots());
+    EXPECT_EQ(-1, txq.planner_free());
+
+    // temperatures are not ADVANCED_OK fields
+    txq.acknowledge_ok("ok T:20.00 /0.00 B:20.00 /0.00 @:0 B@:0");
+    EXPECT_EQ(4u, txq.command_slots());
+
+    // the printer is busy, learned from below
+    txq.acknowledge_ok("ok N0 P15 B2\r\n");
+    EXPECT_EQ(3u, txq.command_slots());
+    EXPECT_EQ(15, txq.planner_free());
+    txq.acknowledge_ok("ok N1 P16 B7");
+    EXPECT_EQ(8u, txq.command_slots());
+    txq.acknowledge_ok("ok N2 P16 B5");
+    EXPECT_EQ(8u, txq.command_slots());
+
+    for (int i = 0; i < 10; ++i) {
+        txq.push("G1 X" + std::to_string(i));
+    }
+    EXPECT_EQ(48, txq.send(serial));
+    EXPECT_EQ(8u, txq.in_flight());
+
+    txq.reset();
+    EXPECT_EQ(4u, txq.command_slots());
+}
+
+TEST(TxQueueTest, TestResend) {
+    RecordingSerial serial;
+    TxQueue txq;
+    EXPECT_EQ(2, resend_number("Resend: 2\r\n"));
+    EXPECT_EQ(-1, resend_number("Error:checksum mismatch, Last Line: 1"));
+
+    for (int i = 1; i <= 6; ++i) {
+        txq.push("N" + std::to_string(i) + " G1 X" + std::to_string(i));
+    }
+    EXPECT_EQ(54, txq.send(serial));
+    EXPECT_EQ(6u, txq.in_flight());
+
+    // line 3 was corrupted, the printer flushed the lines behind it
+    txq.resend(3);
+    EXPECT_EQ(3u, txq.in_flight());
+    EXPECT_EQ(27u, txq.in_flight_bytes());
+    // not in flight
+    txq.resend(5);
+    EXPECT_EQ(3u, txq.in_flight());
+    for (int i = 0; i < 3; ++i) {
+        txq.acknowledge_ok("ok");
+    }
+    EXPECT_EQ(0u, txq.in_flight());
+
+    // ADVANCED_OK names the line, the lost ok of line 7 is made up for
+    txq.push("N7 G1 X7\nN8 G1 X8\nN9 G1 X9\n");
+    EXPECT_EQ(27, txq.send(serial));
+    txq.acknowledge_ok("ok N8 P15 B3");
+    EXPECT_EQ(1u, txq.in_flight());
+    // an ok for a line no longer in flight
+    txq.acknowledge_ok("ok N5 P15 B3");
+    EXPECT_EQ(1u, txq.in_flight());
+    txq.acknowledge_ok("ok N9 P15 B3");
+    EXPECT_EQ(0u, txq.in_flight());
+}
+
+TEST(TxQueueTest, TestReset) {
+    RecordingSerial serial;
+    TxQueue txq;
+    txq.push("M105\n\n  \nM114\n");
+    EXPECT_EQ(10, txq.send(serial));
+    txq.push("M115\n");
+    txq.reset();
+    EXPECT_EQ(0u, txq.in_flight());
+    EXPECT_EQ(0u, txq.pending());
+    EXPECT_EQ(0, txq.send(serial));
+}
+
+/// @brief Source handing out numbered lines
+class CountingSource : public TxSource {
+public:
+    std::string_view peek() override {
+        if (next >= limit) {
+            return {};
+        }
+        line = "G1 X" + std::to_string(next) + "\n";
+        return line;
+    }
+    void pop() override {
+        ++next;
+    }
+    void acknowledged() override {
+        ++acked;
+    }
+
+    std::string line;
+    int next{ 0 }, limit{ 3 }, acked{ 0 };
+};
+
+TEST(TxQueueTest, TestMeatPack) {
+    RecordingSerial serial;
+    TxQueue txq;
+    const MeatPackEncoder encoder;
+    txq.push("M105\n");
+    txq.enable_meatpack();
+    EXPECT_TRUE(txq.meatpack());
+    txq.push("G1 X10 Y20\n");
+
+    // the control sequence goes between the lines and is not answered by an ok
+    std::string expected = "M105\n" + encoder.enable_sequence();
+    encoder.encode("G1 X10 Y20\n", expected);
+    EXPECT_EQ(static_cast<int>(expected.size()), txq.send(serial));
+    EXPECT_EQ(expected, serial.data);
+    EXPECT_EQ(2u, txq.in_flight());
+    EXPECT_EQ(5u + expected.size() - 11, txq.in_flight_bytes());
+
+    // reconnecting turns it off before anything else goes out
+    txq.reset();
+    EXPECT_FALSE(txq.meatpack());
+    txq.push("M115\n");
+    serial.data.clear();
+    txq.send(serial);
+    EXPECT_EQ(MeatPackEncoder::disable_sequence() + "M115\n", serial.data);
+    EXPECT_EQ(1u, txq.in_flight());
+}
+
+TEST(TxQueueTest, TestEmergency) {
+    RecordingSerial serial;
+    TxQueueConfig config;
+    config.max_commands = 1;
+    config.rx_buffer_size = 0;
+    TxQueue txq(config);
+    txq.push("G28\nG1 X10\nG1 X20\n");
+    txq.send(serial);
+    EXPECT_EQ("G28\n", serial.data);
+
+    // without the emergency parser it jumps the queue, but waits for room in the printer
+    txq.push_emergency("M108");
+    EXPECT_EQ(0, txq.send(serial));
+    txq.acknowledge();
+    txq.send(serial);
+    EXPECT_EQ("G28\nM108\n", serial.data);
+
+    // with it, it goes out at once, behind the rest of a partly written command
+    txq.set_emergency_parser(true);
+    txq.acknowledge();
+    serial.write_limit = 3;
+    txq.send(serial);
+    txq.push_emergency("M112\nM410");
+    serial.write_limit = 1 << 20;
+    serial.data.clear();
+    txq.send(serial);
+    EXPECT_EQ("X10\nM112\nM410\n", serial.data);
+    // the firmware still queues them and answers with an ok
+    EXPECT_EQ(3u, txq.in_flight());
+    EXPECT_EQ(1u, txq.pending());
+
+    // taken for writing around the queue, whether waiting for room or not moved yet
+    txq.set_emergency_parser(false);
+    txq.push_emergency("M108");
+    EXPECT_EQ(0, txq.send(serial));
+    txq.push_emergency("M112");
+    EXPECT_EQ("M108\nM112\n", txq.take_emergency());
+    EXPECT_EQ(1u, txq.pending());
+    EXPECT_EQ("", txq.take_emergency());
+}
+
+TEST(TxQueueTest, TestEmergencyMeatPack) {
+    RecordingSerial serial;
+    TxQueue txq;
+    const MeatPackEncoder encoder;
+    txq.enable_meatpack();
+    txq.set_emergency_parser(true);
+    txq.push("G1 X10\n");
+    txq.push_emergency("M112\n");
+
+    // the firmware does not unpack before the queued enable sequence
+    std::string expected = "M112\n" + encoder.enable_sequence();
+    encoder.encode("G1 X10\n", expected);
+    txq.send(serial);
+    EXPECT_EQ(expected, serial.data);
+    EXPECT_EQ(2u, txq.in_flight());
+
+    // while it unpacks, the command goes out plain between a disable and an enable sequence
+    txq.push_emergency("M410\n");
+    serial.data.clear();
+    txq.send(serial);
+    EXPECT_EQ(MeatPackEncoder::disable_sequence() + "\nM410\n" + encoder.enable_sequence(), serial.data);
+
+    // the firmware unpacks until the queued disable sequence arrives
+    txq.disable_meatpack();
+    txq.push_emergency("M108\n");
+    serial.data.clear();
+    txq.send(serial);
+    EXPECT_EQ(MeatPackEncoder::disable_sequence() + "\nM108\n" + encoder.enable_sequence() +
+                  MeatPackEncoder::disable_sequence(),
+              serial.data);
+}
+
+TEST(TxQueueTest, TestSourceFillsRoom) {
+    RecordingSerial serial;
+    TxQueueConfig config;
+    config.max_commands = 2;
+    config.rx_buffer_size = 0;
+    TxQueue txq(config);
+    CountingSource source;
+    txq.set_source(&source);
+
+    // pushed commands go first, the source only gets the room left
+    txq.push("M105\n");
+    EXPECT_EQ(11, txq.send(serial));
+    EXPECT_EQ("M105\nG1 X0\n", serial.data);
+    EXPECT_EQ(1, source.next);
+
+    txq.acknowledge();
+    EXPECT_EQ(0, source.acked);
+    EXPECT_EQ(6, txq.send(serial));
+    txq.acknowledge(2);
+    EXPECT_EQ(2, source.acked);
+    EXPECT_EQ(6, txq.send(serial));
+    EXPECT_EQ(0, txq.send(serial));
+    EXPECT_EQ(3, source.next);
+    EXPECT_EQ("M105\nG1 X0\nG1 X1\nG1 X2\n", serial.data);
+}
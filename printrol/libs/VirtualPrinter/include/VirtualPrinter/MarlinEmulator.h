@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// @brief Behaviour of a virtual printer
+struct VirtualPrinterConfig {
+    /// delay before a reply is written
+    std::chrono::microseconds latency{ 0 };
+    /// random extra delay, uniform in [0, jitter]
+    std::chrono::microseconds jitter{ 0 };
+    /// seed of the jitter generator
+    std::uint32_t seed{ 1 };
+
+    /// bytes the printer can hold before it drops input, 0 for unlimited. Marlin's RX_BUFFER_SIZE.
+    std::size_t rx_buffer_size{ 128 };
+    /// commands read ahead of the one executing, Marlin's BUFSIZE
+    std::size_t command_buffer{ 4 };
+    /// moves the planner holds, Marlin's BLOCK_BUFFER_SIZE
+    std::size_t planner_size{ 16 };
+    /// execution time of each G0/G1
+    std::chrono::microseconds move_time{ 2000 };
+    /// duration of G28
+    std::chrono::milliseconds home_time{ 500 };
+    /// interval of "busy: processing" during blocking commands, Marlin's DEFAULT_KEEPALIVE_INTERVAL
+    std::chrono::milliseconds busy_interval{ 2000 };
+    /// degrees per second heaters move towards their target
+    float heating_rate{ 50.f };
+
+    std::size_t hotends{ 1 };
+    /// report the AUTOREPORT_TEMP and AUTOREPORT_POS capabilities and accept M155/M154
+    bool autoreport{ true };
+};
+
+/// @brief The Marlin side of a serial connection, without any I/O
+/// @details Bytes from the host go in through receive(), replies come out of take_output(). Time only advances through
+/// the time points passed in, so the emulator is deterministic and can be driven by a test or by VirtualPrinter.
+class MarlinEmulator {
+public:
+    using clock_t = std::chrono::steady_clock;
+    using time_point = clock_t::time_point;
+    using Config = VirtualPrinterConfig;
+
+    explicit MarlinEmulator(const Config& config = Config(), time_point now = clock_t::now());
+
+    /// @brief Bytes received from the host. Input beyond rx_buffer_size is dropped.
+    void receive(std::string_view data, time_point now);
+
+    /// @brief Advance to @p now: execute moves, finish waits, send reports and process queued commands
+    void update(time_point now);
+
+    /// @brief Replies produced since the last call
+    std::string take_output();
+
+    /// @brief Latest time update() must be called at, e.g. for the next report or the end of a move
+    time_point next_event() const;
+
+    std::size_t planner_moves() const {
+        return planner_.size();
+    }
+    /// @brief Number of commands executed
+    std::uint64_t commands() const {
+        return commands_;
+    }
+    /// @brief Number of Resend: requests sent
+    std::uint64_t resends() const {
+        return resends_;
+    }
+    /// @brief Number of received bytes dropped because the RX buffer was full
+    std::uint64_t dropped() const {
+        return dropped_;
+    }
+    /// @brief M112 was received, all input is ignored
+    bool halted() const {
+        return halted_;
+    }
+
+private:
+    enum class Wait {
+        NONE,
+        /// G0/G1 with a full planner
+        PLANNER_SLOT,
+        /// planner.synchronize(), then an optional dwell
+        PLANNER_EMPTY,
+        UNTIL,
+        /// M109/M190
+        HEATING,
+    };
+
+    struct Heater {
+        float actual{ 25.f }, target{ 0.f };
+    };
+
+    /// @brief Move complete lines from the RX buffer into the command queue, validating line numbers and checksums
+    void read_commands();
+    /// @brief Execute queued commands until one has to wait
+    void run_commands(time_point now);
+    /// @brief Start executing @p cmd
+    /// @return true if the plain "ok" is due now, false if the command waits or replied itself
+    bool execute(std::string_view cmd, time_point now);
+    /// @brief Advance moves, heaters and the current wait to @p now
+    void simulate(time_point now);
+    /// @brief Marlin's gcode_line_error(): report @p error, flush the RX buffer, then "Resend:" the next line and "ok"
+    void request_resend(std::string_view error);
+    void finish_wait();
+
+    void report_temperatures();
+    void report_position();
+    void report_capabilities();
+    void add_move(std::string_view cmd);
+
+    Config config_;
+    time_point now_;
+
+    std::string rx_;
+    std::deque<std::string> commands_queue_;
+    std::string output_;
+    long last_line_{ 0 };
+
+    std::deque<std::chrono::microseconds> planner_;
+    /// start of the move at the front of planner_
+    time_point move_start_;
+
+    Wait wait_{ Wait::NONE };
+    time_point wait_until_, next_busy_;
+    std::chrono::milliseconds dwell_{ 0 };
+    /// the command blocked on PLANNER_SLOT
+    std::string blocked_;
+
+    std::array<float, 4> position_{};
+    bool relative_{ false };
+    std::vector<Heater> hotends_;
+    Heater bed_;
+    /// heater M109/M190 waits for
+    Heater* heating_{ nullptr };
+
+    std::chrono::seconds temp_interval_{ 0 }, pos_interval_{ 0 };
+    time_point next_temp_report_, next_pos_report_;
+
+    std::uint64_t commands_{ 0 }, resends_{ 0 }, dropped_{ 0 };
+    bool halted_{ false };
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "VirtualPrinter/MarlinEmulator.h"
+
+
+/// @brief MarlinEmulator behind a pseudo-terminal, usable by LinuxSerial like a printer on a tty
+/// @details Each instance runs its own thread serving the master side of the pty. Instances are independent, any number
+/// can run at once.
+class VirtualPrinter {
+public:
+    using Config = VirtualPrinterConfig;
+
+    struct Stats {
+        std::uint64_t bytes_in, bytes_out, commands, resends, dropped;
+    };
+
+    explicit VirtualPrinter(const Config& config = Config());
+    ~VirtualPrinter();
+
+    VirtualPrinter(const VirtualPrinter&) = delete;
+    VirtualPrinter& operator=(const VirtualPrinter&) = delete;
+
+    /// @brief Open the pty and start serving it
+    /// @return false if the pty could not be opened
+    bool start();
+    void stop();
+
+    bool is_running() const {
+        return thread_.joinable();
+    }
+
+    /// @brief Path of the tty to connect to, e.g. /dev/pts/3
+    const std::string& port_name() const {
+        return port_name_;
+    }
+
+    /// @brief Counters, safe to read while running
+    Stats stats() const;
+
+private:
+    void run();
+
+    Config config_;
+    std::string port_name_;
+    int master_{ -1 }, slave_{ -1 };
+    /// written to wake the thread for stop()
+    int wake_pipe_[2]{ -1, -1 };
+    std::thread thread_;
+
+    std::atomic<std::uint64_t> bytes_in_{ 0 }, bytes_out_{ 0 }, commands_{ 0 }, resends_{ 0 }, dropped_{ 0 };
+};
@@ -0,0 +1,434 @@
+#include "VirtualPrinter/MarlinEmulator.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <optional>
+
+
+/// axes of position_, in order
+static constexpr std::string_view axis_letters = "XYZE";
+/// steps per mm reported by M114 Count
+static constexpr std::array<float, 3> steps_per_mm = { 80.f, 80.f, 400.f };
+
+/// @brief Value of parameter @p letter in @p cmd, e.g. S in "M104 S200"
+static std::optional<float> param(std::string_view cmd, char letter) {
+    // skip the command itself
+    auto pos = cmd.find(' ');
+    while (pos != std::string_view::npos && pos + 1 < cmd.size()) {
+        ++pos;
+        if (cmd[pos] == letter) {
+            float val = 0;
+            const char* first = cmd.data() + pos + 1;
+            const char* last = cmd.data() + cmd.size();
+            if (first != last && *first == '+') {
+                ++first;
+            }
+            const auto [ptr, ec] = std::from_chars(first, last, val);
+            // a parameter without a value, e.g. "G28 X", counts as 0
+            return ec == std::errc() ? val : 0.f;
+        }
+        pos = cmd.find(' ', pos);
+    }
+    return std::nullopt;
+}
+
+static void trim(std::string_view& str) {
+    while (not str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+    while (not str.empty() && (str.back() == ' ' || str.back() == '\t' || str.back() == '\r')) {
+        str.remove_suffix(1);
+    }
+}
+
+/// @brief Move @p actual towards @p target by at most @p step degrees
+static void approach(float& actual, float target, float step) {
+    if (std::abs(target - actual) <= step) {
+        actual = target;
+    } else {
+        actual += target > actual ? step : -step;
+    }
+}
+
+
+MarlinEmulator::MarlinEmulator(const Config& config, time_point now)
+  : config_(config), now_(now), hotends_(std::max<std::size_t>(config.hotends, 1)) {
+}
+
+void MarlinEmulator::receive(std::string_view data, time_point now) {
+    if (halted_) {
+        return;
+    }
+    if (config_.rx_buffer_size) {
+        const std::size_t room = config_.rx_buffer_size - std::min(rx_.size(), config_.rx_buffer_size);
+        if (data.size() > room) {
+            dropped_ += data.size() - room;
+            data = data.substr(0, room);
+        }
+    }
+    rx_.append(data);
+    update(now);
+}
+
+void MarlinEmulator::update(time_point now) {
+    if (halted_) {
+        return;
+    }
+    simulate(now);
+    run_commands(now);
+    read_commands();
+    run_commands(now);
+}
+
+std::string MarlinEmulator::take_output() {
+    std::string ret;
+    ret.swap(output_);
+    return ret;
+}
+
+MarlinEmulator::time_point MarlinEmulator::next_event() const {
+    using namespace std::chrono_literals;
+
+    // heaters and reports are checked at least every 100 ms
+    time_point next = now_ + 100ms;
+    if (not planner_.empty()) {
+        next = std::min(next, move_start_ + planner_.front());
+    }
+    if (wait_ == Wait::UNTIL) {
+        next = std::min(next, wait_until_);
+    }
+    if (wait_ != Wait::NONE && wait_ != Wait::PLANNER_SLOT) {
+        next = std::min(next, next_busy_);
+    }
+    if (temp_interval_.count()) {
+        next = std::min(next, next_temp_report_);
+    }
+    if (pos_interval_.count()) {
+        next = std::min(next, next_pos_report_);
+    }
+    return std::max(next, now_);
+}
+
+void MarlinEmulator::simulate(time_point now) {
+    using namespace std::chrono_literals;
+
+    const float dt = std::chrono::duration<float>(now - now_).count();
+    now_ = now;
+
+    while (not planner_.empty() && move_start_ + planner_.front() <= now) {
+        move_start_ += planner_.front();
+        planner_.pop_front();
+    }
+
+    for (auto& heater : hotends_) {
+        approach(heater.actual, heater.target ? heater.target : 25.f, config_.heating_rate * dt);
+    }
+    approach(bed_.actual, bed_.target ? bed_.target : 25.f, config_.heating_rate * dt);
+
+    switch (wait_) {
+        case Wait::NONE:
+            break;
+        case Wait::PLANNER_SLOT:
+            if (planner_.size() < config_.planner_size) {
+                add_move(blocked_);
+                blocked_.clear();
+                finish_wait();
+            }
+            break;
+        case Wait::PLANNER_EMPTY:
+            if (not planner_.empty()) {
+                break;
+            }
+            if (dwell_.count() == 0) {
+                finish_wait();
+                break;
+            }
+            // the dwell starts when the last move finished
+            wait_ = Wait::UNTIL;
+            wait_until_ = move_start_ + dwell_;
+            [[fallthrough]];
+        case Wait::UNTIL:
+            if (now >= wait_until_) {
+                finish_wait();
+            }
+            break;
+        case Wait::HEATING:
+            if (std::abs(heating_->actual - heating_->target) < 1.f) {
+                finish_wait();
+            }
+            break;
+    }
+
+    if (wait_ != Wait::NONE && wait_ != Wait::PLANNER_SLOT && now >= next_busy_) {
+        // Marlin reports temperatures instead of busy while heating
+        if (wait_ == Wait::HEATING) {
+            report_temperatures();
+        } else {
+            output_ += "echo:busy: processing\n";
+        }
+        next_busy_ = now + (wait_ == Wait::HEATING ? std::chrono::milliseconds(1000) : config_.busy_interval);
+    }
+
+    if (temp_interval_.count() && now >= next_temp_report_) {
+        report_temperatures();
+        next_temp_report_ = now + temp_interval_;
+    }
+    if (pos_interval_.count() && now >= next_pos_report_) {
+        report_position();
+        next_pos_report_ = now + pos_interval_;
+    }
+}
+
+void MarlinEmulator::finish_wait() {
+    wait_ = Wait::NONE;
+    dwell_ = std::chrono::milliseconds(0);
+    heating_ = nullptr;
+    output_ += "ok\n";
+    ++commands_;
+}
+
+void MarlinEmulator::request_resend(std::string_view error) {
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), "Error:%.*s, Last Line: %ld\nResend: %ld\nok\n", static_cast<int>(error.size()),
+                  error.data(), last_line_, last_line_ + 1);
+    output_ += buf;
+    // like gcode_line_error(), everything received after the bad line is flushed without an ok
+    rx_.clear();
+    ++resends_;
+}
+
+void MarlinEmulator::read_commands() {
+    while (commands_queue_.size() < config_.command_buffer) {
+        const auto end = rx_.find_first_of("\n\r");
+        if (end == std::string::npos) {
+            return;
+        }
+        std::string_view line(rx_.data(), end);
+
+        if (const auto comment = line.find(';'); comment != std::string_view::npos) {
+            line = line.substr(0, comment);
+        }
+        trim(line);
+
+        const auto star = line.rfind('*');
+        if (not line.empty() && line[0] == 'N') {
+            long number = 0;
+            const auto [ptr, ec] = std::from_chars(line.data() + 1, line.data() + line.size(), number);
+            if (ec != std::errc()) {
+                number = -1;
+            }
+            std::string_view cmd = line.substr(ptr - line.data(), star == std::string_view::npos ? line.npos
+                                                                                                 : star - (ptr - line.data()));
+            trim(cmd);
+
+            if (star == std::string_view::npos) {
+                request_resend("No Checksum with line number");
+                return;
+            } else {
+                std::uint8_t checksum = 0;
+                for (std::size_t i = 0; i < star; ++i) {
+                    checksum ^= static_cast<std::uint8_t>(line[i]);
+                }
+                int expected = -1;
+                std::from_chars(line.data() + star + 1, line.data() + line.size(), expected);
+                if (number != last_line_ + 1 && cmd.substr(0, 4) != "M110") {
+                    request_resend("Line Number is not Last Line Number+1");
+                    return;
+                } else if (expected != checksum) {
+                    request_resend("checksum mismatch");
+                    return;
+                } else {
+                    last_line_ = number;
+                }
+            }
+            if (not cmd.empty()) {
+                commands_queue_.emplace_back(cmd);
+            }
+        } else if (star != std::string_view::npos) {
+            request_resend("No Line Number with checksum");
+            return;
+        } else if (not line.empty()) {
+            commands_queue_.emplace_back(line);
+        }
+
+        rx_.erase(0, end + 1);
+    }
+}
+
+void MarlinEmulator::run_commands(time_point now) {
+    while (wait_ == Wait::NONE && not commands_queue_.empty() && not halted_) {
+        const std::string cmd = std::move(commands_queue_.front());
+        commands_queue_.pop_front();
+        if (execute(cmd, now)) {
+            output_ += "ok\n";
+            ++commands_;
+        }
+        read_commands();
+    }
+}
+
+bool MarlinEmulator::execute(std::string_view cmd, time_point now) {
+    using namespace std::chrono_literals;
+
+    const auto code_end = cmd.find(' ');
+    const std::string_view code = cmd.substr(0, code_end);
+
+    auto wait = [&](Wait what) {
+        if (what == Wait::PLANNER_EMPTY && planner_.empty()) {
+            if (dwell_.count() == 0) {
+                return true;
+            }
+            what = Wait::UNTIL;
+            wait_until_ = now + dwell_;
+        }
+        wait_ = what;
+        next_busy_ = now + (what == Wait::HEATING ? 1000ms : config_.busy_interval);
+        return false;
+    };
+
+    if (code == "G0" || code == "G1") {
+        if (planner_.size() >= config_.planner_size) {
+            blocked_ = cmd;
+            wait_ = Wait::PLANNER_SLOT;
+            return false;
+        }
+        add_move(cmd);
+        return true;
+    }
+    if (code == "G4") {
+        const auto ms = param(cmd, 'P').value_or(param(cmd, 'S').value_or(0) * 1000);
+        dwell_ = std::chrono::milliseconds(static_cast<long>(ms));
+        return wait(Wait::PLANNER_EMPTY);
+    }
+    if (code == "G28") {
+        position_ = {};
+        dwell_ = config_.home_time;
+        return wait(Wait::PLANNER_EMPTY);
+    }
+    if (code == "G90" || code == "G91") {
+        relative_ = code == "G91";
+        return true;
+    }
+    if (code == "G92") {
+        for (std::size_t i = 0; i < axis_letters.size(); ++i) {
+            if (const auto val = param(cmd, axis_letters[i])) {
+                position_[i] = *val;
+            }
+        }
+        return true;
+    }
+    if (code == "M400") {
+        return wait(Wait::PLANNER_EMPTY);
+    }
+    if (code == "M104" || code == "M109") {
+        const auto idx = static_cast<std::size_t>(param(cmd, 'T').value_or(0));
+        Heater& heater = hotends_[std::min(idx, hotends_.size() - 1)];
+        heater.target = param(cmd, 'S').value_or(heater.target);
+        if (code == "M109") {
+            heating_ = &heater;
+            return wait(Wait::HEATING);
+        }
+        return true;
+    }
+    if (code == "M140" || code == "M190") {
+        bed_.target = param(cmd, 'S').value_or(bed_.target);
+        if (code == "M190") {
+            heating_ = &bed_;
+            return wait(Wait::HEATING);
+        }
+        return true;
+    }
+    if (code == "M105") {
+        // the temperatures are part of the ok line
+        output_ += "ok";
+        report_temperatures();
+        ++commands_;
+        return false;
+    }
+    if (code == "M114") {
+        report_position();
+        return true;
+    }
+    if (code == "M115") {
+        report_capabilities();
+        return true;
+    }
+    if (config_.autoreport && (code == "M155" || code == "M154")) {
+        auto& interval = code == "M155" ? temp_interval_ : pos_interval_;
+        auto& next = code == "M155" ? next_temp_report_ : next_pos_report_;
+        interval = std::chrono::seconds(static_cast<long>(param(cmd, 'S').value_or(0)));
+        next = now + interval;
+        return true;
+    }
+    if (code == "M110") {
+        last_line_ = static_cast<long>(param(cmd, 'N').value_or(0));
+        return true;
+    }
+    if (code == "M112") {
+        output_ += "Error:Printer halted. kill() called!\n";
+        halted_ = true;
+        rx_.clear();
+        commands_queue_.clear();
+        return false;
+    }
+    if (code == "M82" || code == "M83" || code == "M106" || code == "M107" || code == "M84" || code == "M117") {
+        return true;
+    }
+
+    output_ += "echo:Unknown command: \"" + std::string(cmd) + "\"\n";
+    return true;
+}
+
+void MarlinEmulator::add_move(std::string_view cmd) {
+    for (std::size_t i = 0; i < axis_letters.size(); ++i) {
+        if (const auto val = param(cmd, axis_letters[i])) {
+            position_[i] = relative_ ? position_[i] + *val : *val;
+        }
+    }
+    if (planner_.empty()) {
+        move_start_ = now_;
+    }
+    planner_.push_back(config_.move_time);
+}
+
+void MarlinEmulator::report_temperatures() {
+    char buf[64];
+    auto add = [&](const char* name, const Heater& h) {
+        std::snprintf(buf, sizeof(buf), " %s:%.2f /%.2f", name, h.actual, h.target);
+        output_ += buf;
+    };
+
+    add("T", hotends_[0]);
+    add("B", bed_);
+    if (hotends_.size() > 1) {
+        for (std::size_t i = 0; i < hotends_.size(); ++i) {
+            add(("T" + std::to_string(i)).c_str(), hotends_[i]);
+        }
+    }
+    output_ += " @:0 B@:0\n";
+}
+
+void MarlinEmulator::report_position() {
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "X:%.2f Y:%.2f Z:%.2f E:%.2f Count X:%ld Y:%ld Z:%ld\n", position_[0], position_[1],
+                  position_[2], position_[3], std::lround(position_[0] * steps_per_mm[0]),
+                  std::lround(position_[1] * steps_per_mm[1]), std::lround(position_[2] * steps_per_mm[2]));
+    output_ += buf;
+}
+
+void MarlinEmulator::report_capabilities() {
+    output_ += "FIRMWARE_NAME:Marlin PrintRol virtual printer SOURCE_CODE_URL:github.com/MarlinFirmware/Marlin "
+               "PROTOCOL_VERSION:1.0 MACHINE_TYPE:Virtual EXTRUDER_COUNT:" +
+               std::to_string(hotends_.size()) + " AXIS_COUNT:3 UUID:00000000-0000-0000-0000-000000000000\n";
+
+    const std::string autoreport = config_.autoreport ? "1" : "0";
+    output_ += "Cap:SERIAL_XON_XOFF:0\n";
+    output_ += "Cap:EEPROM:0\n";
+    output_ += "Cap:AUTOREPORT_TEMP:" + autoreport + "\n";
+    output_ += "Cap:AUTOREPORT_POS:" + autoreport + "\n";
+    output_ += "Cap:EMERGENCY_PARSER:0\n";
+    output_ += "Cap:ADVANCED_OK:0\n";
+    output_ += "Cap:MEATPACK:0\n";
+}
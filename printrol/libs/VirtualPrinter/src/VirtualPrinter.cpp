@@ -0,0 +1,149 @@
+#include "VirtualPrinter/VirtualPrinter.h"
+
+#include <deque>
+#include <random>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+/// @brief Write as much of @p data to the non-blocking @p fd as it takes, removing it from @p data
+/// @return false on an error other than a full buffer
+static bool write_some(int fd, std::string& data) {
+    while (not data.empty()) {
+        const auto ret = ::write(fd, data.data(), data.size());
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN;
+        }
+        data.erase(0, ret);
+    }
+    return true;
+}
+
+
+VirtualPrinter::VirtualPrinter(const Config& config) : config_(config) {
+}
+
+VirtualPrinter::~VirtualPrinter() {
+    stop();
+}
+
+bool VirtualPrinter::start() {
+    if (is_running()) {
+        return true;
+    }
+
+    struct termios tty;
+    cfmakeraw(&tty);
+    char name[128];
+    if (openpty(&master_, &slave_, name, &tty, nullptr) != 0) {
+        return false;
+    }
+    // the slave stays open here too, so the master does not see a hangup while no client is connected
+    port_name_ = name;
+
+    // the client may stop reading, the thread must not block in write
+    ::fcntl(master_, F_SETFL, ::fcntl(master_, F_GETFL) | O_NONBLOCK);
+    if (::pipe(wake_pipe_) != 0) {
+        stop();
+        return false;
+    }
+
+    thread_ = std::thread(&VirtualPrinter::run, this);
+    return true;
+}
+
+void VirtualPrinter::stop() {
+    if (thread_.joinable()) {
+        const char c = 0;
+        while (::write(wake_pipe_[1], &c, 1) < 0 && errno == EINTR) {
+        }
+        thread_.join();
+    }
+    for (int* fd : { &master_, &slave_, &wake_pipe_[0], &wake_pipe_[1] }) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+VirtualPrinter::Stats VirtualPrinter::stats() const {
+    return Stats{ bytes_in_, bytes_out_, commands_, resends_, dropped_ };
+}
+
+void VirtualPrinter::run() {
+    using clock_t = MarlinEmulator::clock_t;
+
+    struct Reply {
+        clock_t::time_point due;
+        std::string data;
+    };
+
+    MarlinEmulator marlin(config_, clock_t::now());
+    std::deque<Reply> replies;
+    std::mt19937 rng(config_.seed);
+    std::uniform_int_distribution<long long> jitter(0, config_.jitter.count());
+
+    char buf[4096];
+    for (;;) {
+        const auto now = clock_t::now();
+        auto next = marlin.next_event();
+        // a due reply that is still there did not fit into the pty, wait until it can be written
+        const bool blocked = not replies.empty() && replies.front().due <= now;
+        if (not replies.empty() && not blocked) {
+            next = std::min(next, replies.front().due);
+        }
+        const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(next - now).count();
+
+        const short events = blocked ? POLLIN | POLLOUT : POLLIN;
+        pollfd fds[2] = { { master_, events, 0 }, { wake_pipe_[0], POLLIN, 0 } };
+        if (::poll(fds, 2, static_cast<int>(std::max<long long>(timeout, 0))) < 0 && errno != EINTR) {
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+
+        const auto wakeup = clock_t::now();
+        if (fds[0].revents & POLLIN) {
+            const auto cnt = ::read(master_, buf, sizeof(buf));
+            if (cnt > 0) {
+                bytes_in_ += cnt;
+                marlin.receive(std::string_view(buf, cnt), wakeup);
+            }
+        }
+        marlin.update(wakeup);
+        commands_ = marlin.commands();
+        resends_ = marlin.resends();
+        dropped_ = marlin.dropped();
+
+        if (auto out = marlin.take_output(); not out.empty()) {
+            auto due = wakeup + config_.latency + std::chrono::microseconds(jitter(rng));
+            // replies never overtake each other
+            if (not replies.empty()) {
+                due = std::max(due, replies.back().due);
+            }
+            replies.push_back(Reply{ due, std::move(out) });
+        }
+        while (not replies.empty() && replies.front().due <= clock_t::now()) {
+            auto& data = replies.front().data;
+            const auto size = data.size();
+            if (not write_some(master_, data)) {
+                return;
+            }
+            bytes_out_ += size - data.size();
+            if (not data.empty()) {
+                break;
+            }
+            replies.pop_front();
+        }
+    }
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include "VirtualPrinter/MarlinEmulator.h"
+#include "VirtualPrinter/VirtualPrinter.h"
+#include "LinuxSerial/LinuxSerial.h"
+
+#include <cstdio>
+
+
+using namespace std::chrono_literals;
+
+/// @brief Add the line number and checksum to @p cmd
+static std::string numbered(long number, const std::string& cmd) {
+    std::string line = "N" + std::to_string(number) + " " + cmd;
+    std::uint8_t checksum = 0;
+    for (char c : line) {
+        checksum ^= static_cast<std::uint8_t>(c);
+    }
+    return line + "*" + std::to_string(checksum) + "\n";
+}
+
+
+class MarlinEmulatorTest : public ::testing::Test {
+protected:
+    std::string send(std::string_view data) {
+        marlin.receive(data, now);
+        return marlin.take_output();
+    }
+    std::string advance(MarlinEmulator::clock_t::duration dt) {
+        now += dt;
+        marlin.update(now);
+        return marlin.take_output();
+    }
+
+    MarlinEmulator::time_point now{};
+    VirtualPrinterConfig config;
+    MarlinEmulator marlin{ config, now };
+};
+
+TEST_F(MarlinEmulatorTest, TestReports) {
+    EXPECT_EQ("ok T:25.00 /0.00 B:25.00 /0.00 @:0 B@:0\n", send("M105\n"));
+    EXPECT_EQ("ok\n", send("G1 X10 Y20.5 Z0.3\n"));
+    EXPECT_EQ("X:10.00 Y:20.50 Z:0.30 E:0.00 Count X:800 Y:1640 Z:120\nok\n", send("M114\n"));
+
+    const auto caps = send("M115\n");
+    EXPECT_EQ(0u, caps.find("FIRMWARE_NAME:"));
+    EXPECT_NE(std::string::npos, caps.find("Cap:AUTOREPORT_TEMP:1\n"));
+
+    EXPECT_EQ("ok\n", send("M155 S1\n"));
+    EXPECT_EQ("", advance(500ms));
+    EXPECT_EQ(" T:25.00 /0.00 B:25.00 /0.00 @:0 B@:0\n", advance(500ms));
+}
+
+TEST_F(MarlinEmulatorTest, TestLineNumbers) {
+    EXPECT_EQ("ok\n", send(numbered(0, "M110 N0")));
+    EXPECT_EQ("ok\n", send(numbered(1, "G1 X1")));
+    EXPECT_EQ("Error:Line Number is not Last Line Number+1, Last Line: 1\nResend: 2\nok\n",
+              send(numbered(3, "G1 X3")));
+
+    auto bad = numbered(2, "G1 X2");
+    bad[bad.size() - 2] ^= 1;
+    EXPECT_EQ("Error:checksum mismatch, Last Line: 1\nResend: 2\nok\n", send(bad));
+    EXPECT_EQ("Error:No Checksum with line number, Last Line: 1\nResend: 2\nok\n", send("N2 G1 X2\n"));
+    EXPECT_EQ("ok\n", send(numbered(2, "G1 X2")));
+    EXPECT_EQ(3u, marlin.resends());
+
+    EXPECT_EQ("Error:No Line Number with checksum, Last Line: 2\nResend: 3\nok\n", send("G1 X3*99\n"));
+    EXPECT_EQ(4u, marlin.resends());
+}
+
+TEST_F(MarlinEmulatorTest, TestResendFlushesRx) {
+    EXPECT_EQ("ok\n", send(numbered(0, "M110 N0")));
+    EXPECT_EQ("", send("G4 S1\n"));
+
+    // the lines behind a bad one are dropped without an ok, only the resend is answered
+    auto bad = numbered(1, "G1 X1");
+    bad[bad.size() - 2] ^= 1;
+    EXPECT_EQ("Error:checksum mismatch, Last Line: 0\nResend: 1\nok\n",
+              send(bad + numbered(2, "G1 X2") + numbered(3, "G1 X3")));
+    EXPECT_EQ("ok\n", advance(1s));
+    EXPECT_EQ("", advance(1s));
+
+    EXPECT_EQ("Error:No Line Number with checksum, Last Line: 0\nResend: 1\nok\n",
+              send("G1 X1*99\n" + numbered(1, "G1 X1")));
+    EXPECT_EQ("ok\nok\n", send(numbered(1, "G1 X1") + numbered(2, "G1 X2")));
+    EXPECT_EQ(2u, marlin.resends());
+}
+
+TEST_F(MarlinEmulatorTest, TestPlannerBuffer) {
+    config.planner_size = 2;
+    config.move_time = 10ms;
+    marlin = MarlinEmulator(config, now);
+
+    // the third move waits for a free planner slot before it is acknowledged
+    EXPECT_EQ("ok\nok\n", send("G1 X1\nG1 X2\nG1 X3\n"));
+    EXPECT_EQ(2u, marlin.planner_moves());
+    EXPECT_EQ("ok\n", advance(10ms));
+    EXPECT_EQ("", send("M400\n"));
+    EXPECT_EQ("", advance(10ms));
+    EXPECT_EQ("ok\n", advance(10ms));
+}
+
+TEST_F(MarlinEmulatorTest, TestBusy) {
+    EXPECT_EQ("", send("G4 S5\n"));
+    EXPECT_EQ("echo:busy: processing\n", advance(2s));
+    EXPECT_EQ("echo:busy: processing\n", advance(2s));
+    EXPECT_EQ("ok\n", advance(1s));
+}
+
+TEST_F(MarlinEmulatorTest, TestRxOverflow) {
+    // the command buffer takes 4 lines, the RX buffer 128 bytes, the rest is lost
+    EXPECT_EQ("", send("G4 S1\n"));
+    send(std::string(40, ' ') + "\n" + std::string(200, 'a'));
+    EXPECT_GT(marlin.dropped(), 0u);
+}
+
+TEST(VirtualPrinterTest, TestLinuxSerial) {
+    VirtualPrinter printer;
+    ASSERT_TRUE(printer.start());
+
+    LinuxSerial serial;
+    const auto& name = printer.port_name();
+    serial.open(std::wstring(name.begin(), name.end()), 115200);
+    ASSERT_TRUE(serial.is_open());
+
+    const std::string cmd = numbered(0, "M110 N0") + numbered(1, "M105") + "M114\n";
+    ASSERT_EQ(static_cast<int>(cmd.size()), serial.write(cmd.data(), static_cast<int>(cmd.size())));
+
+    std::string received;
+    char buf[256];
+    while (received.find("Count") == std::string::npos) {
+        const int cnt = serial.read_some(buf, sizeof(buf), 1000);
+        ASSERT_GT(cnt, 0);
+        received.append(buf, cnt);
+    }
+    EXPECT_EQ(0u, received.find("ok\nok T:25.00 /0.00"));
+    EXPECT_EQ(3u, printer.stats().commands);
+
+    serial.close();
+    printer.stop();
+}
+
+TEST(VirtualPrinterTest, TestManyInstances) {
+    std::vector<std::unique_ptr<VirtualPrinter>> printers;
+    for (int i = 0; i < 8; ++i) {
+        printers.push_back(std::make_unique<VirtualPrinter>());
+        ASSERT_TRUE(printers.back()->start());
+    }
+    EXPECT_NE(printers[0]->port_name(), printers[7]->port_name());
+}
@@ -6,10 +6,18 @@
 
 class WinSerial final : public ISerial {
 public:
+    WinSerial();
+
     void open(std::wstring port, int baud) override;
 
     int write(const void* buff, int size) override;
+    int write_gather(const std::string_view* buffs, int count) override;
     int read(void* dest, int size) override;
+    bool wait_readable(int timeout_ms) override;
+    void wake() override;
+    int bytes_available() const override;
+    int read_some(void* dest, int capacity, int timeout_ms) override;
+    native_handle_t native_handle() const override;
 
     void flush() override;
 
@@ -20,9 +28,20 @@ public:
     virtual ~WinSerial();
 
     std::vector<std::wstring> list_ports() const override;
+    std::vector<SerialPortInfo> list_port_info() const override;
 
 private:
+    /// @brief Number of received bytes waiting in the driver
+    DWORD queued_bytes() const;
+
     HANDLE com_handle_{ INVALID_HANDLE_VALUE };
+    /// Events for the overlapped read, write and EV_RXCHAR wait
+    HANDLE read_event_{ NULL }, write_event_{ NULL }, wait_event_{ NULL };
+    /// set by wake(), auto reset, lives as long as the object
+    HANDLE wake_event_{ NULL };
+    OVERLAPPED wait_ov_{};
+    DWORD wait_mask_{ 0 };
+    bool wait_pending_{ false };
     COMMTIMEOUTS timeouts_old_, timeouts_new_;
     DCB dcb_old_, dcb_new_;
 };
@@ -82,6 +82,7 @@ std::vector<CommPortDesc> ListDevices(CONST GUID* pClassGuid, LPCTSTR pszEnumera
 
         // Display device instance ID
         // _tprintf(TEXT("%s\n"), szDeviceInstanceID);
+        curr.instance_id_ = szDeviceInstanceID;
 
         if (SetupDiGetDeviceRegistryProperty(hDevInfo, &DeviceInfoData, SPDRP_DEVICEDESC, &dwPropertyRegDataType,
                                              (BYTE*)szDesc,
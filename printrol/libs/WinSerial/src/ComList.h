@@ -7,6 +7,8 @@ struct CommPortDesc {
     std::wstring bus_reported_dev_descr_;
     std::wstring friendly_name_;
     std::wstring port_str_;
+    /// e.g. USB\VID_2341&PID_0043\85736323838351F0A1C1
+    std::wstring instance_id_;
 };
 
 std::vector<CommPortDesc> get_com_ports();
@@ -1,7 +1,32 @@
 #include "WinSerial/WinSerial.h"
+#include <cwchar>
 #include <string>
 #include "ComList.h"
 
+
+/// @brief Hex value following @p key in a device instance ID, e.g. VID_ in USB\VID_2341&PID_0043\...
+static std::uint16_t instance_id_value(const std::wstring& id, const wchar_t* key) {
+    const auto pos = id.find(key);
+    if (pos == std::wstring::npos) {
+        return 0;
+    }
+    return static_cast<std::uint16_t>(std::wcstoul(id.c_str() + pos + wcslen(key), nullptr, 16));
+}
+
+/// @brief Complete an overlapped operation started with result @p ok
+/// @return Number of bytes transferred
+static DWORD finish_io(HANDLE handle, OVERLAPPED& ov, BOOL ok) {
+    DWORD cnt = 0;
+    if (ok or GetLastError() == ERROR_IO_PENDING) {
+        GetOverlappedResult(handle, &ov, &cnt, TRUE);
+    }
+    return cnt;
+}
+
+
+WinSerial::WinSerial() : wake_event_(CreateEvent(NULL, FALSE, FALSE, NULL)) {
+}
+
 void WinSerial::open(std::wstring port, int baud) {
     if (is_open()) {
         close();
@@ -9,9 +34,14 @@ void WinSerial::open(std::wstring port, int baud) {
 
     port = L"\\.\\\\" + port;
 
-    com_handle_ = CreateFile(port.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, 0, 0);
+    com_handle_ = CreateFile(port.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, 0);
     if (com_handle_ == INVALID_HANDLE_VALUE) return;
 
+    read_event_ = CreateEvent(NULL, TRUE, FALSE, NULL);
+    write_event_ = CreateEvent(NULL, TRUE, FALSE, NULL);
+    wait_event_ = CreateEvent(NULL, TRUE, FALSE, NULL);
+    SetCommMask(com_handle_, EV_RXCHAR);
+
     GetCommTimeouts(com_handle_, &timeouts_old_);
 
     timeouts_new_ = timeouts_old_;
@@ -41,18 +71,91 @@ int WinSerial::write(const void* buff, int size) {
     if (not is_open()) {
         return 0;
     }
-    DWORD cnt = 0;
-    WriteFile(com_handle_, buff, size, &cnt, NULL);
-    return cnt;
+    OVERLAPPED ov{};
+    ov.hEvent = write_event_;
+    return finish_io(com_handle_, ov, WriteFile(com_handle_, buff, size, NULL, &ov));
+}
+
+int WinSerial::write_gather(const std::string_view* buffs, int count) {
+    // there is no gather write for comm handles, join the buffers into one WriteFile
+    std::string joined;
+    for (int i = 0; i < count; ++i) {
+        joined += buffs[i];
+    }
+    return write(joined.data(), static_cast<int>(joined.size()));
 }
 
 int WinSerial::read(void* dst, int sz) {
     if (not is_open()) {
         return 0;
     }
-    DWORD cnt = 0;
-    ReadFile(com_handle_, dst, sz, &cnt, NULL);
-    return cnt;
+    // the timeouts make ReadFile return at once with what was already received
+    OVERLAPPED ov{};
+    ov.hEvent = read_event_;
+    return finish_io(com_handle_, ov, ReadFile(com_handle_, dst, sz, NULL, &ov));
+}
+
+bool WinSerial::wait_readable(int timeout_ms) {
+    if (not is_open()) {
+        return false;
+    }
+    if (queued_bytes() > 0) {
+        return true;
+    }
+
+    if (not wait_pending_) {
+        ResetEvent(wait_event_);
+        wait_ov_ = OVERLAPPED{};
+        wait_ov_.hEvent = wait_event_;
+        if (WaitCommEvent(com_handle_, &wait_mask_, &wait_ov_)) {
+            return queued_bytes() > 0;
+        }
+        if (GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+        wait_pending_ = true;
+        // EV_RXCHAR only fires for characters arriving after the wait was armed
+        if (queued_bytes() > 0) {
+            return true;
+        }
+    }
+
+    const HANDLE events[2] = { wait_event_, wake_event_ };
+    if (WaitForMultipleObjects(wake_event_ ? 2 : 1, events, FALSE, timeout_ms) != WAIT_OBJECT_0) {
+        // the EV_RXCHAR wait stays pending for the next call
+        return false;
+    }
+    DWORD unused;
+    GetOverlappedResult(com_handle_, &wait_ov_, &unused, FALSE);
+    wait_pending_ = false;
+    return queued_bytes() > 0;
+}
+
+int WinSerial::bytes_available() const {
+    if (not is_open()) {
+        return 0;
+    }
+    return static_cast<int>(queued_bytes());
+}
+
+int WinSerial::read_some(void* dest, int capacity, int timeout_ms) {
+    if (not wait_readable(timeout_ms)) {
+        return is_open() ? 0 : -1;
+    }
+    return read(dest, capacity);
+}
+
+ISerial::native_handle_t WinSerial::native_handle() const {
+    return is_open() ? reinterpret_cast<native_handle_t>(com_handle_) : -1;
+}
+
+DWORD WinSerial::queued_bytes() const {
+    COMSTAT stat{};
+    DWORD errors = 0;
+    if (not ClearCommError(com_handle_, &errors, &stat)) {
+        return 0;
+    }
+    return stat.cbInQue;
 }
 
 void WinSerial::flush() {
@@ -70,14 +173,30 @@ void WinSerial::close() {
     if (not is_open()) {
         return;
     }
+    if (wait_pending_) {
+        DWORD unused;
+        CancelIo(com_handle_);
+        GetOverlappedResult(com_handle_, &wait_ov_, &unused, TRUE);
+        wait_pending_ = false;
+    }
     SetCommTimeouts(com_handle_, &timeouts_old_);
     SetCommState(com_handle_, &dcb_old_);
     CloseHandle(com_handle_);
     com_handle_ = INVALID_HANDLE_VALUE;
+
+    for (HANDLE* ev : { &read_event_, &write_event_, &wait_event_ }) {
+        CloseHandle(*ev);
+        *ev = NULL;
+    }
+}
+
+void WinSerial::wake() {
+    SetEvent(wake_event_);
 }
 
 WinSerial::~WinSerial() {
     close();
+    CloseHandle(wake_event_);
 }
 
 std::vector<std::wstring> WinSerial::list_ports() const {
@@ -89,3 +208,22 @@ std::vector<std::wstring> WinSerial::list_ports() const {
 
     return ret;
 }
+
+std::vector<SerialPortInfo> WinSerial::list_port_info() const {
+    std::vector<SerialPortInfo> ret;
+    for (const auto& p : get_com_ports()) {
+        SerialPortInfo info;
+        info.port = p.port_str_;
+        info.description = p.bus_reported_dev_descr_.empty() ? p.friendly_name_ : p.bus_reported_dev_descr_;
+        info.vid = instance_id_value(p.instance_id_, L"VID_");
+        info.pid = instance_id_value(p.instance_id_, L"PID_");
+
+        // the last part is the serial number, unless Windows generated it for a device without one
+        const auto last = p.instance_id_.rfind(L'\\');
+        if (info.vid && last != std::wstring::npos && p.instance_id_.find(L'&', last) == std::wstring::npos) {
+            info.serial_number = p.instance_id_.substr(last + 1);
+        }
+        ret.push_back(std::move(info));
+    }
+    return ret;
+}